@@ -0,0 +1,141 @@
+/**
+   \file cached_func_obj.hpp
+   \brief a func_obj decorator that memoizes the recently evaluated parameters
+   \author Junhua Gu
+ */
+
+#ifndef CACHED_FUNC_OBJ_HPP
+#define CACHED_FUNC_OBJ_HPP
+#define OPT_HEADER
+#include <core/optimizer.hpp>
+#include <core/eval_cache.hpp>
+#include <core/residual_provider.hpp>
+#include <math/num_diff.hpp>
+#include <memory>
+
+namespace opt_utilities
+{
+    /**
+       \brief Wraps a func_obj, and keeps the values of the recently
+       evaluated parameters in an eval_cache, so that a parameter is
+       evaluated only once as long as it stays in the cache.
+       The clones share the cache.
+       The gradient is forwarded to the wrapped object if it is a
+       diff_func_obj, otherwise computed by central differences through
+       the cache.
+       The residuals, see residual_provider, are forwarded to the wrapped
+       object without caching, so that least-squares methods such as
+       levmar_method also work on the wrapper.
+       For an optimizer, optimizer::set_cache_size does the same without
+       wrapping the object function.
+       \tparam rT the return type
+       \tparam pT the self-varible type
+     */
+    template <typename rT, typename pT>
+    class cached_func_obj : public diff_func_obj<rT, pT>, public residual_provider<rT, pT>
+    {
+      private:
+        func_obj<rT, pT> *p_fo;
+        std::shared_ptr<eval_cache<rT, pT>> p_shared_cache;
+
+      private:
+        rT do_eval (const pT &p)
+        {
+            rT result;
+            if (p_shared_cache->lookup (p, result))
+                {
+                    return result;
+                }
+            result = p_fo->eval (p);
+            p_shared_cache->insert (p, result);
+            return result;
+        }
+
+        pT do_gradient (const pT &p)
+        {
+            diff_func_obj<rT, pT> *pdfo = dynamic_cast<diff_func_obj<rT, pT> *> (p_fo);
+            if (pdfo != NULL_PTR)
+                {
+                    return pdfo->gradient (p);
+                }
+            return central_gradient (static_cast<func_obj<rT, pT> &> (*this), p);
+        }
+
+        residual_provider<rT, pT> &wrapped_residual_provider ()
+        {
+            residual_provider<rT, pT> *prp = dynamic_cast<residual_provider<rT, pT> *> (p_fo);
+            if (prp == NULL_PTR)
+                {
+                    throw opt_exception ("the wrapped object function does not implement residual_provider");
+                }
+            return *prp;
+        }
+
+        size_t do_num_residuals ()
+        {
+            return wrapped_residual_provider ().num_residuals ();
+        }
+
+        void do_eval_residuals (const pT &p, rT *r)
+        {
+            wrapped_residual_provider ().eval_residuals (p, r);
+        }
+
+        bool do_eval_jacobian (const pT &p, rT *r, rT *jac)
+        {
+            return wrapped_residual_provider ().eval_jacobian (p, r, jac);
+        }
+
+        cached_func_obj<rT, pT> *do_clone () const
+        {
+            return new cached_func_obj<rT, pT> (*this);
+        }
+
+      public:
+        /**
+           \param fo the object function to be wrapped, which is cloned
+           \param n the capacity of the cache
+         */
+        explicit cached_func_obj (const func_obj<rT, pT> &fo, size_t n = 1024)
+        : p_fo (fo.clone ()), p_shared_cache (new eval_cache<rT, pT> (n))
+        {
+        }
+
+        cached_func_obj (const cached_func_obj &rhs)
+        : diff_func_obj<rT, pT> (rhs), p_fo (rhs.p_fo->clone ()), p_shared_cache (rhs.p_shared_cache)
+        {
+        }
+
+        ~cached_func_obj ()
+        {
+            p_fo->destroy ();
+        }
+
+        /**
+           \return the wrapped object function
+         */
+        func_obj<rT, pT> &get_func_obj ()
+        {
+            return *p_fo;
+        }
+
+        /**
+           \return the cache, with its hit and miss counters
+         */
+        eval_cache<rT, pT> &get_eval_cache ()
+        {
+            return *p_shared_cache;
+        }
+
+        const eval_cache<rT, pT> &get_eval_cache () const
+        {
+            return *p_shared_cache;
+        }
+
+      private:
+        cached_func_obj &operator= (const cached_func_obj &);
+    };
+}
+
+#endif
+// EOF
@@ -0,0 +1,282 @@
+/**
+   \file eval_cache.hpp
+   \brief a bounded LRU table of evaluated parameters and values
+   \author Junhua Gu
+ */
+
+#ifndef EVAL_CACHE_HPP
+#define EVAL_CACHE_HPP
+#define OPT_HEADER
+#include "opt_traits.hpp"
+#include <cstddef>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace opt_utilities
+{
+    /**
+       \brief the elements of a parameter as seen by eval_cache,
+       a scalar parameter (e.g., of the 1-D functions of the line searches)
+       is a single element
+     */
+    template <typename pT, bool = std::is_arithmetic<pT>::value> struct cache_key_trait
+    {
+        typedef typename element_type_trait<pT>::element_type element_type;
+
+        static size_t size (const pT &p)
+        {
+            return get_size (p);
+        }
+
+        static element_type element (const pT &p, size_t i)
+        {
+            return get_element (p, i);
+        }
+    };
+
+    template <typename pT> struct cache_key_trait<pT, true>
+    {
+        typedef pT element_type;
+
+        static size_t size (const pT &)
+        {
+            return 1;
+        }
+
+        static element_type element (const pT &p, size_t)
+        {
+            return p;
+        }
+    };
+
+    /**
+       \brief the values of the most recently evaluated parameters.
+       A parameter hits only if all its elements are exactly equal to
+       the ones of a stored parameter.
+       When full, the least recently used entry is evicted.
+       All the members can be called concurrently, so that the clones of
+       a func_obj can share one cache.
+       \tparam rT the return type of the object function
+       \tparam pT the parameter type of the object function
+     */
+    template <typename rT, typename pT> class eval_cache
+    {
+      private:
+        typedef cache_key_trait<pT> key_trait;
+        typedef typename key_trait::element_type Te;
+
+        struct entry
+        {
+            std::vector<Te> key;
+            size_t hash;
+            rT value;
+        };
+
+        typedef typename std::list<entry>::iterator entry_iterator;
+
+        size_t capacity;
+        // the most recently used entry first
+        std::list<entry> entries;
+        std::unordered_multimap<size_t, entry_iterator> index;
+        mutable std::mutex mtx;
+        std::atomic<unsigned long long> n_hits;
+        std::atomic<unsigned long long> n_misses;
+
+      private:
+        eval_cache (const eval_cache &);
+        eval_cache &operator= (const eval_cache &);
+
+        static size_t hash_param (const pT &p)
+        {
+            std::hash<Te> h;
+            size_t result = key_trait::size (p);
+            for (size_t i = 0; i < key_trait::size (p); ++i)
+                {
+                    result ^= h (key_trait::element (p, i)) + 0x9e3779b97f4a7c15ULL + (result << 6) + (result >> 2);
+                }
+            return result;
+        }
+
+        static bool equal (const std::vector<Te> &key, const pT &p)
+        {
+            if (key.size () != key_trait::size (p))
+                {
+                    return false;
+                }
+            for (size_t i = 0; i < key.size (); ++i)
+                {
+                    if (!(key[i] == key_trait::element (p, i)))
+                        {
+                            return false;
+                        }
+                }
+            return true;
+        }
+
+        // must be called with mtx locked
+        entry_iterator find (const pT &p, size_t h)
+        {
+            std::pair<typename std::unordered_multimap<size_t, entry_iterator>::iterator,
+                      typename std::unordered_multimap<size_t, entry_iterator>::iterator>
+            range = index.equal_range (h);
+            for (; range.first != range.second; ++range.first)
+                {
+                    if (equal (range.first->second->key, p))
+                        {
+                            return range.first->second;
+                        }
+                }
+            return entries.end ();
+        }
+
+        // must be called with mtx locked
+        void evict ()
+        {
+            while (entries.size () > capacity)
+                {
+                    entry_iterator last = --entries.end ();
+                    std::pair<typename std::unordered_multimap<size_t, entry_iterator>::iterator,
+                              typename std::unordered_multimap<size_t, entry_iterator>::iterator>
+                    range = index.equal_range (last->hash);
+                    for (; range.first != range.second; ++range.first)
+                        {
+                            if (range.first->second == last)
+                                {
+                                    index.erase (range.first);
+                                    break;
+                                }
+                        }
+                    entries.erase (last);
+                }
+        }
+
+      public:
+        /**
+           \param n the maximum number of entries
+         */
+        explicit eval_cache (size_t n = 1024) : capacity (n), n_hits (0), n_misses (0)
+        {
+        }
+
+        /**
+           look up a parameter, and count a hit or a miss
+           \param p the parameter
+           \param v set to the stored value on a hit
+           \return whether p is stored
+         */
+        bool lookup (const pT &p, rT &v)
+        {
+            size_t h = hash_param (p);
+            {
+                std::lock_guard<std::mutex> lk (mtx);
+                entry_iterator i = find (p, h);
+                if (i != entries.end ())
+                    {
+                        entries.splice (entries.begin (), entries, i);
+                        v = i->value;
+                        n_hits.fetch_add (1, std::memory_order_relaxed);
+                        return true;
+                    }
+            }
+            n_misses.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        /**
+           store the value of a parameter
+           \param p the parameter
+           \param v the value
+         */
+        void insert (const pT &p, const rT &v)
+        {
+            size_t h = hash_param (p);
+            std::lock_guard<std::mutex> lk (mtx);
+            if (capacity == 0)
+                {
+                    return;
+                }
+            entry_iterator i = find (p, h);
+            if (i != entries.end ())
+                {
+                    // stored by another thread meanwhile
+                    entries.splice (entries.begin (), entries, i);
+                    i->value = v;
+                    return;
+                }
+            entries.push_front (entry ());
+            entry &e = entries.front ();
+            e.key.resize (key_trait::size (p));
+            for (size_t k = 0; k < e.key.size (); ++k)
+                {
+                    e.key[k] = key_trait::element (p, k);
+                }
+            e.hash = h;
+            e.value = v;
+            index.insert (std::make_pair (h, entries.begin ()));
+            evict ();
+        }
+
+        /**
+           remove all the entries and reset the counters
+         */
+        void clear ()
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            entries.clear ();
+            index.clear ();
+            n_hits = 0;
+            n_misses = 0;
+        }
+
+        void set_capacity (size_t n)
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            capacity = n;
+            evict ();
+        }
+
+        size_t get_capacity () const
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            return capacity;
+        }
+
+        /**
+           \return the number of stored entries
+         */
+        size_t size () const
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            return entries.size ();
+        }
+
+        unsigned long long num_hits () const
+        {
+            return n_hits.load ();
+        }
+
+        unsigned long long num_misses () const
+        {
+            return n_misses.load ();
+        }
+
+        /**
+           \return hits/(hits+misses), 0 if nothing has been looked up
+         */
+        double hit_rate () const
+        {
+            unsigned long long h = num_hits ();
+            unsigned long long m = num_misses ();
+            return h + m == 0 ? 0. : double (h) / double (h + m);
+        }
+    };
+}
+
+#endif
+// EOF
@@ -0,0 +1,89 @@
+/**
+   \file eval_executor.hpp
+   \brief the process-wide executor of func_obj::eval_many
+   \author Junhua Gu
+ */
+
+#ifndef EVAL_EXECUTOR_HPP
+#define EVAL_EXECUTOR_HPP
+#define OPT_HEADER
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace opt_utilities
+{
+    /**
+       \brief The thread pool shared by all the batch evaluations of the
+       process, see func_obj::eval_many.
+       A batch is split over the threads by thread_pool::parallel_ranges,
+       and every thread evaluates its points on its own clone of the
+       object function, so the object function must be safe to evaluate
+       on different clones concurrently.
+       By default the executor is serial, and the batches are evaluated
+       in order on the calling thread.
+     */
+    class eval_executor
+    {
+      private:
+        std::shared_ptr<thread_pool> p_pool;
+        mutable std::mutex mtx;
+
+      private:
+        eval_executor ()
+        {
+        }
+
+        eval_executor (const eval_executor &);
+        eval_executor &operator= (const eval_executor &);
+
+      public:
+        /**
+           \return the executor of the process
+         */
+        static eval_executor &instance ()
+        {
+            static eval_executor executor;
+            return executor;
+        }
+
+        /**
+           evaluate the batches on n threads
+           \param n the number of threads, 0 for all the cores, 1 (the default) for serial
+         */
+        void set_num_threads (size_t n)
+        {
+            set_thread_pool (n == 1 ? std::shared_ptr<thread_pool> () : std::shared_ptr<thread_pool> (new thread_pool (n)));
+        }
+
+        /**
+           Same as set_num_threads, but use an existing thread pool
+           \param pool the pool, an empty pointer for serial
+         */
+        void set_thread_pool (const std::shared_ptr<thread_pool> &pool)
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            p_pool = pool;
+        }
+
+        /**
+           \return the pool, or an empty pointer if serial; the batches
+           running when the pool is replaced keep using the old one
+         */
+        std::shared_ptr<thread_pool> get_thread_pool () const
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            return p_pool;
+        }
+
+        size_t get_num_threads () const
+        {
+            std::lock_guard<std::mutex> lk (mtx);
+            return p_pool ? p_pool->get_num_threads () : 1;
+        }
+    };
+}
+
+#endif
+// EOF
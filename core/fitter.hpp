@@ -9,12 +9,19 @@
 #define OPT_HEADER
 #include "opt_exception.hpp"
 #include "optimizer.hpp"
+#include "thread_pool.hpp"
+#include "multistart.hpp"
+#include "../math/num_diff.hpp"
 #include <limits>
 #include <vector>
 #include <string>
 #include <cstdlib>
 #include <cassert>
 #include <iostream>
+#include <type_traits>
+#include <algorithm>
+#include <memory>
+#include <atomic>
 namespace opt_utilities
 {
 
@@ -239,6 +246,43 @@ namespace opt_utilities
         virtual void do_add_data (const Tdata &) = 0;
         virtual void do_clear () = 0;
         virtual data_set<Tdata> *do_clone () const = 0;
+
+        /**
+           Overwrite these functions in data sets that store each field
+           in a contiguous array, so that the statistics can stream them.
+           \return the pointer to the first element of the column,
+           or NULL_PTR if the data set is not stored in columns
+         */
+        virtual const Tx *do_get_x_column () const
+        {
+            return NULL_PTR;
+        }
+
+        virtual const Tx *do_get_x_lower_err_column () const
+        {
+            return NULL_PTR;
+        }
+
+        virtual const Tx *do_get_x_upper_err_column () const
+        {
+            return NULL_PTR;
+        }
+
+        virtual const Ty *do_get_y_column () const
+        {
+            return NULL_PTR;
+        }
+
+        virtual const Ty *do_get_y_lower_err_column () const
+        {
+            return NULL_PTR;
+        }
+
+        virtual const Ty *do_get_y_upper_err_column () const
+        {
+            return NULL_PTR;
+        }
+
         /**
            \return the type name of self
          */
@@ -316,6 +360,65 @@ namespace opt_utilities
             return do_size ();
         }
 
+        /**
+           \return whether all the columns can be accessed directly,
+           see get_x_column etc.
+         */
+        bool is_columnar () const
+        {
+            return do_get_x_column () != NULL_PTR && do_get_y_column () != NULL_PTR &&
+                   do_get_x_lower_err_column () != NULL_PTR && do_get_x_upper_err_column () != NULL_PTR &&
+                   do_get_y_lower_err_column () != NULL_PTR && do_get_y_upper_err_column () != NULL_PTR;
+        }
+
+        /**
+           \return the contiguous array of x, or NULL_PTR if not available
+         */
+        const Tx *get_x_column () const
+        {
+            return do_get_x_column ();
+        }
+
+        /**
+           \return the contiguous array of x_lower_err, or NULL_PTR if not available
+         */
+        const Tx *get_x_lower_err_column () const
+        {
+            return do_get_x_lower_err_column ();
+        }
+
+        /**
+           \return the contiguous array of x_upper_err, or NULL_PTR if not available
+         */
+        const Tx *get_x_upper_err_column () const
+        {
+            return do_get_x_upper_err_column ();
+        }
+
+        /**
+           \return the contiguous array of y, or NULL_PTR if not available
+         */
+        const Ty *get_y_column () const
+        {
+            return do_get_y_column ();
+        }
+
+        /**
+           \return the contiguous array of y_lower_err, or NULL_PTR if not available
+         */
+        const Ty *get_y_lower_err_column () const
+        {
+            return do_get_y_lower_err_column ();
+        }
+
+        /**
+           \return the contiguous array of y_upper_err, or NULL_PTR if not available
+         */
+        const Ty *get_y_upper_err_column () const
+        {
+            return do_get_y_upper_err_column ();
+        }
+
       public:
         // set functions
 
@@ -343,6 +446,158 @@ namespace opt_utilities
     };
 
 
+    /**
+       \brief read-only view of another data set.
+       Cloning a view does not copy the data, so many fitters can share
+       one loaded data set, e.g., the workers of fitter::fit_multistart.
+       The viewed data set must outlive the view and all its clones.
+       \tparam Tdata the type of data point
+     */
+    template <typename Tdata> class data_set_view : public data_set<Tdata>
+    {
+      public:
+        typedef typename Tdata::Ty Ty;
+        typedef typename Tdata::Tx Tx;
+
+      private:
+        const data_set<Tdata> *p_target;
+
+        const Tdata &do_get_data (size_t i) const
+        {
+            return p_target->get_data (i);
+        }
+
+        size_t do_size () const
+        {
+            return p_target->size ();
+        }
+
+        void do_add_data (const Tdata &)
+        {
+            throw data_unsetable ();
+        }
+
+        void do_clear ()
+        {
+            throw data_unsetable ();
+        }
+
+        data_set<Tdata> *do_clone () const
+        {
+            return new data_set_view<Tdata> (*this);
+        }
+
+        const Tx *do_get_x_column () const
+        {
+            return p_target->get_x_column ();
+        }
+
+        const Tx *do_get_x_lower_err_column () const
+        {
+            return p_target->get_x_lower_err_column ();
+        }
+
+        const Tx *do_get_x_upper_err_column () const
+        {
+            return p_target->get_x_upper_err_column ();
+        }
+
+        const Ty *do_get_y_column () const
+        {
+            return p_target->get_y_column ();
+        }
+
+        const Ty *do_get_y_lower_err_column () const
+        {
+            return p_target->get_y_lower_err_column ();
+        }
+
+        const Ty *do_get_y_upper_err_column () const
+        {
+            return p_target->get_y_upper_err_column ();
+        }
+
+      public:
+        /**
+           \param target the data set to be viewed
+         */
+        explicit data_set_view (const data_set<Tdata> &target) : p_target (&target)
+        {
+        }
+    };
+
+
+    /**
+       \brief Reads the fields of the data points of a data set, from the
+       columns if it has them, see data_set::is_columnar, otherwise through
+       get_data, so that the statistics do not need the records of a
+       columnar_data_set.
+       It is cheap to copy, e.g., into the functors of the statistics.
+       \tparam Tdata the type of data point
+     */
+    template <typename Tdata> class data_fields
+    {
+      public:
+        typedef typename Tdata::Ty Ty;
+        typedef typename Tdata::Tx Tx;
+
+      private:
+        const data_set<Tdata> *p_data_set;
+        const Tx *xs;
+        const Tx *x_lower_errs;
+        const Tx *x_upper_errs;
+        const Ty *ys;
+        const Ty *y_lower_errs;
+        const Ty *y_upper_errs;
+
+      public:
+        explicit data_fields (const data_set<Tdata> &ds)
+        : p_data_set (&ds), xs (NULL_PTR), x_lower_errs (NULL_PTR), x_upper_errs (NULL_PTR), ys (NULL_PTR),
+          y_lower_errs (NULL_PTR), y_upper_errs (NULL_PTR)
+        {
+            if (ds.is_columnar ())
+                {
+                    xs = ds.get_x_column ();
+                    x_lower_errs = ds.get_x_lower_err_column ();
+                    x_upper_errs = ds.get_x_upper_err_column ();
+                    ys = ds.get_y_column ();
+                    y_lower_errs = ds.get_y_lower_err_column ();
+                    y_upper_errs = ds.get_y_upper_err_column ();
+                }
+        }
+
+        const Tx &x (size_t i) const
+        {
+            return xs != NULL_PTR ? xs[i] : p_data_set->get_data (i).get_x ();
+        }
+
+        const Tx &x_lower_err (size_t i) const
+        {
+            return x_lower_errs != NULL_PTR ? x_lower_errs[i] : p_data_set->get_data (i).get_x_lower_err ();
+        }
+
+        const Tx &x_upper_err (size_t i) const
+        {
+            return x_upper_errs != NULL_PTR ? x_upper_errs[i] : p_data_set->get_data (i).get_x_upper_err ();
+        }
+
+        const Ty &y (size_t i) const
+        {
+            return ys != NULL_PTR ? ys[i] : p_data_set->get_data (i).get_y ();
+        }
+
+        const Ty &y_lower_err (size_t i) const
+        {
+            return y_lower_errs != NULL_PTR ? y_lower_errs[i] : p_data_set->get_data (i).get_y_lower_err ();
+        }
+
+        const Ty &y_upper_err (size_t i) const
+        {
+            return y_upper_errs != NULL_PTR ? y_upper_errs[i] : p_data_set->get_data (i).get_y_upper_err ();
+        }
+    };
+
+
     /**
        \brief the information of a model parameter
        \tparam Tp type of model param type
@@ -558,6 +813,44 @@ namespace opt_utilities
          */
         virtual Ty do_eval (const Tx &x, const Tp &p) = 0;
 
+        /**
+           Can be overrided to evaluate the model on a batch of self-vars.
+           The default implement calls do_eval point by point.
+           \param xs the self-vars
+           \param n the number of self-vars
+           \param p the complete parameter
+           \param out the model values, should have room for n elements
+         */
+        virtual void do_eval_batch (const Tx *xs, size_t n, const Tp &p, Ty *out)
+        {
+            for (size_t i = 0; i < n; ++i)
+                {
+                    opt_assign (out[i], do_eval (xs[i], p));
+                }
+        }
+
+        /**
+           Can be overrided, together with do_provides_grad, to supply the
+           analytic derivatives of the model with respect to the complete
+           parameter list, which the statistics use to compute their gradients.
+           \param x the self-var
+           \param p the complete parameter
+           \param y the model value
+           \param dy_dp the derivatives, dy/dp_i for every parameter
+         */
+        virtual void do_eval_grad (const Tx &, const Tp &, Ty &, Tp &)
+        {
+            throw gradient_not_available ();
+        }
+
+        /**
+           \return whether do_eval_grad is implemented
+         */
+        virtual bool do_provides_grad () const
+        {
+            return false;
+        }
+
         /**
            Can be overrided to return a piece of information of the model.
            The default implement returns a empty string.
@@ -1061,6 +1354,37 @@ namespace opt_utilities
             return p_param_modifier->deform (p);
         }
 
+        /**
+           Same as reform_param, but write the complete parameter list into
+           a caller-owned buffer, which is reused across calls
+           \param p the input incomplete parameter list
+           \param out the output complete parameter list
+         */
+        void reform_param_into (const Tp &p, Tp &out) const
+        {
+            if (p_param_modifier == NULL_PTR)
+                {
+                    opt_assign (out, p);
+                    return;
+                }
+            p_param_modifier->reform_into (p, out);
+        }
+
+        /**
+           Same as deform_param, but write into a caller-owned buffer
+           \param p the complete parameter list
+           \param out the vanished parameter list
+         */
+        void deform_param_into (const Tp &p, Tp &out) const
+        {
+            if (p_param_modifier == NULL_PTR)
+                {
+                    opt_assign (out, p);
+                    return;
+                }
+            p_param_modifier->deform_into (p, out);
+        }
+
         /**
            evaluate the model
            \param x the self var
@@ -1082,6 +1406,97 @@ namespace opt_utilities
             // return do_eval(x,reform_param(p));
             return do_eval (x, p);
         }
+
+        /**
+           evaluate the model on a batch of self-vars,
+           the param_modifier is applied only once for the whole batch.
+           \param xs the self-vars
+           \param n the number of self-vars
+           \param p the parameter
+           \param out the model values, should have room for n elements
+         */
+        void eval_batch (const Tx *xs, size_t n, const Tp &p, Ty *out)
+        {
+            do_eval_batch (xs, n, reform_param (p), out);
+        }
+
+        /**
+           evaluate the model with a parameter that has already been
+           reformed by reform_param, so that the param_modifier need not
+           be applied again for every data point.
+           \param x the self var
+           \param p the complete parameter
+           \return the model value
+         */
+        Ty eval_reformed (const Tx &x, const Tp &p)
+        {
+            return do_eval (x, p);
+        }
+
+        /**
+           evaluate the model on a batch of self-vars with a parameter
+           that has already been reformed by reform_param
+           \param xs the self-vars
+           \param n the number of self-vars
+           \param p the complete parameter
+           \param out the model values, should have room for n elements
+         */
+        void eval_batch_reformed (const Tx *xs, size_t n, const Tp &p, Ty *out)
+        {
+            do_eval_batch (xs, n, p, out);
+        }
+
+        /**
+           \return whether the model supplies analytic derivatives
+         */
+        bool provides_grad () const
+        {
+            return do_provides_grad ();
+        }
+
+        /**
+           evaluate the model and its derivatives with respect to
+           the complete parameter list, the param_modifier is not applied
+           \param x the self var
+           \param p the complete parameter
+           \param y the model value
+           \param dy_dp the derivatives, resized to the number of parameters
+         */
+        void eval_grad_reformed (const Tx &x, const Tp &p, Ty &y, Tp &dy_dp)
+        {
+            if (get_size (dy_dp) != get_size (p))
+                {
+                    resize (dy_dp, get_size (p));
+                }
+            do_eval_grad (x, p, y, dy_dp);
+        }
+
+        /**
+           \return whether the gradient with respect to the complete parameter
+           list can be converted into that with respect to the free parameters,
+           see chain_gradient
+         */
+        bool can_chain_gradient () const
+        {
+            return p_param_modifier == NULL_PTR || p_param_modifier->provides_chain_gradient ();
+        }
+
+        /**
+           convert the gradient with respect to the complete parameter list into
+           the gradient with respect to the parameters passed to eval
+           \param p the incomplete parameter list
+           \param grad_full the gradient with respect to the complete list
+           \param grad the output gradient
+         */
+        void chain_gradient (const Tp &p, const Tp &grad_full, Tp &grad) const
+        {
+            if (p_param_modifier == NULL_PTR)
+                {
+                    opt_assign (grad, grad_full);
+                    return;
+                }
+            p_param_modifier->chain_gradient (p, grad_full, grad);
+        }
     };
 
 
@@ -1202,6 +1617,22 @@ namespace opt_utilities
             return p_model->eval (x, p);
         }
 
+        /**
+           evaluate the model on a batch of self-vars
+           \param xs the self-vars
+           \param n the number of self-vars
+           \param p the parameter
+           \param out the model values, should have room for n elements
+         */
+        void eval_model_batch (const Tx *xs, size_t n, const Tp &p, Ty *out)
+        {
+            if (p_model == NULL_PTR)
+                {
+                    throw model_not_defined ();
+                }
+            p_model->eval_batch (xs, n, p, out);
+        }
+
         /**
            evaluate the model, ignore the param_modifier
            \param x the varible
@@ -1325,6 +1756,38 @@ namespace opt_utilities
             return optengine.get_opt_method ();
         }
 
+        /**
+           Get the evaluation counts, timings and trace of the last fit
+           \return the reference of the optimizer_stats
+         */
+        optimizer_stats<Ts, Tp> &get_stats ()
+        {
+            return optengine.get_stats ();
+        }
+
+        const optimizer_stats<Ts, Tp> &get_stats () const
+        {
+            return optengine.get_stats ();
+        }
+
+        /**
+           Cache the statistic of the last n parameters during a fit,
+           see optimizer::set_cache_size
+           \param n the capacity of the cache, 0 disables it
+         */
+        void set_cache_size (size_t n)
+        {
+            optengine.set_cache_size (n);
+        }
+
+        /**
+           \return the evaluation cache of the last fit, or NULL_PTR if disabled
+         */
+        const eval_cache<Ts, Tp> *get_cache () const
+        {
+            return optengine.get_cache ();
+        }
+
 
         /**
            Get the inner kept param modifier
@@ -1784,6 +2247,111 @@ namespace opt_utilities
             return p_model->get_all_params ();
         }
 
+        /**
+           Fit from many start points, drawn by a sampler inside the limits
+           of the free parameters, which therefore must be finite.
+           The fits run on n_threads copies of this fitter, which share the
+           loaded data set; the start points are handed out one at a time
+           to whichever copy becomes idle, so slow fits do not hold up the
+           others. The result does not depend on the number of threads.
+           On return the parameters of this fitter are set to the best fit.
+           \param n_starts the number of start points
+           \param sampler the sampler of the start points, e.g., latin_hypercube_sampler
+           \param n_threads the number of threads, 0 for all the cores
+           \return the best fit and every local fit
+         */
+        multistart_result<Tp, Ts> fit_multistart (size_t n_starts, const start_sampler &sampler, size_t n_threads = 0)
+        {
+            if (p_model == NULL_PTR)
+                {
+                    throw model_not_defined ();
+                }
+            if (p_data_set == NULL_PTR)
+                {
+                    throw data_not_loaded ();
+                }
+            if (p_statistic == NULL_PTR)
+                {
+                    throw statistic_not_defined ();
+                }
+            multistart_result<Tp, Ts> result;
+            if (n_starts == 0)
+                {
+                    throw opt_exception ("fit_multistart needs at least one start point");
+                }
+
+            Tp lower_limits;
+            Tp upper_limits;
+            opt_assign (lower_limits, p_model->deform_param (p_model->get_all_lower_limits ()));
+            opt_assign (upper_limits, p_model->deform_param (p_model->get_all_upper_limits ()));
+            size_t dim = get_size (lower_limits);
+            for (size_t j = 0; j < dim; ++j)
+                {
+                    typename element_type_trait<Tp>::element_type width =
+                    get_element (upper_limits, j) - get_element (lower_limits, j);
+                    if (!(width > 0) || !(width < std::numeric_limits<typename element_type_trait<Tp>::element_type>::max ()))
+                        {
+                            throw opt_exception ("fit_multistart needs finite limits of the free parameters");
+                        }
+                }
+
+            std::vector<double> u;
+            sampler.sample (n_starts, dim, u);
+            std::vector<Tp> starts (n_starts);
+            for (size_t i = 0; i < n_starts; ++i)
+                {
+                    Tp free_param;
+                    resize (free_param, dim);
+                    for (size_t j = 0; j < dim; ++j)
+                        {
+                            set_element (free_param, j,
+                                         get_element (lower_limits, j) +
+                                         u[i * dim + j] * (get_element (upper_limits, j) - get_element (lower_limits, j)));
+                        }
+                    opt_assign (starts[i], p_model->reform_param (free_param));
+                }
+
+            data_set_view<Tdata> shared_data (*p_data_set);
+
+            thread_pool pool (n_threads);
+            size_t n_workers = std::min (pool.get_num_threads (), n_starts);
+            std::vector<std::unique_ptr<fitter>> workers (n_workers);
+            for (size_t w = 0; w < n_workers; ++w)
+                {
+                    workers[w].reset (new fitter);
+                    workers[w]->set_model (*p_model);
+                    workers[w]->set_statistic (*p_statistic);
+                    workers[w]->load_data (shared_data);
+                    workers[w]->optengine = optengine;
+                }
+
+            result.fits.resize (n_starts);
+            std::atomic<size_t> next_start (0);
+            std::vector<multistart_fit<Tp, Ts>> &fits = result.fits;
+            pool.parallel_for (n_workers, [&workers, &starts, &fits, &next_start, n_starts](size_t w) {
+                fitter &f = *workers[w];
+                for (;;)
+                    {
+                        size_t i = next_start.fetch_add (1);
+                        if (i >= n_starts)
+                            {
+                                break;
+                            }
+                        f.p_model->set_param_value (starts[i]);
+                        fits[i].start_index = i;
+                        opt_assign (fits[i].start_param, starts[i]);
+                        opt_assign (fits[i].param, f.fit ());
+                        fits[i].statistic_value = f.get_statistic_value ();
+                    }
+            });
+
+            std::stable_sort (fits.begin (), fits.end (), multistart_fit_less ());
+            opt_assign (result.best_param, fits[0].param);
+            result.best_statistic_value = fits[0].statistic_value;
+            p_model->set_param_value (result.best_param);
+            return result;
+        }
+
         /**
            stop the fitting
         */
@@ -1791,11 +2359,23 @@ namespace opt_utilities
         {
             optengine.stop ();
         }
+
+      private:
+        struct multistart_fit_less
+        {
+            bool operator() (const multistart_fit<Tp, Ts> &a, const multistart_fit<Tp, Ts> &b) const
+            {
+                return a.statistic_value < b.statistic_value;
+            }
+        };
     };
 
 
     /**
        \brief virtual class representing a statistic
+       The gradient of a statistic is computed by numerical differentiation
+       by default. A statistic can override do_gradient to compute it from
+       the analytic derivatives of the model, see sum_gradient_over_data.
        \tparam Ty the type of the model return type
        \tparam Tx the type of the model self-var
        \tparam Tp the type of the model param
@@ -1803,7 +2383,7 @@ namespace opt_utilities
        \tparam Tstr the type of string used
     */
     template <typename Tdata, typename Tp, typename Ts, typename Tstr = std::string>
-    class statistic : public func_obj<Ts, Tp>
+    class statistic : public diff_func_obj<Ts, Tp>
     {
       public:
         typedef typename Tdata::Ty Ty;
@@ -1811,6 +2391,15 @@ namespace opt_utilities
 
       private:
         fitter<Tdata, Tp, Ts, Tstr> *p_fitter;
+        std::vector<Tx> x_buffer;
+        std::vector<Ty> y_buffer;
+        Tp reformed_param;
+        std::shared_ptr<thread_pool> p_pool;
+        size_t chunk_size;
+        std::vector<Ts> partial_sums;
+        Tp grad_full;
+        Tp dy_dp;
+        Tp grad_free;
 
       private:
         virtual statistic<Tdata, Tp, Ts, Tstr> *do_clone () const = 0;
@@ -1820,6 +2409,42 @@ namespace opt_utilities
             delete this;
         }
 
+        /**
+           The default gradient is computed by central differences
+         */
+        virtual Tp do_gradient (const Tp &p)
+        {
+            return numeric_gradient (p);
+        }
+
+        typedef typename element_type_trait<Tp>::element_type Te;
+
+        template <typename W>
+        static Te scale_derivative (const W &w, const Te &d, typename std::enable_if<std::is_arithmetic<W>::value>::type * = 0)
+        {
+            return w * d;
+        }
+
+        template <typename W>
+        static Te scale_derivative (const W &, const Te &, typename std::enable_if<!std::is_arithmetic<W>::value>::type * = 0)
+        {
+            throw gradient_not_available ();
+        }
+
+        static Ts pairwise_sum (const Ts *x, size_t n)
+        {
+            if (n == 0)
+                {
+                    return Ts (0);
+                }
+            if (n == 1)
+                {
+                    return x[0];
+                }
+            size_t h = n / 2;
+            return pairwise_sum (x, h) + pairwise_sum (x + h, n - h);
+        }
+
         /**
            \return the type name of self
         */
@@ -1833,7 +2458,7 @@ namespace opt_utilities
         /**
            default construct
         */
-        statistic () : p_fitter (NULL_PTR)
+        statistic () : p_fitter (NULL_PTR), chunk_size (0)
         {
         }
 
@@ -1841,7 +2466,8 @@ namespace opt_utilities
            copy construct
         */
         statistic (const statistic &rhs)
-        : func_obj<Ts, Tp> (static_cast<const func_obj<Ts, Tp> &> (rhs)), p_fitter (rhs.p_fitter)
+        : diff_func_obj<Ts, Tp> (static_cast<const diff_func_obj<Ts, Tp> &> (rhs)), p_fitter (rhs.p_fitter),
+          p_pool (rhs.p_pool), chunk_size (rhs.chunk_size)
         {
         }
 
@@ -1855,6 +2481,8 @@ namespace opt_utilities
                     return *this;
                 }
             p_fitter = rhs.p_fitter;
+            p_pool = rhs.p_pool;
+            chunk_size = rhs.chunk_size;
             return *this;
         }
 
@@ -1901,10 +2529,58 @@ namespace opt_utilities
         */
         virtual void set_fitter (fitter<Tdata, Tp, Ts, Tstr> &pfitter)
         {
+            this->release_clones ();
             p_fitter = &pfitter;
         }
 
 
+        /**
+           Evaluate the statistic with several threads.
+           The data set is split into chunks of a fixed size, whose partial
+           sums are added up in a fixed pairwise order, so the result does not
+           depend on the number of threads, nor on the scheduling.
+           It may differ from the serial result in the last bits, though.
+           The model is evaluated concurrently on different chunks, so its
+           do_eval and do_eval_batch must be reentrant.
+           The clones of this statistic share the same pool.
+           \param nthreads the number of threads, 0 for all the cores
+           \param chunk the number of data points in one chunk
+         */
+        void set_parallel (size_t nthreads, size_t chunk = 16384)
+        {
+            set_thread_pool (std::shared_ptr<thread_pool> (new thread_pool (nthreads)), chunk);
+        }
+
+        /**
+           Same as set_parallel, but use an existing thread pool
+           \param pool the pool to be shared
+           \param chunk the number of data points in one chunk
+         */
+        void set_thread_pool (const std::shared_ptr<thread_pool> &pool, size_t chunk = 16384)
+        {
+            this->release_clones ();
+            p_pool = pool;
+            chunk_size = chunk == 0 ? 1 : chunk;
+        }
+
+        /**
+           go back to the serial evaluation
+         */
+        void set_serial ()
+        {
+            this->release_clones ();
+            p_pool.reset ();
+            chunk_size = 0;
+        }
+
+        /**
+           \return whether the parallel evaluation is enabled
+         */
+        bool is_parallel () const
+        {
+            return p_pool.get () != NULL_PTR;
+        }
+
         /**
            get the attached fitter
            \return the const reference of the fitter object
@@ -1933,6 +2609,230 @@ namespace opt_utilities
             return p_fitter->eval_model (x, p);
         }
 
+        /**
+           Reform the parameter once, and keep the complete parameter
+           for the following calls of eval_model_reformed.
+           \param p the parameter, as passed to do_eval
+           \return the complete parameter
+         */
+        const Tp &prepare_param (const Tp &p)
+        {
+            if (p_fitter == NULL_PTR)
+                {
+                    throw fitter_not_set ();
+                }
+            p_fitter->get_model ().reform_param_into (p, reformed_param);
+            return reformed_param;
+        }
+
+        /**
+           evaluating the model with the parameter kept by the last call of prepare_param
+           \param x the self-var
+           \return the evaluated model value
+         */
+        Ty eval_model_reformed (const Tx &x)
+        {
+            if (p_fitter == NULL_PTR)
+                {
+                    throw fitter_not_set ();
+                }
+            return p_fitter->get_model ().eval_reformed (x, reformed_param);
+        }
+
+        /**
+           evaluating the model on a batch of self-vars
+           \param xs the self-vars
+           \param n the number of self-vars
+           \param p the parameter
+           \param out the model values, should have room for n elements
+         */
+        void eval_model_batch (const Tx *xs, size_t n, const Tp &p, Ty *out)
+        {
+            if (p_fitter == NULL_PTR)
+                {
+                    throw fitter_not_set ();
+                }
+            p_fitter->eval_model_batch (xs, n, p, out);
+        }
+
+        /**
+           evaluating the model on all the self-vars of the data set in one batch
+           \param p the parameter
+           \return the model values, in the same order as the data set,
+           valid until the next call
+         */
+        const std::vector<Ty> &eval_model_on_data_set (const Tp &p)
+        {
+            const data_set<Tdata> &ds = get_data_set ();
+            size_t n = ds.size ();
+            y_buffer.resize (n);
+            const Tx *xs = ds.get_x_column ();
+            if (xs == NULL_PTR)
+                {
+                    x_buffer.resize (n);
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            opt_assign (x_buffer[i], ds.get_data (i).get_x ());
+                        }
+                    xs = n != 0 ? &x_buffer[0] : NULL_PTR;
+                }
+            prepare_param (p);
+            if (is_parallel () && n > chunk_size)
+                {
+                    model<Tdata, Tp, Tstr> &m = p_fitter->get_model ();
+                    const Tp &rp = reformed_param;
+                    Ty *ys = &y_buffer[0];
+                    size_t cs = chunk_size;
+                    p_pool->parallel_for ((n + cs - 1) / cs, [&m, &rp, xs, ys, n, cs](size_t c) {
+                        size_t b = c * cs;
+                        size_t e = b + cs < n ? b + cs : n;
+                        m.eval_batch_reformed (xs + b, e - b, rp, ys + b);
+                    });
+                }
+            else if (n != 0)
+                {
+                    p_fitter->get_model ().eval_batch_reformed (xs, n, reformed_param, &y_buffer[0]);
+                }
+            return y_buffer;
+        }
+
+        /**
+           Sum term(i) over all the data points.
+           In the serial mode the terms are added from the last data point
+           to the first one, as the statistics always did.
+           In the parallel mode, see set_parallel, the data points are split into
+           fixed-size chunks, which are summed concurrently and then reduced
+           in a fixed pairwise order, so that the result is bit-identical for
+           any number of threads.
+           \param n the number of data points
+           \param term the functor returning the contribution of the i-th point,
+           it must be safe to be called concurrently
+           \return the sum
+         */
+        template <typename F> Ts sum_over_data (size_t n, const F &term)
+        {
+            if (!is_parallel ())
+                {
+                    Ts result (0);
+                    for (int i = n - 1; i >= 0; --i)
+                        {
+                            result += term (i);
+                        }
+                    return result;
+                }
+            size_t cs = chunk_size;
+            size_t nchunks = (n + cs - 1) / cs;
+            partial_sums.assign (nchunks, Ts (0));
+            Ts *sums = nchunks == 0 ? NULL_PTR : &partial_sums[0];
+            p_pool->parallel_for (nchunks, [&term, sums, n, cs](size_t c) {
+                size_t b = c * cs;
+                size_t e = b + cs < n ? b + cs : n;
+                Ts s (0);
+                for (size_t i = b; i < e; ++i)
+                    {
+                        s += term (i);
+                    }
+                sums[c] = s;
+            });
+            return pairwise_sum (sums, nchunks);
+        }
+
+        /**
+           the gradient by central differences, see gradient in num_diff.hpp
+           \param p the parameter
+           \return the gradient
+         */
+        Tp numeric_gradient (const Tp &p)
+        {
+            return central_gradient (static_cast<func_obj<Ts, Tp> &> (*this), p);
+        }
+
+        /**
+           \return whether the model supplies analytic derivatives, and
+           the param_modifier, if any, can chain them, so that
+           sum_gradient_over_data can be used
+         */
+        bool analytic_gradient_available () const
+        {
+            if (p_fitter == NULL_PTR)
+                {
+                    throw fitter_not_set ();
+                }
+            return std::is_arithmetic<Ty>::value && p_fitter->get_model ().provides_grad () &&
+                   p_fitter->get_model ().can_chain_gradient ();
+        }
+
+        /**
+           Compute the gradient of a statistic of the form sum_i f_i(y_model(x_i))
+           from the analytic derivatives of the model, with the chain rule
+           through the param_modifier.
+           \param p the parameter, as passed to do_gradient
+           \param weight the functor returning df_i/dy_model given i and y_model(x_i)
+           \return the gradient with respect to p
+         */
+        template <typename F> Tp sum_gradient_over_data (const Tp &p, const F &weight)
+        {
+            const data_set<Tdata> &ds = get_data_set ();
+            model<Tdata, Tp, Tstr> &m = p_fitter->get_model ();
+            prepare_param (p);
+            size_t np = get_size (reformed_param);
+            resize (grad_full, np);
+            for (size_t k = 0; k < np; ++k)
+                {
+                    set_element (grad_full, k, Te (0));
+                }
+            const data_fields<Tdata> fields (ds);
+            Ty y;
+            for (int i = ds.size () - 1; i >= 0; --i)
+                {
+                    m.eval_grad_reformed (fields.x (i), reformed_param, y, dy_dp);
+                    const Te w = scale_derivative (weight (i, y), Te (1));
+                    for (size_t k = 0; k < np; ++k)
+                        {
+                            set_element (grad_full, k, get_element (grad_full, k) + w * get_element (dy_dp, k));
+                        }
+                }
+            Tp result;
+            m.chain_gradient (p, grad_full, result);
+            return result;
+        }
+
+        /**
+           Compute the residuals r_i(y_model(x_i)) of a least-squares statistic
+           and their Jacobian with respect to p, from the analytic derivatives
+           of the model. Only valid when analytic_gradient_available() is true.
+           \param p the parameter, as passed to do_eval
+           \param r the residuals, one per data point
+           \param jac the Jacobian in row-major order
+           \param f the functor f(i, y_model, r_i) that sets the i-th residual and
+           returns dr_i/dy_model
+         */
+        template <typename F> void fill_residual_jacobian (const Tp &p, Ts *r, Ts *jac, const F &f)
+        {
+            const data_set<Tdata> &ds = get_data_set ();
+            model<Tdata, Tp, Tstr> &m = p_fitter->get_model ();
+            prepare_param (p);
+            size_t np = get_size (reformed_param);
+            size_t nfree = get_size (p);
+            resize (grad_full, np);
+            const data_fields<Tdata> fields (ds);
+            Ty y;
+            for (size_t i = 0; i < ds.size (); ++i)
+                {
+                    m.eval_grad_reformed (fields.x (i), reformed_param, y, dy_dp);
+                    const Te w = scale_derivative (f (i, y, r[i]), Te (1));
+                    for (size_t k = 0; k < np; ++k)
+                        {
+                            set_element (grad_full, k, w * get_element (dy_dp, k));
+                        }
+                    m.chain_gradient (p, grad_full, grad_free);
+                    for (size_t k = 0; k < nfree; ++k)
+                        {
+                            jac[i * nfree + k] = get_element (grad_free, k);
+                        }
+                }
+        }
+
         /**
            get the data_set object managed by the fitter object
            \return the const reference of the data_set object
@@ -1982,6 +2882,49 @@ namespace opt_utilities
            \return the vanished parameter list
          */
         virtual Tp do_deform (const Tp &p) const = 0;
+
+        /**
+           Same as do_reform, but write the result into a caller-owned buffer,
+           so that no temporary parameter list needs to be allocated.
+           The default implementation falls back to do_reform.
+           \param p the vanished parameter list
+           \param out the complete parameter list
+         */
+        virtual void do_reform_into (const Tp &p, Tp &out) const
+        {
+            opt_assign (out, do_reform (p));
+        }
+
+        /**
+           Same as do_deform, but write the result into a caller-owned buffer.
+           The default implementation falls back to do_deform.
+           \param p the complete parameter list
+           \param out the vanished parameter list
+         */
+        virtual void do_deform_into (const Tp &p, Tp &out) const
+        {
+            opt_assign (out, do_deform (p));
+        }
+
+        /**
+           Can be overrided, together with do_provides_chain_gradient,
+           to apply the chain rule through do_reform, i.e., to convert
+           the gradient with respect to the complete parameter list
+           into that with respect to the vanished parameter list.
+           \param p the vanished parameter list
+           \param grad_full the gradient with respect to the complete list
+           \param grad the gradient with respect to the vanished list
+         */
+        virtual void do_chain_gradient (const Tp &, const Tp &, Tp &) const
+        {
+            throw gradient_not_available ();
+        }
+
+        virtual bool do_provides_chain_gradient () const
+        {
+            return false;
+        }
+
         virtual size_t do_get_num_free_params () const = 0;
         virtual Tstr do_report_param_status (const Tstr &) const = 0;
         virtual void update ()
@@ -2073,6 +3016,41 @@ namespace opt_utilities
             return do_deform (p);
         }
 
+        /**
+           constructing full parameter list from the free parameters,
+           writing into out
+         */
+        void reform_into (const Tp &p, Tp &out) const
+        {
+            do_reform_into (p, out);
+        }
+
+        /**
+           constructing the free parameter from the full parameters,
+           writing into out
+         */
+        void deform_into (const Tp &p, Tp &out) const
+        {
+            do_deform_into (p, out);
+        }
+
+        /**
+           \return whether chain_gradient is supported
+         */
+        bool provides_chain_gradient () const
+        {
+            return do_provides_chain_gradient ();
+        }
+
+        /**
+           convert the gradient with respect to the complete parameters into
+           the gradient with respect to the free parameters
+         */
+        void chain_gradient (const Tp &p, const Tp &grad_full, Tp &grad) const
+        {
+            do_chain_gradient (p, grad_full, grad);
+        }
+
 
       public:
         /**
@@ -31,12 +31,19 @@ namespace opt_utilities
         std::set<Tstr> param_names;
         std::vector<size_t> param_num;
         size_t num_free;
+        // index maps built by update(); full_to_free[i]==npos means frozen
+        std::vector<size_t> free_to_full;
+        std::vector<size_t> full_to_free;
+        // full parameter list with the frozen values filled in
+        Tp param_template;
+
+        static const size_t npos = static_cast<size_t> (-1);
 
       public:
         /**
            the default construct function
          */
-        freeze_param ()
+        freeze_param () : num_free (0)
         {
         }
 
@@ -44,7 +51,7 @@ namespace opt_utilities
            construct function
            \param name the name of the parameter to be frozen
          */
-        freeze_param (const Tstr &name)
+        freeze_param (const Tstr &name) : num_free (0)
         {
             param_names.insert (name);
         }
@@ -75,78 +82,100 @@ namespace opt_utilities
                             throw;
                         }
                 }
+            std::sort (param_num.begin (), param_num.end ());
+
+            size_t nparams = this->get_model ().get_num_params ();
+            full_to_free.assign (nparams, npos);
+            free_to_full.clear ();
+            for (size_t i = 0, k = 0; i < nparams; ++i)
+                {
+                    if (k < param_num.size () && param_num[k] == i)
+                        {
+                            ++k;
+                            continue;
+                        }
+                    full_to_free[i] = free_to_full.size ();
+                    free_to_full.push_back (i);
+                }
+            num_free = free_to_full.size ();
+
+            resize (param_template, nparams);
+            for (size_t i = 0; i < nparams; ++i)
+                {
+                    set_element (param_template, i, this->get_model ().get_param_info (i).get_value ());
+                }
         }
 
         size_t do_get_num_free_params () const
         {
-            return this->get_model ().get_num_params () - param_num.size ();
+            return num_free;
         }
 
         bool is_frozen (size_t i) const
         {
-            if (std::find (param_num.begin (), param_num.end (), i) == param_num.end ())
-                {
-                    return false;
-                }
-            return true;
+            return full_to_free[i] == npos;
         }
 
 
         Tp do_reform (const Tp &p) const
         {
-            size_t nparams = (this->get_model ().get_num_params ());
-            Tp reformed_p (nparams);
-            size_t i = 0, j = 0;
-            for (i = 0; i < nparams; ++i)
-                {
-                    if (this->is_frozen (i))
-                        {
-                            const param_info<Tp, Tstr> &pinf = this->get_model ().get_param_info (i);
-                            // std::cout<<"frozen:"<<pinf.get_name()
-                            //	       <<i<<"\t"<<j
-                            //       <<std::endl;
-                            // opt_assign(get_element(reformed_p,i),pinf.get_value());
-                            set_element (reformed_p, i, pinf.get_value ());
-                        }
-                    else
-                        {
-                            // opt_assign(get_element(reformed_p,i),get_element(p,j));
-                            set_element (reformed_p, i, get_element (p, j));
-                            j++;
-                        }
-                }
-            /*
-            for(int i=0;i<reformed_p.size();++i)
-            {
-            std::cout<<get_element(reformed_p,i)<<",";
-            }
-            */
-            // std::cout<<"\n";
+            Tp reformed_p (param_template);
+            do_reform_into (p, reformed_p);
             return reformed_p;
-            // return p;
         }
 
         Tp do_deform (const Tp &p) const
         {
-            Tp deformed_p (do_get_num_free_params ());
-            size_t i (0), j (0);
-            assert (get_size (p) == this->get_model ().get_num_params ());
-            for (; i < get_size (p); ++i)
+            Tp deformed_p (num_free);
+            do_deform_into (p, deformed_p);
+            return deformed_p;
+        }
+
+        void do_reform_into (const Tp &p, Tp &out) const
+        {
+            assert (get_size (p) == num_free);
+            if (get_size (out) != get_size (param_template))
                 {
-                    // std::cout<<is_frozen(j)<<"\n";
-                    if (!this->is_frozen (i))
-                        {
-                            // opt_assign(get_element(deformed_p,j),get_element(p,i));
-                            set_element (deformed_p, j, get_element (p, i));
-                            j++;
-                        }
+                    opt_assign (out, param_template);
+                }
+            // the frozen values may have been changed by set_param_value
+            // after update(), so they are refreshed on every call
+            for (size_t k = 0; k < param_num.size (); ++k)
+                {
+                    set_element (out, param_num[k], this->get_model ().get_param_info (param_num[k]).get_value ());
+                }
+            for (size_t j = 0; j < num_free; ++j)
+                {
+                    set_element (out, free_to_full[j], get_element (p, j));
                 }
+        }
 
-            assert (j == do_get_num_free_params ());
-            return deformed_p;
+        void do_deform_into (const Tp &p, Tp &out) const
+        {
+            assert (get_size (p) == full_to_free.size ());
+            if (get_size (out) != num_free)
+                {
+                    resize (out, num_free);
+                }
+            for (size_t j = 0; j < num_free; ++j)
+                {
+                    set_element (out, j, get_element (p, free_to_full[j]));
+                }
         }
 
 
+        // the frozen parameters are constants, so the gradient with respect to
+        // the free parameters is just the gathered full gradient
+        void do_chain_gradient (const Tp &, const Tp &grad_full, Tp &grad) const
+        {
+            do_deform_into (grad_full, grad);
+        }
+
+        bool do_provides_chain_gradient () const
+        {
+            return true;
+        }
+
         Tstr do_report_param_status (const Tstr &name) const
         {
             if (param_names.find (name) == param_names.end ())
@@ -289,6 +318,9 @@ namespace opt_utilities
         }
     };
 
+    template <typename Tdata, typename Tp, typename Tstr>
+    const size_t freeze_param<Tdata, Tp, Tstr>::npos;
+
 
     /**
        help function to create a freeze_param object
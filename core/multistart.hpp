@@ -0,0 +1,118 @@
+/**
+   \file multistart.hpp
+   \brief start point samplers and results of fitter::fit_multistart
+   \author Junhua Gu
+ */
+
+#ifndef MULTISTART_HPP
+#define MULTISTART_HPP
+#define OPT_HEADER
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include "../misc/random.hpp"
+
+namespace opt_utilities
+{
+    /**
+       \brief virtual class that draws start points in the unit hypercube,
+       which fitter::fit_multistart maps onto the parameter limits
+     */
+    class start_sampler
+    {
+      private:
+        /**
+           \param n the number of points
+           \param dim the number of dimensions
+           \param u the coordinates in [0,1), point i is u[i*dim]...u[i*dim+dim-1]
+         */
+        virtual void do_sample (size_t n, size_t dim, std::vector<double> &u) const = 0;
+
+      public:
+        virtual ~start_sampler ()
+        {
+        }
+
+        /**
+           draw n points in [0,1)^dim
+           \param n the number of points
+           \param dim the number of dimensions
+           \param u the coordinates, resized to n*dim, in row-major order
+         */
+        void sample (size_t n, size_t dim, std::vector<double> &u) const
+        {
+            u.resize (n * dim);
+            do_sample (n, dim, u);
+        }
+    };
+
+    /**
+       \brief Latin hypercube sampling: along every dimension each of the
+       n strata [k/n,(k+1)/n) holds exactly one point.
+       The points are a pure function of the seed.
+     */
+    class latin_hypercube_sampler : public start_sampler
+    {
+      private:
+        unsigned long long seed;
+
+        void do_sample (size_t n, size_t dim, std::vector<double> &u) const
+        {
+            std::vector<size_t> perm (n);
+            for (size_t j = 0; j < dim; ++j)
+                {
+                    counter_rng rng (seed, j);
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            perm[i] = i;
+                        }
+                    // Fisher-Yates shuffle of the strata
+                    for (size_t i = n; i > 1; --i)
+                        {
+                            size_t k = (size_t) (rng.uniform () * i);
+                            std::swap (perm[i - 1], perm[k]);
+                        }
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            u[i * dim + j] = (perm[i] + rng.uniform ()) / n;
+                        }
+                }
+        }
+
+      public:
+        explicit latin_hypercube_sampler (unsigned long long s = 0) : seed (s)
+        {
+        }
+    };
+
+    /**
+       \brief one local fit of fitter::fit_multistart
+     */
+    template <typename Tp, typename Ts> struct multistart_fit
+    {
+        /// the index of the start point
+        size_t start_index;
+        /// the start point, all the parameters
+        Tp start_param;
+        /// the fitted parameters, all the parameters
+        Tp param;
+        /// the statistic at the fitted parameters
+        Ts statistic_value;
+    };
+
+    /**
+       \brief the result of fitter::fit_multistart
+     */
+    template <typename Tp, typename Ts> struct multistart_result
+    {
+        /// the fitted parameters with the lowest statistic
+        Tp best_param;
+        /// the lowest statistic
+        Ts best_statistic_value;
+        /// every local fit, sorted by the statistic in ascending order
+        std::vector<multistart_fit<Tp, Ts>> fits;
+    };
+}
+
+#endif
+// EOF
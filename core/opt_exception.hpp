@@ -144,6 +144,18 @@ namespace opt_utilities
         {
         }
     };
+
+    /**
+       thrown when an analytic gradient is requested from an object
+       that cannot provide it
+     */
+    class gradient_not_available : public opt_exception
+    {
+      public:
+        gradient_not_available () : opt_exception ("gradient not available")
+        {
+        }
+    };
 }
 
 
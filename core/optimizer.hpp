@@ -11,9 +11,16 @@
 #include <cstddef>
 #include "opt_traits.hpp"
 #include "opt_exception.hpp"
+#include "optimizer_stats.hpp"
+#include "eval_cache.hpp"
+#include "eval_executor.hpp"
 #include <cstdlib>
 #include <functional>
+#include <memory>
+#include <chrono>
 #include <typeinfo>
+#include <vector>
+#include <algorithm>
 #ifdef DEBUG
 #include <iostream>
 using namespace std;
@@ -55,6 +62,22 @@ namespace opt_utilities
            \return the clone of an object.
          */
         virtual func_obj<rT, pT> *do_clone () const = 0;
+        /**
+           Evaluate a batch of points.
+           The default evaluates them one by one through eval.
+           Override it if the points can be evaluated together more
+           efficiently; it may be called with a part of a batch.
+           \param points the points
+           \param n the number of points
+           \param out the values, with room for n elements
+         */
+        virtual void do_eval_many (const pT *points, size_t n, rT *out)
+        {
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = eval (points[i]);
+                }
+        }
         /**
            Destroy the object generated by clone function
          */
@@ -72,7 +95,68 @@ namespace opt_utilities
             return typeid (*this).name ();
         }
 
+        /**
+           statistics to be updated on every evaluation, shared by the clones
+         */
+        std::shared_ptr<optimizer_stats<rT, pT>> p_stats;
+
+        rT timed_eval (const pT &p)
+        {
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now ();
+            rT result = do_eval (p);
+            p_stats->count_eval (
+            std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now () - t0).count ());
+            return result;
+        }
+
+        /**
+           values of recently evaluated parameters, shared by the clones
+         */
+        std::shared_ptr<eval_cache<rT, pT>> p_cache;
+
+        rT uncached_eval (const pT &p)
+        {
+            return p_stats ? timed_eval (p) : do_eval (p);
+        }
+
+        rT cached_eval (const pT &p)
+        {
+            rT result;
+            if (p_cache->lookup (p, result))
+                {
+                    return result;
+                }
+            result = uncached_eval (p);
+            p_cache->insert (p, result);
+            return result;
+        }
+
+        /**
+           the clones evaluating the parts of a batch in eval_many, kept
+           between the batches, and not copied with the object
+         */
+        std::vector<func_obj<rT, pT> *> eval_clones;
+
       public:
+        func_obj ()
+        {
+        }
+
+        func_obj (const func_obj<rT, pT> &rhs) : std::unary_function<pT, rT> (rhs), p_stats (rhs.p_stats), p_cache (rhs.p_cache)
+        {
+        }
+
+        func_obj<rT, pT> &operator= (const func_obj<rT, pT> &rhs)
+        {
+            if (this != &rhs)
+                {
+                    release_clones ();
+                    p_stats = rhs.p_stats;
+                    p_cache = rhs.p_cache;
+                }
+            return *this;
+        }
+
         /**
            Interface function to perform the clone
            \return the clone of an pre-existed object.
@@ -100,7 +184,7 @@ namespace opt_utilities
          */
         rT operator() (const pT &p)
         {
-            return do_eval (p);
+            return p_cache ? cached_eval (p) : uncached_eval (p);
         }
 
 
@@ -109,13 +193,105 @@ namespace opt_utilities
          */
         rT eval (const pT &p)
         {
-            return do_eval (p);
+            return p_cache ? cached_eval (p) : uncached_eval (p);
         };
 
+        /**
+           Evaluate a batch of points, for methods that know several
+           points to be evaluated at once.
+           If the eval_executor of the process has several threads, the
+           batch is split over them, each evaluating its part on its own
+           clone, otherwise it is evaluated by do_eval_many on this object.
+           The clones are made by the first batch that needs them and
+           kept for the following ones, see release_clones.
+           The values do not depend on the number of threads.
+           \param points the points
+           \param n the number of points
+           \param out the values, with room for n elements
+         */
+        void eval_many (const pT *points, size_t n, rT *out)
+        {
+            std::shared_ptr<thread_pool> pool (eval_executor::instance ().get_thread_pool ());
+            if (!pool || n < 2)
+                {
+                    do_eval_many (points, n, out);
+                    return;
+                }
+            // this object evaluates the first part, the clones the others
+            const size_t n_parts = std::min (pool->get_num_threads (), n);
+            if (eval_clones.size () + 1 < n_parts)
+                {
+                    eval_clones.reserve (n_parts - 1);
+                    while (eval_clones.size () + 1 < n_parts)
+                        {
+                            eval_clones.push_back (clone ());
+                        }
+                }
+            func_obj<rT, pT> *self = this;
+            func_obj<rT, pT> **pc = eval_clones.empty () ? NULL_PTR : &eval_clones[0];
+            pool->parallel_ranges (n, n_parts, [self, pc, points, out](size_t s, size_t b, size_t e) {
+                (s == 0 ? self : pc[s - 1])->do_eval_many (points + b, e - b, out + b);
+            });
+        }
+
+        /**
+           Destroy the clones kept by eval_many, so that the next batch
+           clones this object again. Call it after changing this object
+           in a way that its clones must follow.
+         */
+        void release_clones ()
+        {
+            for (size_t i = 0; i < eval_clones.size (); ++i)
+                {
+                    eval_clones[i]->destroy ();
+                }
+            eval_clones.clear ();
+        }
+
+        /**
+           attach statistics, which then count and time every evaluation
+           \param ps the statistics, an empty pointer detaches them
+         */
+        void set_stats (const std::shared_ptr<optimizer_stats<rT, pT>> &ps)
+        {
+            release_clones ();
+            p_stats = ps;
+        }
+
+        /**
+           \return the attached statistics, or NULL_PTR
+         */
+        optimizer_stats<rT, pT> *get_stats () const
+        {
+            return p_stats.get ();
+        }
+
+        /**
+           attach a cache, then a parameter found in it is not evaluated
+           again, and is not counted by the statistics
+           \param pc the cache, an empty pointer detaches it
+         */
+        void set_cache (const std::shared_ptr<eval_cache<rT, pT>> &pc)
+        {
+            release_clones ();
+            p_cache = pc;
+        }
+
+        /**
+           \return the attached cache, or NULL_PTR
+         */
+        eval_cache<rT, pT> *get_cache () const
+        {
+            return p_cache.get ();
+        }
+
         /**
            deconstruct function
          */
-        virtual ~func_obj (){};
+        virtual ~func_obj ()
+        {
+            release_clones ();
+        };
         //    virtual XT walk(XT,YT)=0;
     };
 
@@ -361,11 +537,21 @@ namespace opt_utilities
          */
         func_obj<rT, pT> *p_func_obj;
 
+        /**
+           statistics of the last optimization
+         */
+        std::shared_ptr<optimizer_stats<rT, pT>> p_stats;
+
+        /**
+           the evaluation cache, NULL_PTR when disabled
+         */
+        std::shared_ptr<eval_cache<rT, pT>> p_cache;
+
       public:
         /**
            default construct function
          */
-        optimizer () : p_opt_method (NULL_PTR), p_func_obj (NULL_PTR)
+        optimizer () : p_opt_method (NULL_PTR), p_func_obj (NULL_PTR), p_stats (new optimizer_stats<rT, pT>)
         {
         }
 
@@ -375,16 +561,22 @@ namespace opt_utilities
            \param om optimization method
          */
         optimizer (func_obj<rT, pT> &fc, const opt_method<rT, pT> &om)
-        : p_func_obj (fc.clone ()), p_opt_method (om.clone ())
+        : p_opt_method (om.clone ()), p_func_obj (fc.clone ()), p_stats (new optimizer_stats<rT, pT>)
         {
+            p_func_obj->set_stats (p_stats);
             p_opt_method->set_optimizer (*this);
         }
 
         /**
            copy construct function
          */
-        optimizer (const optimizer &rhs) : p_opt_method (NULL_PTR), p_func_obj (NULL_PTR)
+        optimizer (const optimizer &rhs)
+        : p_opt_method (NULL_PTR), p_func_obj (NULL_PTR), p_stats (new optimizer_stats<rT, pT>)
         {
+            if (rhs.p_cache)
+                {
+                    p_cache.reset (new eval_cache<rT, pT> (rhs.p_cache->get_capacity ()));
+                }
             if (rhs.p_func_obj != NULL_PTR)
                 {
                     set_func_obj (*(rhs.p_func_obj));
@@ -405,6 +597,7 @@ namespace opt_utilities
                 {
                     return *this;
                 }
+            set_cache_size (rhs.p_cache ? rhs.p_cache->get_capacity () : 0);
             if (rhs.p_func_obj != NULL_PTR)
                 {
                     set_func_obj (*(rhs.p_func_obj));
@@ -446,6 +639,8 @@ namespace opt_utilities
                     p_func_obj->destroy ();
                 }
             p_func_obj = fc.clone ();
+            p_func_obj->set_stats (p_stats);
+            p_func_obj->set_cache (p_cache);
             if (p_opt_method != NULL_PTR)
                 {
                     p_opt_method->set_optimizer (*this);
@@ -651,7 +846,75 @@ namespace opt_utilities
                 {
                     throw object_function_not_defined ();
                 }
-            return p_opt_method->optimize ();
+            p_stats->reset ();
+            if (p_cache)
+                {
+                    p_cache->clear ();
+                }
+            p_stats->start_timer ();
+            try
+                {
+                    pT result = p_opt_method->optimize ();
+                    p_stats->stop_timer ();
+                    return result;
+                }
+            catch (...)
+                {
+                    p_stats->stop_timer ();
+                    throw;
+                }
+        }
+
+        /**
+           \return the statistics of the last (or the running) optimization
+         */
+        optimizer_stats<rT, pT> &get_stats ()
+        {
+            return *p_stats;
+        }
+
+        /**
+           \return the statistics of the last (or the running) optimization
+         */
+        const optimizer_stats<rT, pT> &get_stats () const
+        {
+            return *p_stats;
+        }
+
+        /**
+           Cache the values of the last n evaluated parameters, so that the
+           methods re-evaluating a parameter (e.g., line searches, or a
+           final evaluation at the result) do not call the object function
+           again. The cache is cleared at the beginning of every optimize.
+           \param n the capacity of the cache, 0 (the default) disables it
+         */
+        void set_cache_size (size_t n)
+        {
+            if (n == 0)
+                {
+                    p_cache.reset ();
+                }
+            else if (p_cache)
+                {
+                    p_cache->set_capacity (n);
+                }
+            else
+                {
+                    p_cache.reset (new eval_cache<rT, pT> (n));
+                }
+            if (p_func_obj != NULL_PTR)
+                {
+                    p_func_obj->set_cache (p_cache);
+                }
+        }
+
+        /**
+           \return the evaluation cache, with the hit and miss counters
+           of the last (or the running) optimization, or NULL_PTR if disabled
+         */
+        const eval_cache<rT, pT> *get_cache () const
+        {
+            return p_cache.get ();
         }
 
         /**
@@ -0,0 +1,216 @@
+/**
+   \file optimizer_stats.hpp
+   \brief counters, timings and convergence trace of an optimization run
+   \author Junhua Gu
+ */
+
+#ifndef OPTIMIZER_STATS_HPP
+#define OPTIMIZER_STATS_HPP
+#define OPT_HEADER
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace opt_utilities
+{
+    /**
+       \brief statistics of an optimization run.
+       An optimizer owns one of them and attaches it to its func_obj,
+       so that every evaluation of the object function is counted and
+       timed, including the ones made by clones on other threads.
+       The methods report gradients, line searches and iterations.
+       The counters are reset at the beginning of optimizer::optimize.
+       \tparam rT the return type of the object function
+       \tparam pT the parameter type of the object function
+     */
+    template <typename rT, typename pT> class optimizer_stats
+    {
+      public:
+        /**
+           one record of the convergence trace
+         */
+        struct trace_entry
+        {
+            /// the index of the iteration, counting from 0
+            size_t iteration;
+            /// the value of the object function after the iteration
+            rT value;
+            /// the parameter after the iteration
+            pT param;
+        };
+
+      private:
+        std::atomic<unsigned long long> n_evals;
+        std::atomic<unsigned long long> n_gradients;
+        std::atomic<unsigned long long> n_line_searches;
+        std::atomic<unsigned long long> n_iterations;
+        std::atomic<long long> eval_ns;
+        long long wall_ns;
+        std::chrono::steady_clock::time_point start_time;
+
+        size_t trace_capacity;
+        std::deque<trace_entry> trace;
+        mutable std::mutex trace_mutex;
+
+      private:
+        optimizer_stats (const optimizer_stats &);
+        optimizer_stats &operator= (const optimizer_stats &);
+
+      public:
+        optimizer_stats ()
+        : n_evals (0), n_gradients (0), n_line_searches (0), n_iterations (0), eval_ns (0), wall_ns (0),
+          trace_capacity (0)
+        {
+        }
+
+        /**
+           clear all the counters and the trace, the trace capacity is kept
+         */
+        void reset ()
+        {
+            n_evals = 0;
+            n_gradients = 0;
+            n_line_searches = 0;
+            n_iterations = 0;
+            eval_ns = 0;
+            wall_ns = 0;
+            std::lock_guard<std::mutex> lk (trace_mutex);
+            trace.clear ();
+        }
+
+        /**
+           \param ns the time spent in one evaluation, in nanoseconds
+         */
+        void count_eval (long long ns)
+        {
+            n_evals.fetch_add (1, std::memory_order_relaxed);
+            eval_ns.fetch_add (ns, std::memory_order_relaxed);
+        }
+
+        void count_gradient ()
+        {
+            n_gradients.fetch_add (1, std::memory_order_relaxed);
+        }
+
+        void count_line_search ()
+        {
+            n_line_searches.fetch_add (1, std::memory_order_relaxed);
+        }
+
+        /**
+           called by the methods at the end of every iteration
+           \param value the current value of the object function
+           \param p the current parameter
+         */
+        void add_iteration (const rT &value, const pT &p)
+        {
+            size_t iter = n_iterations.fetch_add (1, std::memory_order_relaxed);
+            if (trace_capacity == 0)
+                {
+                    return;
+                }
+            std::lock_guard<std::mutex> lk (trace_mutex);
+            if (trace.size () == trace_capacity)
+                {
+                    trace.pop_front ();
+                }
+            trace.push_back (trace_entry ());
+            trace.back ().iteration = iter;
+            trace.back ().value = value;
+            trace.back ().param = p;
+        }
+
+        void start_timer ()
+        {
+            start_time = std::chrono::steady_clock::now ();
+        }
+
+        void stop_timer ()
+        {
+            wall_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now () - start_time).count ();
+        }
+
+        /**
+           Keep the last n iterations in the trace, 0 (the default) disables it.
+         */
+        void set_trace_capacity (size_t n)
+        {
+            std::lock_guard<std::mutex> lk (trace_mutex);
+            trace_capacity = n;
+            while (trace.size () > trace_capacity)
+                {
+                    trace.pop_front ();
+                }
+        }
+
+        size_t get_trace_capacity () const
+        {
+            return trace_capacity;
+        }
+
+        /**
+           \return a copy of the trace, the oldest iteration first
+         */
+        std::vector<trace_entry> get_trace () const
+        {
+            std::lock_guard<std::mutex> lk (trace_mutex);
+            return std::vector<trace_entry> (trace.begin (), trace.end ());
+        }
+
+        /**
+           \return the number of evaluations of the object function
+         */
+        unsigned long long num_evals () const
+        {
+            return n_evals.load ();
+        }
+
+        /**
+           \return the number of gradients computed
+         */
+        unsigned long long num_gradients () const
+        {
+            return n_gradients.load ();
+        }
+
+        /**
+           \return the number of line searches
+         */
+        unsigned long long num_line_searches () const
+        {
+            return n_line_searches.load ();
+        }
+
+        /**
+           \return the number of iterations reported by the method
+         */
+        unsigned long long num_iterations () const
+        {
+            return n_iterations.load ();
+        }
+
+        /**
+           \return the wall time of the last optimize call, in seconds
+         */
+        double wall_time () const
+        {
+            return wall_ns * 1e-9;
+        }
+
+        /**
+           \return the time spent inside func_obj::eval, in seconds,
+           summed over all the threads
+         */
+        double eval_time () const
+        {
+            return eval_ns.load () * 1e-9;
+        }
+    };
+}
+
+#endif
+// EOF
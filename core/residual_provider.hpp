@@ -0,0 +1,78 @@
+/**
+   \file residual_provider.hpp
+   \brief interface of object functions that are sums of squared residuals
+   \author Junhua Gu
+ */
+
+#ifndef RESIDUAL_PROVIDER_HPP
+#define RESIDUAL_PROVIDER_HPP
+#define OPT_HEADER
+#include <cstddef>
+
+namespace opt_utilities
+{
+    /**
+       \brief Implemented by the object functions of the form
+       f(p)=sum_i r_i(p)^2, so that least-squares methods
+       (e.g., levmar_method) can work on the residuals directly.
+       A method finds it with dynamic_cast on the func_obj,
+       in the same way as gradient finds a diff_func_obj.
+       \tparam rT the type of the residuals
+       \tparam pT the type of the parameter
+     */
+    template <typename rT, typename pT> class residual_provider
+    {
+      private:
+        virtual size_t do_num_residuals () = 0;
+        virtual void do_eval_residuals (const pT &p, rT *r) = 0;
+
+        /**
+           Can be overrided to supply the analytic Jacobian.
+           \return false if the Jacobian is not available
+         */
+        virtual bool do_eval_jacobian (const pT &, rT *, rT *)
+        {
+            return false;
+        }
+
+      public:
+        virtual ~residual_provider ()
+        {
+        }
+
+        /**
+           \return the number of residuals
+         */
+        size_t num_residuals ()
+        {
+            return do_num_residuals ();
+        }
+
+        /**
+           evaluate the residuals
+           \param p the parameter
+           \param r the residuals, should have room for num_residuals() elements
+         */
+        void eval_residuals (const pT &p, rT *r)
+        {
+            do_eval_residuals (p, r);
+        }
+
+        /**
+           evaluate the residuals and their Jacobian
+           \param p the parameter
+           \param r the residuals
+           \param jac the Jacobian, in row-major order, i.e.,
+           jac[i*get_size(p)+j] is dr_i/dp_j
+           \return false if the Jacobian is not available, in which
+           case the caller should fall back to finite differences
+         */
+        bool eval_jacobian (const pT &p, rT *r, rT *jac)
+        {
+            return do_eval_jacobian (p, r, jac);
+        }
+    };
+}
+
+#endif
+// EOF
@@ -0,0 +1,327 @@
+/**
+   \file thread_pool.hpp
+   \brief a persistent pool of worker threads
+   \author Junhua Gu
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#define OPT_HEADER
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+namespace opt_utilities
+{
+    /**
+       \brief a fixed set of worker threads that stay alive between calls,
+       so that the cost of creating threads is not paid on every
+       evaluation of an objective function.
+       Work is submitted as a number of indexed chunks via parallel_for.
+       The calling thread takes part in executing the chunks, so
+       parallel_for may be called concurrently from several threads and
+       from inside a chunk without dead-locking.
+       Work of uneven cost can be submitted as a range of items via
+       parallel_ranges, which balances it by work stealing.
+     */
+    class thread_pool
+    {
+      private:
+        struct job
+        {
+            std::function<void(size_t)> func;
+            size_t nchunks;
+            std::atomic<size_t> next;
+            std::atomic<size_t> finished;
+            std::exception_ptr error;
+            std::mutex error_mutex;
+
+            job (const std::function<void(size_t)> &f, size_t n) : func (f), nchunks (n), next (0), finished (0)
+            {
+            }
+        };
+
+        std::vector<std::thread> workers;
+        std::deque<std::shared_ptr<job>> jobs;
+        std::mutex mtx;
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        bool stopping;
+
+      private:
+        thread_pool (const thread_pool &);
+        thread_pool &operator= (const thread_pool &);
+
+        // run the chunks of a job until none is left
+        // return true if the last chunk of the job has been finished by this call
+        bool run_chunks (job &j)
+        {
+            bool last = false;
+            for (;;)
+                {
+                    size_t i = j.next.fetch_add (1);
+                    if (i >= j.nchunks)
+                        {
+                            break;
+                        }
+                    try
+                        {
+                            j.func (i);
+                        }
+                    catch (...)
+                        {
+                            std::lock_guard<std::mutex> lk (j.error_mutex);
+                            if (!j.error)
+                                {
+                                    j.error = std::current_exception ();
+                                }
+                        }
+                    if (j.finished.fetch_add (1) + 1 == j.nchunks)
+                        {
+                            last = true;
+                        }
+                }
+            return last;
+        }
+
+        void worker_loop ()
+        {
+            for (;;)
+                {
+                    std::shared_ptr<job> pj;
+                    {
+                        std::unique_lock<std::mutex> lk (mtx);
+                        while (!stopping && jobs.empty ())
+                            {
+                                work_cv.wait (lk);
+                            }
+                        if (stopping)
+                            {
+                                return;
+                            }
+                        pj = jobs.front ();
+                        if (pj->next.load () >= pj->nchunks)
+                            {
+                                // all chunks have been taken, nothing left to do
+                                jobs.pop_front ();
+                                continue;
+                            }
+                    }
+                    if (run_chunks (*pj))
+                        {
+                            std::lock_guard<std::mutex> lk (mtx);
+                            done_cv.notify_all ();
+                        }
+                }
+        }
+
+      public:
+        /**
+           construct the pool
+           \param nthreads the total number of threads that execute chunks,
+           including the calling thread; 0 means std::thread::hardware_concurrency
+         */
+        explicit thread_pool (size_t nthreads = 0) : stopping (false)
+        {
+            if (nthreads == 0)
+                {
+                    nthreads = std::thread::hardware_concurrency ();
+                }
+            for (size_t i = 1; i < nthreads; ++i)
+                {
+                    workers.push_back (std::thread (&thread_pool::worker_loop, this));
+                }
+        }
+
+        /**
+           destruct function, joins all the workers
+         */
+        ~thread_pool ()
+        {
+            {
+                std::lock_guard<std::mutex> lk (mtx);
+                stopping = true;
+            }
+            work_cv.notify_all ();
+            for (size_t i = 0; i < workers.size (); ++i)
+                {
+                    workers[i].join ();
+                }
+        }
+
+        /**
+           \return the number of threads that execute chunks, including the caller
+         */
+        size_t get_num_threads () const
+        {
+            return workers.size () + 1;
+        }
+
+        /**
+           call func(i) for every i in [0,nchunks), and return when all are done.
+           The order in which the chunks are executed is unspecified.
+           If any chunk throws, the first exception is rethrown here
+           after all the chunks have finished.
+           \param nchunks the number of chunks
+           \param func the function to be called for each chunk
+         */
+        void parallel_for (size_t nchunks, const std::function<void(size_t)> &func)
+        {
+            if (nchunks == 0)
+                {
+                    return;
+                }
+            if (workers.empty () || nchunks == 1)
+                {
+                    for (size_t i = 0; i < nchunks; ++i)
+                        {
+                            func (i);
+                        }
+                    return;
+                }
+            std::shared_ptr<job> pj (new job (func, nchunks));
+            {
+                std::lock_guard<std::mutex> lk (mtx);
+                jobs.push_back (pj);
+            }
+            work_cv.notify_all ();
+            run_chunks (*pj);
+            {
+                std::unique_lock<std::mutex> lk (mtx);
+                while (pj->finished.load () != nchunks)
+                    {
+                        done_cv.wait (lk);
+                    }
+                for (std::deque<std::shared_ptr<job>>::iterator i = jobs.begin (); i != jobs.end (); ++i)
+                    {
+                        if (*i == pj)
+                            {
+                                jobs.erase (i);
+                                break;
+                            }
+                    }
+            }
+            if (pj->error)
+                {
+                    std::rethrow_exception (pj->error);
+                }
+        }
+
+        /**
+           Process the items [0,n) in contiguous sub-ranges by nslots tasks.
+           Every slot starts with an equal share of the items and takes
+           small blocks from the front of it; a slot that runs out of work
+           steals the back half of the share of another slot.
+           A slot is executed by one thread at a time, so per-slot data,
+           e.g., a clone of an object function, need no locking.
+           If any call throws, the first exception is rethrown here
+           after all the slots have finished.
+           \param n the number of items, less than 2^32
+           \param nslots the number of slots, at most n
+           \param func called as func(slot,begin,end) for every sub-range
+         */
+        void parallel_ranges (size_t n, size_t nslots, const std::function<void(size_t, size_t, size_t)> &func)
+        {
+            if (n == 0)
+                {
+                    return;
+                }
+            nslots = std::max (size_t (1), std::min (nslots, n));
+            if (nslots == 1)
+                {
+                    func (0, 0, n);
+                    return;
+                }
+            // the remaining range of each slot, (front<<32)|back
+            std::unique_ptr<std::atomic<std::uint64_t>[]> ranges (new std::atomic<std::uint64_t>[nslots]);
+            for (size_t s = 0; s < nslots; ++s)
+                {
+                    ranges[s] = pack_range (n * s / nslots, n * (s + 1) / nslots);
+                }
+            const size_t grain = std::max (size_t (1), n / (nslots * 8));
+            std::atomic<std::uint64_t> *pr = ranges.get ();
+            parallel_for (nslots, [pr, nslots, grain, &func](size_t s) {
+                for (;;)
+                    {
+                        size_t b, e;
+                        if (pop_front (pr[s], grain, b, e))
+                            {
+                                func (s, b, e);
+                                continue;
+                            }
+                        bool stolen = false;
+                        for (size_t k = 1; k < nslots && !stolen; ++k)
+                            {
+                                stolen = steal_back (pr[(s + k) % nslots], b, e);
+                            }
+                        if (!stolen)
+                            {
+                                return;
+                            }
+                        // only this slot pushes into its own range, which is empty now
+                        pr[s].store (pack_range (b, e));
+                    }
+            });
+        }
+
+      private:
+        static std::uint64_t pack_range (size_t b, size_t e)
+        {
+            return (std::uint64_t (b) << 32) | std::uint64_t (e);
+        }
+
+        static bool pop_front (std::atomic<std::uint64_t> &r, size_t grain, size_t &b, size_t &e)
+        {
+            std::uint64_t v = r.load ();
+            for (;;)
+                {
+                    size_t front = size_t (v >> 32);
+                    size_t back = size_t (v & 0xffffffffu);
+                    if (front >= back)
+                        {
+                            return false;
+                        }
+                    size_t mid = std::min (back, front + grain);
+                    if (r.compare_exchange_weak (v, pack_range (mid, back)))
+                        {
+                            b = front;
+                            e = mid;
+                            return true;
+                        }
+                }
+        }
+
+        static bool steal_back (std::atomic<std::uint64_t> &r, size_t &b, size_t &e)
+        {
+            std::uint64_t v = r.load ();
+            for (;;)
+                {
+                    size_t front = size_t (v >> 32);
+                    size_t back = size_t (v & 0xffffffffu);
+                    if (front >= back)
+                        {
+                            return false;
+                        }
+                    size_t mid = front + (back - front) / 2;
+                    if (r.compare_exchange_weak (v, pack_range (front, mid)))
+                        {
+                            b = mid;
+                            e = back;
+                            return true;
+                        }
+                }
+        }
+    };
+}
+
+#endif
+// EOF
@@ -0,0 +1,242 @@
+/**
+   \file columnar_data_set.hpp
+   \brief data set that stores each field in a separate contiguous array
+   \author Junhua Gu
+ */
+
+#ifndef COLUMNAR_DATA_SET
+#define COLUMNAR_DATA_SET
+#define OPT_HEADER
+#include "core/fitter.hpp"
+#include "utilities/aligned_allocator.hpp"
+#include <vector>
+#include <stdexcept>
+#include <mutex>
+#include <atomic>
+
+
+namespace opt_utilities
+{
+
+    /**
+       \brief structure-of-arrays implement of the data set
+       x, x_lower_err, x_upper_err, y, y_lower_err and y_upper_err are kept
+       in six 64-byte-aligned arrays, which are exposed through
+       get_x_column etc., so that the statistics can stream only the
+       fields they need.
+       get_data is still supported through a cache of data records,
+       which is built on the first call after the data set is modified.
+       The cache is built under a lock, so concurrent readers are safe;
+       the statistics read the columns and never build it.
+       \tparam Tdata the type of data point, normally data<double,double>
+     */
+    template <typename Tdata> class columnar_data_set : public data_set<Tdata>
+    {
+      public:
+        typedef typename Tdata::Tx Tx;
+        typedef typename Tdata::Ty Ty;
+        typedef std::vector<Tx, aligned_allocator<Tx, 64>> x_column_type;
+        typedef std::vector<Ty, aligned_allocator<Ty, 64>> y_column_type;
+
+      private:
+        x_column_type x_vec;
+        x_column_type x_lower_err_vec;
+        x_column_type x_upper_err_vec;
+        y_column_type y_vec;
+        y_column_type y_lower_err_vec;
+        y_column_type y_upper_err_vec;
+
+        mutable std::vector<Tdata> record_cache;
+        mutable std::atomic<bool> cache_valid;
+        mutable std::mutex cache_mutex;
+
+      private:
+        data_set<Tdata> *do_clone () const
+        {
+            return new columnar_data_set<Tdata> (*this);
+        }
+
+        const Tdata &do_get_data (size_t i) const
+        {
+            if (i >= y_vec.size ())
+                {
+                    throw std::out_of_range ("columnar_data_set::get_data");
+                }
+            if (!cache_valid.load (std::memory_order_acquire))
+                {
+                    build_cache ();
+                }
+            return record_cache[i];
+        }
+
+        void build_cache () const
+        {
+            std::lock_guard<std::mutex> lk (cache_mutex);
+            if (cache_valid.load (std::memory_order_relaxed))
+                {
+                    return;
+                }
+            record_cache.resize (y_vec.size ());
+            for (size_t j = 0; j < y_vec.size (); ++j)
+                {
+                    record_cache[j] = Tdata (x_vec[j], y_vec[j], y_lower_err_vec[j], y_upper_err_vec[j],
+                                             x_lower_err_vec[j], x_upper_err_vec[j]);
+                }
+            cache_valid.store (true, std::memory_order_release);
+        }
+
+        void do_set_data (size_t i, const Tdata &d)
+        {
+            if (i >= y_vec.size ())
+                {
+                    throw std::out_of_range ("columnar_data_set::set_data");
+                }
+            opt_assign (x_vec[i], d.get_x ());
+            opt_assign (x_lower_err_vec[i], d.get_x_lower_err ());
+            opt_assign (x_upper_err_vec[i], d.get_x_upper_err ());
+            opt_assign (y_vec[i], d.get_y ());
+            opt_assign (y_lower_err_vec[i], d.get_y_lower_err ());
+            opt_assign (y_upper_err_vec[i], d.get_y_upper_err ());
+            if (cache_valid.load (std::memory_order_relaxed))
+                {
+                    record_cache[i] = d;
+                }
+        }
+
+        size_t do_size () const
+        {
+            return y_vec.size ();
+        }
+
+        void do_add_data (const Tdata &d)
+        {
+            x_vec.push_back (d.get_x ());
+            x_lower_err_vec.push_back (d.get_x_lower_err ());
+            x_upper_err_vec.push_back (d.get_x_upper_err ());
+            y_vec.push_back (d.get_y ());
+            y_lower_err_vec.push_back (d.get_y_lower_err ());
+            y_upper_err_vec.push_back (d.get_y_upper_err ());
+            invalidate_cache ();
+        }
+
+        void do_clear ()
+        {
+            x_vec.clear ();
+            x_lower_err_vec.clear ();
+            x_upper_err_vec.clear ();
+            y_vec.clear ();
+            y_lower_err_vec.clear ();
+            y_upper_err_vec.clear ();
+            invalidate_cache ();
+        }
+
+        const Tx *do_get_x_column () const
+        {
+            return x_vec.empty () ? NULL_PTR : &x_vec[0];
+        }
+
+        const Tx *do_get_x_lower_err_column () const
+        {
+            return x_lower_err_vec.empty () ? NULL_PTR : &x_lower_err_vec[0];
+        }
+
+        const Tx *do_get_x_upper_err_column () const
+        {
+            return x_upper_err_vec.empty () ? NULL_PTR : &x_upper_err_vec[0];
+        }
+
+        const Ty *do_get_y_column () const
+        {
+            return y_vec.empty () ? NULL_PTR : &y_vec[0];
+        }
+
+        const Ty *do_get_y_lower_err_column () const
+        {
+            return y_lower_err_vec.empty () ? NULL_PTR : &y_lower_err_vec[0];
+        }
+
+        const Ty *do_get_y_upper_err_column () const
+        {
+            return y_upper_err_vec.empty () ? NULL_PTR : &y_upper_err_vec[0];
+        }
+
+        void invalidate_cache ()
+        {
+            cache_valid.store (false, std::memory_order_relaxed);
+            std::vector<Tdata> ().swap (record_cache);
+        }
+
+        void assign_from (const data_set<Tdata> &rhs)
+        {
+            do_clear ();
+            reserve (rhs.size ());
+            for (size_t i = 0; i < rhs.size (); ++i)
+                {
+                    do_add_data (rhs.get_data (i));
+                }
+        }
+
+      public:
+        columnar_data_set () : cache_valid (false)
+        {
+        }
+
+        columnar_data_set (const columnar_data_set<Tdata> &rhs)
+        : x_vec (rhs.x_vec), x_lower_err_vec (rhs.x_lower_err_vec), x_upper_err_vec (rhs.x_upper_err_vec),
+          y_vec (rhs.y_vec), y_lower_err_vec (rhs.y_lower_err_vec), y_upper_err_vec (rhs.y_upper_err_vec),
+          cache_valid (false)
+        {
+        }
+
+        /**
+           convert any other data set into the columnar layout
+         */
+        columnar_data_set (const data_set<Tdata> &rhs) : cache_valid (false)
+        {
+            assign_from (rhs);
+        }
+
+        columnar_data_set &operator= (const columnar_data_set<Tdata> &rhs)
+        {
+            if (this == &rhs)
+                {
+                    return *this;
+                }
+            x_vec = rhs.x_vec;
+            x_lower_err_vec = rhs.x_lower_err_vec;
+            x_upper_err_vec = rhs.x_upper_err_vec;
+            y_vec = rhs.y_vec;
+            y_lower_err_vec = rhs.y_lower_err_vec;
+            y_upper_err_vec = rhs.y_upper_err_vec;
+            invalidate_cache ();
+            return *this;
+        }
+
+        columnar_data_set &operator= (const data_set<Tdata> &rhs)
+        {
+            if (this == &rhs)
+                {
+                    return *this;
+                }
+            assign_from (rhs);
+            return *this;
+        }
+
+        /**
+           reserve room for n data points in every column
+           \param n the number of data points
+         */
+        void reserve (size_t n)
+        {
+            x_vec.reserve (n);
+            x_lower_err_vec.reserve (n);
+            x_upper_err_vec.reserve (n);
+            y_vec.reserve (n);
+            y_lower_err_vec.reserve (n);
+            y_upper_err_vec.reserve (n);
+        }
+    };
+}
+
+#endif
+// EOF
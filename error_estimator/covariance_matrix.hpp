@@ -0,0 +1,184 @@
+/**
+   \file covariance_matrix.hpp
+   \brief the covariance matrix of fitted parameters from the Hessian of the statistic
+   \author Junhua Gu
+ */
+
+#ifndef COVARIANCE_MATRIX_HPP
+#define COVARIANCE_MATRIX_HPP
+#define OPT_HEADER
+#include <core/fitter.hpp>
+#include <math/num_diff.hpp>
+#include <vector>
+#include <string>
+#include <cmath>
+
+namespace opt_utilities
+{
+    /**
+       \brief thrown when the Hessian of the statistic is not positive definite,
+       i.e., the fitter is not at a minimum or some parameters are degenerate
+     */
+    class hessian_not_positive_definite : public opt_exception
+    {
+      public:
+        hessian_not_positive_definite () : opt_exception ("the Hessian of the statistic is not positive definite")
+        {
+        }
+    };
+
+    /**
+       \brief the result of covariance_matrix
+       \tparam Tp the type of model parameters
+       \tparam Tstr the type of string used
+     */
+    template <typename Tp, typename Tstr = std::string> struct covariance_estimate
+    {
+        typedef typename element_type_trait<Tp>::element_type Tpe;
+        /// the names of the free parameters, in the order of the matrix
+        std::vector<Tstr> names;
+        /// the covariance matrix of the free parameters, n x n in row-major order
+        std::vector<Tpe> covariance;
+        /// the square roots of the diagonal elements
+        std::vector<Tpe> sigma;
+        /// the number of evaluations of the statistic
+        size_t num_evals;
+
+        /**
+           \return the covariance of the i-th and j-th free parameters
+         */
+        Tpe operator() (size_t i, size_t j) const
+        {
+            return covariance[i * names.size () + j];
+        }
+
+        /**
+           \return the correlation coefficient of the i-th and j-th free parameters
+         */
+        Tpe correlation (size_t i, size_t j) const
+        {
+            return (*this) (i, j) / (sigma[i] * sigma[j]);
+        }
+    };
+
+    /**
+       In-place Cholesky inversion of a symmetric positive definite matrix
+       \param a the n x n matrix in row-major order, replaced by its inverse
+       \param n the order of the matrix
+     */
+    template <typename T> void cholesky_invert (std::vector<T> &a, size_t n)
+    {
+        // a=L L^T, L is kept in the lower triangle
+        for (size_t j = 0; j < n; ++j)
+            {
+                T d = a[j * n + j];
+                for (size_t k = 0; k < j; ++k)
+                    {
+                        d -= a[j * n + k] * a[j * n + k];
+                    }
+                if (!(d > 0))
+                    {
+                        throw hessian_not_positive_definite ();
+                    }
+                d = std::sqrt (d);
+                a[j * n + j] = d;
+                for (size_t i = j + 1; i < n; ++i)
+                    {
+                        T s = a[i * n + j];
+                        for (size_t k = 0; k < j; ++k)
+                            {
+                                s -= a[i * n + k] * a[j * n + k];
+                            }
+                        a[i * n + j] = s / d;
+                    }
+            }
+        // L^-1, in the lower triangle
+        for (size_t j = 0; j < n; ++j)
+            {
+                a[j * n + j] = 1 / a[j * n + j];
+                for (size_t i = j + 1; i < n; ++i)
+                    {
+                        T s = 0;
+                        for (size_t k = j; k < i; ++k)
+                            {
+                                s -= a[i * n + k] * a[k * n + j];
+                            }
+                        a[i * n + j] = s / a[i * n + i];
+                    }
+            }
+        // a^-1=L^-T L^-1
+        for (size_t i = 0; i < n; ++i)
+            {
+                for (size_t j = 0; j <= i; ++j)
+                    {
+                        T s = 0;
+                        for (size_t k = i; k < n; ++k)
+                            {
+                                s += a[k * n + i] * a[k * n + j];
+                            }
+                        a[j * n + i] = s;
+                    }
+            }
+        for (size_t i = 0; i < n; ++i)
+            {
+                for (size_t j = 0; j < i; ++j)
+                    {
+                        a[i * n + j] = a[j * n + i];
+                    }
+            }
+    }
+
+    /**
+       \brief The covariance matrix of the free parameters of a fit.
+       The full Hessian H of the statistic is computed once at the current
+       parameters, with diff_engine on a shared stencil of 1+n+n^2
+       evaluations, and the covariance is 2*dchi*H^-1.
+       The fitter is not refitted and not modified, so it should hold
+       a successful fit.
+       \param fit the fitter that has a sucessful fit result
+       \param dchi the delta statistic corresponding to one sigma,
+       1 for chi^2 and 0.5 for -log(likelihood)
+       \return the covariance, the sigmas and the names of the free parameters
+     */
+    template <typename Tdata, typename Tp, typename Ts, typename Tstr>
+    covariance_estimate<Tp, Tstr> covariance_matrix (fitter<Tdata, Tp, Ts, Tstr> &fit, const Ts &dchi = 1)
+    {
+        covariance_estimate<Tp, Tstr> result;
+        // the statistic works on the free parameters
+        Tp p (fit.get_model ().deform_param (fit.get_all_params ()));
+        size_t n = get_size (p);
+        for (size_t i = 0; i < fit.get_num_params (); ++i)
+            {
+                const Tstr &name = fit.get_param_info (i).get_name ();
+                if (fit.report_param_status (name) != "frozen")
+                    {
+                        result.names.push_back (name);
+                    }
+            }
+        if (result.names.size () != n)
+            {
+                throw opt_exception ("covariance_matrix only works with parameters that are free or frozen");
+            }
+
+        diff_engine<Ts, Tp> engine (fit.get_statistic ());
+        std::vector<Ts> h;
+        engine.hessian (p, h);
+        result.num_evals = engine.get_num_evals ();
+
+        result.covariance.resize (n * n);
+        for (size_t i = 0; i < n * n; ++i)
+            {
+                result.covariance[i] = h[i] / (2 * dchi);
+            }
+        cholesky_invert (result.covariance, n);
+        result.sigma.resize (n);
+        for (size_t i = 0; i < n; ++i)
+            {
+                result.sigma[i] = std::sqrt (result.covariance[i * n + i]);
+            }
+        return result;
+    }
+}
+
+#endif
+// EOF
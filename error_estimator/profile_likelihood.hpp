@@ -0,0 +1,453 @@
+/**
+   \file profile_likelihood.hpp
+   \brief profile-likelihood confidence intervals of fitted parameters
+   \author Junhua Gu
+ */
+
+#ifndef PROFILE_LIKELIHOOD_HPP
+#define PROFILE_LIKELIHOOD_HPP
+#define OPT_HEADER
+#include <core/fitter.hpp>
+#include <core/freeze_param.hpp>
+#include <core/thread_pool.hpp>
+#include <math/num_diff.hpp>
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iterator>
+
+namespace opt_utilities
+{
+    /**
+       \brief profile-likelihood engine.
+       The profiled statistic of a parameter at a value v is the best
+       statistic with the parameter frozen at v. The engine finds where it
+       rises by dchi above the best fit, on both sides of the best-fit value,
+       with Brent's root finding.
+       Every profiled point is memoized (value -> statistic and parameters),
+       and each constrained refit starts from the parameters of the nearest
+       memoized point.
+       The searches (two per parameter) run concurrently on the threads set
+       by set_num_threads, each on its own copy of the model, statistic and
+       method, which share the data set of the fitter.
+       The fitter itself is not modified, and must not be modified
+       while the engine is in use.
+       \tparam Tdata the type of data point
+       \tparam Tp the type of model parameters
+       \tparam Ts the type of statistic
+       \tparam Tstr the type of string used
+     */
+    template <typename Tdata, typename Tp, typename Ts, typename Tstr = std::string> class profile_likelihood
+    {
+      public:
+        typedef typename element_type_trait<Tp>::element_type Tpe;
+        typedef fitter<Tdata, Tp, Ts, Tstr> fitter_type;
+
+      private:
+        struct profile_point
+        {
+            Ts statistic_value;
+            Tp param;
+        };
+
+        struct profile_memo
+        {
+            std::mutex mtx;
+            std::map<Tpe, profile_point> points;
+        };
+
+        // one bound of one parameter
+        struct search_task
+        {
+            Tstr pname;
+            int direction;
+            Tpe initial_step;
+            Tpe result;
+        };
+
+        const fitter_type *p_fitter;
+        Tp best_param;
+        Ts best_statistic;
+        int max_iter;
+        std::shared_ptr<thread_pool> p_pool;
+        std::map<Tstr, std::shared_ptr<profile_memo>> memos;
+        std::mutex memos_mutex;
+
+      private:
+        profile_likelihood (const profile_likelihood &);
+        profile_likelihood &operator= (const profile_likelihood &);
+
+        std::shared_ptr<profile_memo> get_memo (const Tstr &pname)
+        {
+            std::lock_guard<std::mutex> lk (memos_mutex);
+            std::shared_ptr<profile_memo> &pm = memos[pname];
+            if (!pm)
+                {
+                    pm.reset (new profile_memo);
+                    profile_point best;
+                    best.statistic_value = best_statistic;
+                    opt_assign (best.param, best_param);
+                    pm->points[get_element (best_param, p_fitter->get_param_order (pname))] = best;
+                }
+            return pm;
+        }
+
+        // a copy of the fitter sharing its data, with pname frozen
+        std::unique_ptr<fitter_type> make_worker (const Tstr &pname) const
+        {
+            std::unique_ptr<fitter_type> w (new fitter_type);
+            w->set_model (p_fitter->get_model ());
+            w->set_statistic (p_fitter->get_statistic ());
+            w->set_opt_method (p_fitter->get_opt_method ());
+            w->load_data (data_set_view<Tdata> (p_fitter->get_data_set ()));
+            try
+                {
+                    freeze_param<Tdata, Tp, Tstr> *pfp =
+                    dynamic_cast<freeze_param<Tdata, Tp, Tstr> *> (&w->get_param_modifier ());
+                    if (pfp == NULL_PTR)
+                        {
+                            throw opt_exception ("profile_likelihood only works with freeze_param as the param modifier");
+                        }
+                    *pfp += freeze_param<Tdata, Tp, Tstr> (pname);
+                }
+            catch (const param_modifier_not_defined &)
+                {
+                    w->set_param_modifier (freeze_param<Tdata, Tp, Tstr> (pname));
+                }
+            return w;
+        }
+
+        // the profiled statistic at v, fitted on w if not memoized
+        Ts profile_on (fitter_type &w, profile_memo &memo, const Tstr &pname, Tpe v)
+        {
+            Tp start;
+            {
+                std::lock_guard<std::mutex> lk (memo.mtx);
+                typename std::map<Tpe, profile_point>::iterator i = memo.points.lower_bound (v);
+                if (i != memo.points.end () && i->first == v)
+                    {
+                        return i->second.statistic_value;
+                    }
+                // warm start from the nearest profiled point
+                typename std::map<Tpe, profile_point>::iterator nearest = i;
+                if (i == memo.points.end () || (i != memo.points.begin () && v - std::prev (i)->first < i->first - v))
+                    {
+                        nearest = std::prev (i);
+                    }
+                opt_assign (start, nearest->second.param);
+            }
+            w.set_param_value (start);
+            w.set_param_value (pname, v);
+            w.fit ();
+            profile_point pp;
+            pp.statistic_value = w.get_statistic_value ();
+            opt_assign (pp.param, w.get_all_params ());
+            std::lock_guard<std::mutex> lk (memo.mtx);
+            memo.points[v] = pp;
+            return pp.statistic_value;
+        }
+
+        // a guess of the distance to the bound from the curvature of the statistic
+        Tpe step_from_curvature (const Tstr &pname, const Ts &dchi) const
+        {
+            size_t order = p_fitter->get_param_order (pname);
+            Tpe v = get_element (best_param, order);
+            Tpe fallback = std::max (std::abs (v), Tpe (1)) / 10;
+            fitter_type w;
+            w.set_model (p_fitter->get_model ());
+            w.set_statistic (p_fitter->get_statistic ());
+            w.load_data (data_set_view<Tdata> (p_fitter->get_data_set ()));
+            w.clear_param_modifier ();
+            diff_engine<Ts, Tp> engine (w.get_statistic ());
+            Ts h = engine.hessian (best_param, order, order);
+            if (!(h > 0) || !(std::abs (h) < std::numeric_limits<Ts>::max ()))
+                {
+                    return fallback;
+                }
+            Tpe e = std::sqrt (2 * dchi / h);
+            return e > 0 ? e : fallback;
+        }
+
+        // find the bound on one side of the best-fit value
+        Tpe search (const Tstr &pname, int direction, Tpe step, const Ts &dchi, const Ts &precision)
+        {
+            std::shared_ptr<profile_memo> pm = get_memo (pname);
+            std::unique_ptr<fitter_type> pw = make_worker (pname);
+            size_t order = p_fitter->get_param_order (pname);
+            const Tpe limit = direction > 0 ? p_fitter->get_param_info (order).get_upper_limit () :
+                                              p_fitter->get_param_info (order).get_lower_limit ();
+            const Ts target = best_statistic + dchi;
+            Tpe a = get_element (best_param, order);
+            Ts fa = best_statistic - target;
+            step = std::abs (step);
+
+            // bracket the root, doubling the step
+            Tpe b = a;
+            Ts fb = fa;
+            for (int i = 0; i < max_iter; ++i)
+                {
+                    b = a + direction * step;
+                    if ((direction > 0 && b >= limit) || (direction < 0 && b <= limit))
+                        {
+                            b = limit;
+                        }
+                    fb = profile_on (*pw, *pm, pname, b) - target;
+                    if (fb >= 0 || b == limit)
+                        {
+                            break;
+                        }
+                    a = b;
+                    fa = fb;
+                    step *= 2;
+                }
+            if (fb < 0)
+                {
+                    // the bound is beyond the parameter limit
+                    return b;
+                }
+            return find_root (*pw, *pm, pname, target, a, fa, b, fb, std::abs (precision));
+        }
+
+        // Brent's method for profile(x)=target on [a,b], fa and fb of opposite signs
+        Tpe find_root (fitter_type &w,
+                       profile_memo &memo,
+                       const Tstr &pname,
+                       const Ts &target,
+                       Tpe a,
+                       Ts fa,
+                       Tpe b,
+                       Ts fb,
+                       Tpe tol)
+        {
+            const Tpe eps = std::numeric_limits<Tpe>::epsilon ();
+            Tpe c = b;
+            Ts fc = fb;
+            Tpe d = 0;
+            Tpe e = 0;
+            for (int iter = 0; iter < max_iter; ++iter)
+                {
+                    if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0))
+                        {
+                            c = a;
+                            fc = fa;
+                            e = d = b - a;
+                        }
+                    if (std::abs (fc) < std::abs (fb))
+                        {
+                            a = b;
+                            b = c;
+                            c = a;
+                            fa = fb;
+                            fb = fc;
+                            fc = fa;
+                        }
+                    Tpe tol1 = 2 * eps * std::abs (b) + tol / 2;
+                    Tpe xm = (c - b) / 2;
+                    if (std::abs (xm) <= tol1 || fb == 0)
+                        {
+                            return b;
+                        }
+                    if (std::abs (e) >= tol1 && std::abs (fa) > std::abs (fb))
+                        {
+                            // inverse quadratic interpolation, or secant if only two points
+                            Tpe p, q, r;
+                            Tpe s = fb / fa;
+                            if (a == c)
+                                {
+                                    p = 2 * xm * s;
+                                    q = 1 - s;
+                                }
+                            else
+                                {
+                                    q = fa / fc;
+                                    r = fb / fc;
+                                    p = s * (2 * xm * q * (q - r) - (b - a) * (r - 1));
+                                    q = (q - 1) * (r - 1) * (s - 1);
+                                }
+                            if (p > 0)
+                                {
+                                    q = -q;
+                                }
+                            p = std::abs (p);
+                            Tpe min1 = 3 * xm * q - std::abs (tol1 * q);
+                            Tpe min2 = std::abs (e * q);
+                            if (2 * p < std::min (min1, min2))
+                                {
+                                    e = d;
+                                    d = p / q;
+                                }
+                            else
+                                {
+                                    d = xm;
+                                    e = d;
+                                }
+                        }
+                    else
+                        {
+                            d = xm;
+                            e = d;
+                        }
+                    a = b;
+                    fa = fb;
+                    b += std::abs (d) > tol1 ? d : (xm > 0 ? tol1 : -tol1);
+                    fb = profile_on (w, memo, pname, b) - target;
+                }
+            return b;
+        }
+
+        void run_tasks (std::vector<search_task> &tasks, const Ts &dchi, const Ts &precision)
+        {
+            // create the memos before the tasks run
+            for (size_t i = 0; i < tasks.size (); ++i)
+                {
+                    get_memo (tasks[i].pname);
+                }
+            search_task *pt = tasks.empty () ? NULL_PTR : &tasks[0];
+            auto run = [this, pt, &dchi, &precision](size_t i) {
+                pt[i].result = search (pt[i].pname, pt[i].direction, pt[i].initial_step, dchi, precision);
+            };
+            if (p_pool.get () == NULL_PTR)
+                {
+                    for (size_t i = 0; i < tasks.size (); ++i)
+                        {
+                            run (i);
+                        }
+                }
+            else
+                {
+                    p_pool->parallel_for (tasks.size (), run);
+                }
+        }
+
+      public:
+        /**
+           \param f a fitter holding a successful fit, which is taken as the best fit
+         */
+        explicit profile_likelihood (fitter_type &f) : p_fitter (&f), max_iter (100)
+        {
+            opt_assign (best_param, f.get_all_params ());
+            best_statistic = f.get_statistic_value ();
+        }
+
+        /**
+           run the searches on n threads
+           \param n the number of threads, 0 for all the cores, 1 for serial
+         */
+        void set_num_threads (size_t n)
+        {
+            p_pool.reset (n == 1 ? NULL_PTR : new thread_pool (n));
+        }
+
+        /**
+           Same as set_num_threads, but use an existing thread pool
+         */
+        void set_thread_pool (const std::shared_ptr<thread_pool> &pool)
+        {
+            p_pool = pool;
+        }
+
+        /**
+           set the maximum number of refits in the bracketing and in the
+           root finding of each bound
+         */
+        void set_max_iter (int n)
+        {
+            max_iter = n;
+        }
+
+        /**
+           \return the profiled statistic of a parameter at a value
+           \param pname the name of the parameter
+           \param v the value
+         */
+        Ts profile (const Tstr &pname, Tpe v)
+        {
+            std::shared_ptr<profile_memo> pm = get_memo (pname);
+            std::unique_ptr<fitter_type> pw = make_worker (pname);
+            return profile_on (*pw, *pm, pname, v);
+        }
+
+        /**
+           \return all the profiled points of a parameter computed so far,
+           (value, statistic) in ascending order of the value
+         */
+        std::vector<std::pair<Tpe, Ts>> get_profile (const Tstr &pname)
+        {
+            std::shared_ptr<profile_memo> pm = get_memo (pname);
+            std::lock_guard<std::mutex> lk (pm->mtx);
+            std::vector<std::pair<Tpe, Ts>> result;
+            for (typename std::map<Tpe, profile_point>::const_iterator i = pm->points.begin (); i != pm->points.end ();
+                 ++i)
+                {
+                    result.push_back (std::pair<Tpe, Ts> (i->first, i->second.statistic_value));
+                }
+            return result;
+        }
+
+        /**
+           the confidence interval of one parameter, the lower and upper
+           bounds are searched concurrently
+           \param pname the name of the parameter
+           \param dchi the rise of the statistic that defines the interval
+           \param precision the precision of the bounds
+           \param lower_step the first guess of the distance to the lower bound, 0 to derive it
+           from the curvature of the statistic
+           \param upper_step the same for the upper bound
+           \return the lower and upper bounds
+         */
+        std::pair<Tpe, Tpe>
+        interval (const Tstr &pname, const Ts &dchi, const Ts &precision, Tpe lower_step = 0, Tpe upper_step = 0)
+        {
+            std::vector<search_task> tasks (2);
+            Tpe guess = lower_step > 0 && upper_step > 0 ? Tpe (0) : step_from_curvature (pname, dchi);
+            tasks[0].pname = pname;
+            tasks[0].direction = -1;
+            tasks[0].initial_step = lower_step > 0 ? lower_step : guess;
+            tasks[1].pname = pname;
+            tasks[1].direction = 1;
+            tasks[1].initial_step = upper_step > 0 ? upper_step : guess;
+            run_tasks (tasks, dchi, precision);
+            return std::pair<Tpe, Tpe> (tasks[0].result, tasks[1].result);
+        }
+
+        /**
+           the confidence intervals of several parameters, all the bounds
+           are searched concurrently
+           \param pnames the names of the parameters
+           \param dchi the rise of the statistic that defines the interval
+           \param precision the precision of the bounds
+           \return the (lower, upper) bounds, in the order of pnames
+         */
+        std::vector<std::pair<Tpe, Tpe>> intervals (const std::vector<Tstr> &pnames, const Ts &dchi, const Ts &precision)
+        {
+            std::vector<search_task> tasks (2 * pnames.size ());
+            for (size_t i = 0; i < pnames.size (); ++i)
+                {
+                    Tpe guess = step_from_curvature (pnames[i], dchi);
+                    for (int j = 0; j < 2; ++j)
+                        {
+                            tasks[2 * i + j].pname = pnames[i];
+                            tasks[2 * i + j].direction = j == 0 ? -1 : 1;
+                            tasks[2 * i + j].initial_step = guess;
+                        }
+                }
+            run_tasks (tasks, dchi, precision);
+            std::vector<std::pair<Tpe, Tpe>> result (pnames.size ());
+            for (size_t i = 0; i < pnames.size (); ++i)
+                {
+                    result[i].first = tasks[2 * i].result;
+                    result[i].second = tasks[2 * i + 1].result;
+                }
+            return result;
+        }
+    };
+}
+
+#endif
+// EOF
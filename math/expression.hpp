@@ -0,0 +1,1286 @@
+/**
+   \file expression.hpp
+   \brief parsing arithmetic expressions of parameters and one self-var,
+   and evaluating them compiled on whole columns of self-vars
+   \author Junhua Gu
+ */
+
+
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+#define OPT_HEADER
+#include <core/opt_exception.hpp>
+#include <cstdlib>
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace opt_utilities
+{
+    /**
+       Thrown when an expression cannot be parsed, e.g., because of a
+       syntax error, or an unknown symbol or function
+     */
+    class expression_error : public opt_exception
+    {
+      public:
+        expression_error (const std::string &s) : opt_exception (s)
+        {
+        }
+    };
+
+    /**
+       the operations of the nodes of an expression
+     */
+    enum expr_op
+    {
+        EXPR_CONST,
+        EXPR_PARAM,
+        EXPR_VAR,
+        // unary
+        EXPR_NEG,
+        EXPR_NOT,
+        EXPR_SQRT,
+        EXPR_EXP,
+        EXPR_LOG,
+        EXPR_LOG10,
+        EXPR_LOG2,
+        EXPR_SIN,
+        EXPR_COS,
+        EXPR_TAN,
+        EXPR_ASIN,
+        EXPR_ACOS,
+        EXPR_ATAN,
+        EXPR_SINH,
+        EXPR_COSH,
+        EXPR_TANH,
+        EXPR_ASINH,
+        EXPR_ACOSH,
+        EXPR_ATANH,
+        EXPR_ABS,
+        EXPR_SIGN,
+        EXPR_RINT,
+        // binary
+        EXPR_ADD,
+        EXPR_SUB,
+        EXPR_MUL,
+        EXPR_DIV,
+        EXPR_POW,
+        EXPR_MIN,
+        EXPR_MAX,
+        EXPR_LT,
+        EXPR_GT,
+        EXPR_LE,
+        EXPR_GE,
+        EXPR_EQ,
+        EXPR_NE,
+        EXPR_AND,
+        EXPR_OR,
+        // ternary, arg[0]?arg[1]:arg[2]
+        EXPR_SELECT
+    };
+
+    /**
+       \brief a node of an expression, refering to its arguments by their
+       indices in the expression
+     */
+    template <typename T> struct expr_node
+    {
+        expr_op op;
+        // the value of EXPR_CONST, or the index of EXPR_PARAM
+        T value;
+        size_t index;
+        size_t arg[3];
+    };
+
+    /**
+       \brief An expression of named parameters and one self-var, stored as
+       a directed acyclic graph.
+       The nodes are created by the builder functions (constant, param,
+       unary, ...), which fold the constant subexpressions, simplify the
+       trivial operations (e.g., a+0, a*1, a*0, a^1), and return the
+       existing node if an identical one has been created, so the common
+       subexpressions are stored once.
+       The parser accepts the syntax of muParser: the operators
+       + - * / ^ (right associative, above the unary minus),
+       < > <= >= == != && || ! and ?:, the constants _pi and _e, and the
+       functions sqrt exp log (natural) ln log10 log2 sin cos tan asin acos
+       atan sinh cosh tanh asinh acosh atanh abs sign rint, and min max sum
+       avg of any number of arguments.
+       \tparam T the type of the values
+     */
+    template <typename T> class expression
+    {
+      private:
+        std::vector<expr_node<T>> nodes;
+        std::map<std::pair<std::pair<int, T>, std::pair<size_t, std::pair<size_t, size_t>>>, size_t> lookup;
+        std::vector<std::string> param_names;
+        std::string var_name;
+        size_t root;
+
+        // the parser state
+        const char *pos;
+        const char *begin;
+
+      private:
+        size_t add_node (expr_op op, T value, size_t index, size_t a0, size_t a1, size_t a2)
+        {
+            std::pair<std::pair<int, T>, std::pair<size_t, std::pair<size_t, size_t>>> key (
+            std::make_pair (int(op), value), std::make_pair (op == EXPR_PARAM ? index : a0, std::make_pair (a1, a2)));
+            typename std::map<std::pair<std::pair<int, T>, std::pair<size_t, std::pair<size_t, size_t>>>, size_t>::iterator i =
+            value == value ? lookup.find (key) : lookup.end ();
+            if (i != lookup.end ())
+                {
+                    return i->second;
+                }
+            expr_node<T> n;
+            n.op = op;
+            n.value = value;
+            n.index = index;
+            n.arg[0] = a0;
+            n.arg[1] = a1;
+            n.arg[2] = a2;
+            nodes.push_back (n);
+            // a NaN cannot be ordered in the lookup table
+            if (value == value)
+                {
+                    lookup.insert (std::make_pair (key, nodes.size () - 1));
+                }
+            return nodes.size () - 1;
+        }
+
+        bool is_const (size_t a, T v) const
+        {
+            return nodes[a].op == EXPR_CONST && nodes[a].value == v;
+        }
+
+        bool is_const (size_t a) const
+        {
+            return nodes[a].op == EXPR_CONST;
+        }
+
+        // the parser, by recursive descent
+
+        [[noreturn]] void error (const std::string &msg) const
+        {
+            throw expression_error (msg + " at position " + std::to_string (pos - begin));
+        }
+
+        void skip_space ()
+        {
+            while (*pos != 0 && std::isspace (static_cast<unsigned char> (*pos)))
+                {
+                    ++pos;
+                }
+        }
+
+        bool accept (const char *tok)
+        {
+            skip_space ();
+            size_t len = std::strlen (tok);
+            if (std::strncmp (pos, tok, len) == 0)
+                {
+                    pos += len;
+                    return true;
+                }
+            return false;
+        }
+
+        void expect (const char *tok)
+        {
+            if (!accept (tok))
+                {
+                    error (std::string ("expected '") + tok + "'");
+                }
+        }
+
+        size_t parse_ternary ()
+        {
+            size_t c = parse_or ();
+            if (accept ("?"))
+                {
+                    size_t a = parse_ternary ();
+                    expect (":");
+                    size_t b = parse_ternary ();
+                    return select (c, a, b);
+                }
+            return c;
+        }
+
+        size_t parse_or ()
+        {
+            size_t a = parse_and ();
+            while (accept ("||"))
+                {
+                    a = binary (EXPR_OR, a, parse_and ());
+                }
+            return a;
+        }
+
+        size_t parse_and ()
+        {
+            size_t a = parse_cmp ();
+            while (accept ("&&"))
+                {
+                    a = binary (EXPR_AND, a, parse_cmp ());
+                }
+            return a;
+        }
+
+        size_t parse_cmp ()
+        {
+            size_t a = parse_sum ();
+            for (;;)
+                {
+                    if (accept ("<="))
+                        {
+                            a = binary (EXPR_LE, a, parse_sum ());
+                        }
+                    else if (accept (">="))
+                        {
+                            a = binary (EXPR_GE, a, parse_sum ());
+                        }
+                    else if (accept ("=="))
+                        {
+                            a = binary (EXPR_EQ, a, parse_sum ());
+                        }
+                    else if (accept ("!="))
+                        {
+                            a = binary (EXPR_NE, a, parse_sum ());
+                        }
+                    else if (accept ("<"))
+                        {
+                            a = binary (EXPR_LT, a, parse_sum ());
+                        }
+                    else if (accept (">"))
+                        {
+                            a = binary (EXPR_GT, a, parse_sum ());
+                        }
+                    else
+                        {
+                            return a;
+                        }
+                }
+        }
+
+        size_t parse_sum ()
+        {
+            size_t a = parse_product ();
+            for (;;)
+                {
+                    if (accept ("+"))
+                        {
+                            a = binary (EXPR_ADD, a, parse_product ());
+                        }
+                    else if (accept ("-"))
+                        {
+                            a = binary (EXPR_SUB, a, parse_product ());
+                        }
+                    else
+                        {
+                            return a;
+                        }
+                }
+        }
+
+        size_t parse_product ()
+        {
+            size_t a = parse_unary ();
+            for (;;)
+                {
+                    if (accept ("*"))
+                        {
+                            a = binary (EXPR_MUL, a, parse_unary ());
+                        }
+                    else if (accept ("/"))
+                        {
+                            a = binary (EXPR_DIV, a, parse_unary ());
+                        }
+                    else
+                        {
+                            return a;
+                        }
+                }
+        }
+
+        size_t parse_unary ()
+        {
+            if (accept ("-"))
+                {
+                    return unary (EXPR_NEG, parse_unary ());
+                }
+            if (accept ("+"))
+                {
+                    return parse_unary ();
+                }
+            skip_space ();
+            if (pos[0] == '!' && pos[1] != '=')
+                {
+                    ++pos;
+                    return unary (EXPR_NOT, parse_unary ());
+                }
+            return parse_power ();
+        }
+
+        size_t parse_power ()
+        {
+            size_t a = parse_primary ();
+            if (accept ("^"))
+                {
+                    return binary (EXPR_POW, a, parse_unary ());
+                }
+            return a;
+        }
+
+        size_t parse_function (const std::string &name)
+        {
+            std::vector<size_t> args;
+            if (!accept (")"))
+                {
+                    do
+                        {
+                            args.push_back (parse_ternary ());
+                        }
+                    while (accept (","));
+                    expect (")");
+                }
+            static const struct
+            {
+                const char *name;
+                expr_op op;
+            } unary_functions[] = {{"sqrt", EXPR_SQRT}, {"exp", EXPR_EXP},     {"log", EXPR_LOG},   {"ln", EXPR_LOG},
+                                   {"log10", EXPR_LOG10}, {"log2", EXPR_LOG2}, {"sin", EXPR_SIN},   {"cos", EXPR_COS},
+                                   {"tan", EXPR_TAN},   {"asin", EXPR_ASIN},   {"acos", EXPR_ACOS}, {"atan", EXPR_ATAN},
+                                   {"sinh", EXPR_SINH}, {"cosh", EXPR_COSH},   {"tanh", EXPR_TANH}, {"asinh", EXPR_ASINH},
+                                   {"acosh", EXPR_ACOSH}, {"atanh", EXPR_ATANH}, {"abs", EXPR_ABS}, {"sign", EXPR_SIGN},
+                                   {"rint", EXPR_RINT}};
+            for (size_t i = 0; i < sizeof (unary_functions) / sizeof (unary_functions[0]); ++i)
+                {
+                    if (name == unary_functions[i].name)
+                        {
+                            if (args.size () != 1)
+                                {
+                                    error ("function " + name + " takes one argument");
+                                }
+                            return unary (unary_functions[i].op, args[0]);
+                        }
+                }
+            if (name == "min" || name == "max" || name == "sum" || name == "avg")
+                {
+                    if (args.empty ())
+                        {
+                            error ("function " + name + " takes at least one argument");
+                        }
+                    expr_op op = name == "min" ? EXPR_MIN : name == "max" ? EXPR_MAX : EXPR_ADD;
+                    size_t a = args[0];
+                    for (size_t i = 1; i < args.size (); ++i)
+                        {
+                            a = binary (op, a, args[i]);
+                        }
+                    if (name == "avg")
+                        {
+                            a = binary (EXPR_DIV, a, constant (T (args.size ())));
+                        }
+                    return a;
+                }
+            error ("unknown function " + name);
+        }
+
+        size_t parse_primary ()
+        {
+            skip_space ();
+            if (accept ("("))
+                {
+                    size_t a = parse_ternary ();
+                    expect (")");
+                    return a;
+                }
+            if (std::isdigit (static_cast<unsigned char> (*pos)) || (*pos == '.' && std::isdigit (static_cast<unsigned char> (pos[1]))))
+                {
+                    char *end;
+                    double v = std::strtod (pos, &end);
+                    pos = end;
+                    return constant (T (v));
+                }
+            if (std::isalpha (static_cast<unsigned char> (*pos)) || *pos == '_')
+                {
+                    const char *start = pos;
+                    while (std::isalnum (static_cast<unsigned char> (*pos)) || *pos == '_')
+                        {
+                            ++pos;
+                        }
+                    std::string name (start, pos);
+                    if (accept ("("))
+                        {
+                            return parse_function (name);
+                        }
+                    if (name == var_name)
+                        {
+                            return variable ();
+                        }
+                    for (size_t i = 0; i < param_names.size (); ++i)
+                        {
+                            if (name == param_names[i])
+                                {
+                                    return param (i);
+                                }
+                        }
+                    if (name == "_pi")
+                        {
+                            return constant (T (3.141592653589793238462643));
+                        }
+                    if (name == "_e")
+                        {
+                            return constant (T (2.718281828459045235360287));
+                        }
+                    pos = start;
+                    error ("unknown symbol " + name);
+                }
+            error (*pos == 0 ? std::string ("unexpected end") : std::string ("unexpected '") + *pos + "'");
+        }
+
+      public:
+        expression () : root (0), pos (NULL), begin (NULL)
+        {
+        }
+
+        /**
+           Parse an expression, replacing the current one
+           \param expr the expression
+           \param _param_names the names of the parameters, in the order of the parameter array
+           \param _var_name the name of the self-var
+         */
+        void parse (const std::string &expr, const std::vector<std::string> &_param_names, const std::string &_var_name)
+        {
+            nodes.clear ();
+            lookup.clear ();
+            param_names = _param_names;
+            var_name = _var_name;
+            begin = pos = expr.c_str ();
+            root = parse_ternary ();
+            skip_space ();
+            if (*pos != 0)
+                {
+                    error (std::string ("unexpected '") + *pos + "'");
+                }
+            begin = pos = NULL;
+        }
+
+        /**
+           \return the node of the parsed expression
+         */
+        size_t get_root () const
+        {
+            return root;
+        }
+
+        const expr_node<T> &get_node (size_t i) const
+        {
+            return nodes[i];
+        }
+
+        size_t num_nodes () const
+        {
+            return nodes.size ();
+        }
+
+        size_t num_params () const
+        {
+            return param_names.size ();
+        }
+
+        /**
+           evaluate one operation on values
+         */
+        static T apply (expr_op op, T a, T b = T (0), T c = T (0))
+        {
+            switch (op)
+                {
+                case EXPR_NEG:
+                    return -a;
+                case EXPR_NOT:
+                    return a == T (0) ? T (1) : T (0);
+                case EXPR_SQRT:
+                    return std::sqrt (a);
+                case EXPR_EXP:
+                    return std::exp (a);
+                case EXPR_LOG:
+                    return std::log (a);
+                case EXPR_LOG10:
+                    return std::log10 (a);
+                case EXPR_LOG2:
+                    return std::log (a) / std::log (T (2));
+                case EXPR_SIN:
+                    return std::sin (a);
+                case EXPR_COS:
+                    return std::cos (a);
+                case EXPR_TAN:
+                    return std::tan (a);
+                case EXPR_ASIN:
+                    return std::asin (a);
+                case EXPR_ACOS:
+                    return std::acos (a);
+                case EXPR_ATAN:
+                    return std::atan (a);
+                case EXPR_SINH:
+                    return std::sinh (a);
+                case EXPR_COSH:
+                    return std::cosh (a);
+                case EXPR_TANH:
+                    return std::tanh (a);
+                case EXPR_ASINH:
+                    return std::asinh (a);
+                case EXPR_ACOSH:
+                    return std::acosh (a);
+                case EXPR_ATANH:
+                    return std::atanh (a);
+                case EXPR_ABS:
+                    return std::abs (a);
+                case EXPR_SIGN:
+                    return a > T (0) ? T (1) : (a < T (0) ? T (-1) : T (0));
+                case EXPR_RINT:
+                    return std::floor (a + T (0.5));
+                case EXPR_ADD:
+                    return a + b;
+                case EXPR_SUB:
+                    return a - b;
+                case EXPR_MUL:
+                    return a * b;
+                case EXPR_DIV:
+                    return a / b;
+                case EXPR_POW:
+                    return std::pow (a, b);
+                case EXPR_MIN:
+                    return std::min (a, b);
+                case EXPR_MAX:
+                    return std::max (a, b);
+                case EXPR_LT:
+                    return T (a < b);
+                case EXPR_GT:
+                    return T (a > b);
+                case EXPR_LE:
+                    return T (a <= b);
+                case EXPR_GE:
+                    return T (a >= b);
+                case EXPR_EQ:
+                    return T (a == b);
+                case EXPR_NE:
+                    return T (a != b);
+                case EXPR_AND:
+                    return T (a != T (0) && b != T (0));
+                case EXPR_OR:
+                    return T (a != T (0) || b != T (0));
+                case EXPR_SELECT:
+                    return a != T (0) ? b : c;
+                default:
+                    return T (0);
+                }
+        }
+
+        // the builders
+
+        size_t constant (T v)
+        {
+            return add_node (EXPR_CONST, v, 0, 0, 0, 0);
+        }
+
+        size_t param (size_t i)
+        {
+            return add_node (EXPR_PARAM, T (0), i, 0, 0, 0);
+        }
+
+        size_t variable ()
+        {
+            return add_node (EXPR_VAR, T (0), 0, 0, 0, 0);
+        }
+
+        size_t unary (expr_op op, size_t a)
+        {
+            if (is_const (a))
+                {
+                    return constant (apply (op, nodes[a].value));
+                }
+            if (op == EXPR_NEG && nodes[a].op == EXPR_NEG)
+                {
+                    return nodes[a].arg[0];
+                }
+            return add_node (op, T (0), 0, a, 0, 0);
+        }
+
+        size_t binary (expr_op op, size_t a, size_t b)
+        {
+            if (is_const (a) && is_const (b))
+                {
+                    return constant (apply (op, nodes[a].value, nodes[b].value));
+                }
+            switch (op)
+                {
+                case EXPR_ADD:
+                    if (is_const (a, 0))
+                        {
+                            return b;
+                        }
+                    if (is_const (b, 0))
+                        {
+                            return a;
+                        }
+                    if (nodes[b].op == EXPR_NEG)
+                        {
+                            return binary (EXPR_SUB, a, nodes[b].arg[0]);
+                        }
+                    break;
+                case EXPR_SUB:
+                    if (is_const (b, 0))
+                        {
+                            return a;
+                        }
+                    if (is_const (a, 0))
+                        {
+                            return unary (EXPR_NEG, b);
+                        }
+                    if (a == b)
+                        {
+                            return constant (0);
+                        }
+                    break;
+                case EXPR_MUL:
+                    if (is_const (a, 0) || is_const (b, 0))
+                        {
+                            return constant (0);
+                        }
+                    if (is_const (a, 1))
+                        {
+                            return b;
+                        }
+                    if (is_const (b, 1))
+                        {
+                            return a;
+                        }
+                    if (is_const (a, -1))
+                        {
+                            return unary (EXPR_NEG, b);
+                        }
+                    if (is_const (b, -1))
+                        {
+                            return unary (EXPR_NEG, a);
+                        }
+                    break;
+                case EXPR_DIV:
+                    if (is_const (a, 0))
+                        {
+                            return constant (0);
+                        }
+                    if (is_const (b, 1))
+                        {
+                            return a;
+                        }
+                    break;
+                case EXPR_POW:
+                    if (is_const (b, 1))
+                        {
+                            return a;
+                        }
+                    if (is_const (b, 0))
+                        {
+                            return constant (1);
+                        }
+                    break;
+                default:
+                    break;
+                }
+            // the commutative operations are stored in one order, so that
+            // a+b and b+a are the same node
+            if ((op == EXPR_ADD || op == EXPR_MUL || op == EXPR_MIN || op == EXPR_MAX || op == EXPR_EQ ||
+                 op == EXPR_NE || op == EXPR_AND || op == EXPR_OR) &&
+                b < a)
+                {
+                    std::swap (a, b);
+                }
+            return add_node (op, T (0), 0, a, b, 0);
+        }
+
+        size_t select (size_t c, size_t a, size_t b)
+        {
+            if (is_const (c))
+                {
+                    return nodes[c].value != T (0) ? a : b;
+                }
+            if (a == b)
+                {
+                    return a;
+                }
+            return add_node (EXPR_SELECT, T (0), 0, c, a, b);
+        }
+
+        /**
+           Build the derivative of a node with respect to a parameter.
+           The derivative refers to the nodes of the original expression
+           where possible, e.g., d(exp(u))=exp(u)*du reuses exp(u), so that
+           a compiled_expression of the value and its derivatives evaluates
+           the shared subexpressions once.
+           The comparisons and the piecewise constant functions (sign,
+           rint, ...) are differentiated as constants, min, max and ?: by
+           the active branch.
+           \param node the node
+           \param i the index of the parameter
+           \return the node of the derivative
+         */
+        size_t derivative (size_t node, size_t i)
+        {
+            std::vector<size_t> memo (nodes.size (), size_t (-1));
+            return derive (node, i, memo);
+        }
+
+      private:
+        size_t derive (size_t k, size_t i, std::vector<size_t> &memo)
+        {
+            if (memo[k] != size_t (-1))
+                {
+                    return memo[k];
+                }
+            // a copy, the builders may reallocate the nodes
+            const expr_node<T> n = nodes[k];
+            const size_t a = n.arg[0];
+            const size_t b = n.arg[1];
+            size_t da = 0;
+            size_t db = 0;
+            if (n.op >= EXPR_NEG)
+                {
+                    da = derive (a, i, memo);
+                }
+            if (n.op >= EXPR_ADD && n.op != EXPR_SELECT)
+                {
+                    db = derive (b, i, memo);
+                }
+            size_t result;
+            switch (n.op)
+                {
+                case EXPR_PARAM:
+                    result = constant (n.index == i ? T (1) : T (0));
+                    break;
+                case EXPR_NEG:
+                    result = unary (EXPR_NEG, da);
+                    break;
+                case EXPR_SQRT:
+                    // du/(2 sqrt(u))
+                    result = binary (EXPR_DIV, da, binary (EXPR_MUL, constant (2), k));
+                    break;
+                case EXPR_EXP:
+                    result = binary (EXPR_MUL, k, da);
+                    break;
+                case EXPR_LOG:
+                    result = binary (EXPR_DIV, da, a);
+                    break;
+                case EXPR_LOG10:
+                    result = binary (EXPR_DIV, da, binary (EXPR_MUL, a, constant (std::log (T (10)))));
+                    break;
+                case EXPR_LOG2:
+                    result = binary (EXPR_DIV, da, binary (EXPR_MUL, a, constant (std::log (T (2)))));
+                    break;
+                case EXPR_SIN:
+                    result = binary (EXPR_MUL, unary (EXPR_COS, a), da);
+                    break;
+                case EXPR_COS:
+                    result = unary (EXPR_NEG, binary (EXPR_MUL, unary (EXPR_SIN, a), da));
+                    break;
+                case EXPR_TAN:
+                    // (1+tan(u)^2) du
+                    result = binary (EXPR_MUL, binary (EXPR_ADD, constant (1), binary (EXPR_MUL, k, k)), da);
+                    break;
+                case EXPR_ASIN:
+                case EXPR_ACOS:
+                    result = binary (EXPR_DIV, da,
+                                     unary (EXPR_SQRT, binary (EXPR_SUB, constant (1), binary (EXPR_MUL, a, a))));
+                    if (n.op == EXPR_ACOS)
+                        {
+                            result = unary (EXPR_NEG, result);
+                        }
+                    break;
+                case EXPR_ATAN:
+                    result = binary (EXPR_DIV, da, binary (EXPR_ADD, constant (1), binary (EXPR_MUL, a, a)));
+                    break;
+                case EXPR_SINH:
+                    result = binary (EXPR_MUL, unary (EXPR_COSH, a), da);
+                    break;
+                case EXPR_COSH:
+                    result = binary (EXPR_MUL, unary (EXPR_SINH, a), da);
+                    break;
+                case EXPR_TANH:
+                    result = binary (EXPR_MUL, binary (EXPR_SUB, constant (1), binary (EXPR_MUL, k, k)), da);
+                    break;
+                case EXPR_ASINH:
+                    result = binary (EXPR_DIV, da, unary (EXPR_SQRT, binary (EXPR_ADD, binary (EXPR_MUL, a, a), constant (1))));
+                    break;
+                case EXPR_ACOSH:
+                    result = binary (EXPR_DIV, da, unary (EXPR_SQRT, binary (EXPR_SUB, binary (EXPR_MUL, a, a), constant (1))));
+                    break;
+                case EXPR_ATANH:
+                    result = binary (EXPR_DIV, da, binary (EXPR_SUB, constant (1), binary (EXPR_MUL, a, a)));
+                    break;
+                case EXPR_ABS:
+                    result = binary (EXPR_MUL, unary (EXPR_SIGN, a), da);
+                    break;
+                case EXPR_ADD:
+                    result = binary (EXPR_ADD, da, db);
+                    break;
+                case EXPR_SUB:
+                    result = binary (EXPR_SUB, da, db);
+                    break;
+                case EXPR_MUL:
+                    result = binary (EXPR_ADD, binary (EXPR_MUL, da, b), binary (EXPR_MUL, a, db));
+                    break;
+                case EXPR_DIV:
+                    // (du-(u/v) dv)/v
+                    result = binary (EXPR_DIV, binary (EXPR_SUB, da, binary (EXPR_MUL, k, db)), b);
+                    break;
+                case EXPR_POW:
+                    if (is_const (db, 0))
+                        {
+                            // v u^(v-1) du
+                            result = binary (
+                            EXPR_MUL, binary (EXPR_MUL, b, binary (EXPR_POW, a, binary (EXPR_SUB, b, constant (1)))), da);
+                        }
+                    else
+                        {
+                            // u^v (dv log(u) + v du/u), and 0 where u^v is 0,
+                            // e.g. at u=0, where log(u) and 1/u are not finite
+                            result = binary (EXPR_MUL, k,
+                                             binary (EXPR_ADD, binary (EXPR_MUL, db, unary (EXPR_LOG, a)),
+                                                     binary (EXPR_DIV, binary (EXPR_MUL, b, da), a)));
+                            result = select (binary (EXPR_EQ, k, constant (0)), constant (0), result);
+                        }
+                    break;
+                case EXPR_MIN:
+                    result = select (binary (EXPR_LE, a, b), da, db);
+                    break;
+                case EXPR_MAX:
+                    result = select (binary (EXPR_GE, a, b), da, db);
+                    break;
+                case EXPR_SELECT:
+                    result = select (a, derive (b, i, memo), derive (n.arg[2], i, memo));
+                    break;
+                default:
+                    // constants, the self-var, and the piecewise constant operations
+                    result = constant (0);
+                    break;
+                }
+            memo[k] = result;
+            return result;
+        }
+    };
+
+    /**
+       \brief the buffers used by compiled_expression::eval, every thread
+       evaluating a compiled_expression needs its own
+     */
+    template <typename T> struct expression_workspace
+    {
+        std::vector<T> scalars;
+        std::vector<T> columns;
+        // the parameters and the program of the scalars, so that the
+        // scalars are reused while the parameters do not change
+        std::vector<T> params;
+        unsigned long program_id;
+
+        expression_workspace () : program_id (0)
+        {
+        }
+    };
+
+    /**
+       \brief Some nodes of an expression compiled for evaluation on many
+       self-vars at once.
+       The nodes that depend only on the parameters are evaluated once per
+       call, the others once per instruction on blocks of self-vars, so the
+       interpretation costs little per self-var. The constant subexpressions
+       have been folded when the expression was built. The integer powers
+       are computed by multiplications.
+       A compiled_expression is not modified by eval, so one can be shared
+       by several threads, each with its own expression_workspace.
+       \tparam T the type of the values
+     */
+    template <typename T> class compiled_expression
+    {
+      public:
+        /// the number of self-vars evaluated by one pass of the instructions
+        static const size_t block_size = 256;
+
+      private:
+        enum operand_kind
+        {
+            SCALAR,
+            COLUMN,
+            SELF_VAR
+        };
+
+        struct instruction
+        {
+            expr_op op;
+            // the exponent of an integer power, 0 if op is not an integer power
+            int ipow;
+            size_t dst;
+            size_t src[3];
+            operand_kind kind[3];
+        };
+
+        struct output
+        {
+            operand_kind kind;
+            size_t index;
+        };
+
+        // distinguishes the programs in expression_workspace
+        unsigned long id;
+        size_t n_params;
+        std::vector<T> initial_scalars;
+        // scalar slot of every parameter, or -1 if the parameter is unused
+        std::vector<size_t> param_slots;
+        std::vector<instruction> scalar_code;
+        std::vector<instruction> column_code;
+        size_t n_columns;
+        std::vector<output> outputs;
+
+      private:
+        static unsigned long next_id ()
+        {
+            static std::atomic<unsigned long> counter (0);
+            return ++counter;
+        }
+
+        static T ipower (T a, int n)
+        {
+            bool inverse = n < 0;
+            unsigned int m = inverse ? -n : n;
+            T result = 1;
+            while (m != 0)
+                {
+                    if (m & 1)
+                        {
+                            result *= a;
+                        }
+                    a *= a;
+                    m >>= 1;
+                }
+            return inverse ? T (1) / result : result;
+        }
+
+        static int small_integer (T v)
+        {
+            if (v == std::floor (v) && std::abs (v) <= 16 && v != 0)
+                {
+                    return int(v);
+                }
+            return 0;
+        }
+
+        // compile the node i and its arguments, return where its value goes
+        output compile (const expression<T> &e, size_t i, std::vector<output> &done, std::vector<bool> &visited)
+        {
+            if (visited[i])
+                {
+                    return done[i];
+                }
+            const expr_node<T> &n = e.get_node (i);
+            output result;
+            if (n.op == EXPR_CONST)
+                {
+                    result.kind = SCALAR;
+                    result.index = initial_scalars.size ();
+                    initial_scalars.push_back (n.value);
+                }
+            else if (n.op == EXPR_PARAM)
+                {
+                    result.kind = SCALAR;
+                    result.index = initial_scalars.size ();
+                    initial_scalars.push_back (T (0));
+                    param_slots[n.index] = result.index;
+                }
+            else if (n.op == EXPR_VAR)
+                {
+                    result.kind = SELF_VAR;
+                    result.index = 0;
+                }
+            else
+                {
+                    size_t nargs = n.op == EXPR_SELECT ? 3 : (n.op >= EXPR_ADD ? 2 : 1);
+                    instruction ins;
+                    ins.op = n.op;
+                    ins.ipow = 0;
+                    bool is_column = false;
+                    size_t nsrc = nargs;
+                    if (n.op == EXPR_POW && e.get_node (n.arg[1]).op == EXPR_CONST)
+                        {
+                            ins.ipow = small_integer (e.get_node (n.arg[1]).value);
+                            if (ins.ipow != 0)
+                                {
+                                    nsrc = 1;
+                                }
+                        }
+                    for (size_t k = 0; k < 3; ++k)
+                        {
+                            ins.src[k] = 0;
+                            ins.kind[k] = SCALAR;
+                        }
+                    for (size_t k = 0; k < nsrc; ++k)
+                        {
+                            output a = compile (e, n.arg[k], done, visited);
+                            ins.src[k] = a.index;
+                            ins.kind[k] = a.kind;
+                            is_column = is_column || a.kind != SCALAR;
+                        }
+                    if (is_column)
+                        {
+                            result.kind = COLUMN;
+                            result.index = n_columns++;
+                            ins.dst = result.index;
+                            column_code.push_back (ins);
+                        }
+                    else
+                        {
+                            result.kind = SCALAR;
+                            result.index = initial_scalars.size ();
+                            initial_scalars.push_back (T (0));
+                            ins.dst = result.index;
+                            scalar_code.push_back (ins);
+                        }
+                }
+            visited[i] = true;
+            done[i] = result;
+            return result;
+        }
+
+        static T apply (const instruction &ins, T a, T b, T c)
+        {
+            return ins.ipow != 0 ? ipower (a, ins.ipow) : expression<T>::apply (ins.op, a, b, c);
+        }
+
+        template <typename F> static void loop1 (T *out, const T *a, size_t sa, size_t n, F f)
+        {
+            if (sa == 0)
+                {
+                    T v = f (a[0]);
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            out[i] = v;
+                        }
+                    return;
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = f (a[i]);
+                }
+        }
+
+        template <typename F> static void loop2 (T *out, const T *a, size_t sa, const T *b, size_t sb, size_t n, F f)
+        {
+            if (sa != 0 && sb != 0)
+                {
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            out[i] = f (a[i], b[i]);
+                        }
+                }
+            else if (sa != 0)
+                {
+                    const T vb = b[0];
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            out[i] = f (a[i], vb);
+                        }
+                }
+            else
+                {
+                    const T va = a[0];
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            out[i] = f (va, b[i]);
+                        }
+                }
+        }
+
+        static void run_column (const instruction &ins, const T *args[3], const size_t strides[3], T *out, size_t n)
+        {
+            const T *a = args[0];
+            const T *b = args[1];
+            const size_t sa = strides[0];
+            const size_t sb = strides[1];
+            if (ins.ipow == 2)
+                {
+                    loop1 (out, a, sa, n, [](T u) { return u * u; });
+                    return;
+                }
+            if (ins.ipow != 0)
+                {
+                    const int m = ins.ipow;
+                    loop1 (out, a, sa, n, [m](T u) { return ipower (u, m); });
+                    return;
+                }
+            // the frequent arithmetic in tight loops, the rest through apply
+            switch (ins.op)
+                {
+                case EXPR_NEG:
+                    loop1 (out, a, sa, n, [](T u) { return -u; });
+                    return;
+                case EXPR_EXP:
+                    loop1 (out, a, sa, n, [](T u) { return std::exp (u); });
+                    return;
+                case EXPR_LOG:
+                    loop1 (out, a, sa, n, [](T u) { return std::log (u); });
+                    return;
+                case EXPR_SQRT:
+                    loop1 (out, a, sa, n, [](T u) { return std::sqrt (u); });
+                    return;
+                case EXPR_ADD:
+                    loop2 (out, a, sa, b, sb, n, [](T u, T v) { return u + v; });
+                    return;
+                case EXPR_SUB:
+                    loop2 (out, a, sa, b, sb, n, [](T u, T v) { return u - v; });
+                    return;
+                case EXPR_MUL:
+                    loop2 (out, a, sa, b, sb, n, [](T u, T v) { return u * v; });
+                    return;
+                case EXPR_DIV:
+                    loop2 (out, a, sa, b, sb, n, [](T u, T v) { return u / v; });
+                    return;
+                case EXPR_POW:
+                    loop2 (out, a, sa, b, sb, n, [](T u, T v) { return std::pow (u, v); });
+                    return;
+                default:
+                    break;
+                }
+            const T *c = args[2];
+            const size_t sc = strides[2];
+            const expr_op op = ins.op;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = expression<T>::apply (op, a[i * sa], b[i * sb], c[i * sc]);
+                }
+        }
+
+      public:
+        compiled_expression () : id (next_id ()), n_params (0), initial_scalars (1, T (0)), n_columns (0)
+        {
+        }
+
+        /**
+           \param e the expression
+           \param roots the nodes to be evaluated, the outputs of eval in this order
+         */
+        compiled_expression (const expression<T> &e, const std::vector<size_t> &roots)
+        : id (next_id ()), n_params (e.num_params ()), initial_scalars (1, T (0)), param_slots (e.num_params (), size_t (-1)), n_columns (0)
+        {
+            // the slot 0 is read by the unused operands
+            std::vector<output> done (e.num_nodes ());
+            std::vector<bool> visited (e.num_nodes (), false);
+            for (size_t i = 0; i < roots.size (); ++i)
+                {
+                    outputs.push_back (compile (e, roots[i], done, visited));
+                }
+        }
+
+        size_t num_outputs () const
+        {
+            return outputs.size ();
+        }
+
+        size_t num_params () const
+        {
+            return n_params;
+        }
+
+        /**
+           evaluate the outputs on a column of self-vars
+           \param params the parameters, num_params() elements
+           \param xs the self-vars
+           \param n the number of self-vars
+           \param outs the arrays of the values of every output, n elements each
+           \param ws the buffers
+         */
+        void eval (const T *params, const T *xs, size_t n, T *const *outs, expression_workspace<T> &ws) const
+        {
+            if (ws.program_id != id || !std::equal (ws.params.begin (), ws.params.end (), params))
+                {
+                    ws.program_id = id;
+                    ws.params.assign (params, params + n_params);
+                    ws.scalars = initial_scalars;
+                    for (size_t i = 0; i < n_params; ++i)
+                        {
+                            if (param_slots[i] != size_t (-1))
+                                {
+                                    ws.scalars[param_slots[i]] = params[i];
+                                }
+                        }
+                    for (size_t k = 0; k < scalar_code.size (); ++k)
+                        {
+                            const instruction &ins = scalar_code[k];
+                            ws.scalars[ins.dst] =
+                            apply (ins, ws.scalars[ins.src[0]], ws.scalars[ins.src[1]], ws.scalars[ins.src[2]]);
+                        }
+                }
+            for (size_t j = 0; j < outputs.size (); ++j)
+                {
+                    if (outputs[j].kind == SCALAR)
+                        {
+                            std::fill (outs[j], outs[j] + n, ws.scalars[outputs[j].index]);
+                        }
+                }
+            if (n == 0)
+                {
+                    return;
+                }
+            const size_t bs = std::min (n, block_size);
+            ws.columns.resize (n_columns * bs);
+            for (size_t i0 = 0; i0 < n; i0 += bs)
+                {
+                    const size_t m = std::min (bs, n - i0);
+                    for (size_t k = 0; k < column_code.size (); ++k)
+                        {
+                            const instruction &ins = column_code[k];
+                            const T *args[3] = {NULL, NULL, NULL};
+                            size_t strides[3] = {0, 0, 0};
+                            for (size_t a = 0; a < 3; ++a)
+                                {
+                                    switch (ins.kind[a])
+                                        {
+                                        case SCALAR:
+                                            args[a] = &ws.scalars[ins.src[a]];
+                                            strides[a] = 0;
+                                            break;
+                                        case COLUMN:
+                                            args[a] = &ws.columns[ins.src[a] * bs];
+                                            strides[a] = 1;
+                                            break;
+                                        case SELF_VAR:
+                                            args[a] = xs + i0;
+                                            strides[a] = 1;
+                                            break;
+                                        }
+                                }
+                            run_column (ins, args, strides, &ws.columns[ins.dst * bs], m);
+                        }
+                    for (size_t j = 0; j < outputs.size (); ++j)
+                        {
+                            if (outputs[j].kind == COLUMN)
+                                {
+                                    std::copy (&ws.columns[outputs[j].index * bs], &ws.columns[outputs[j].index * bs] + m, outs[j] + i0);
+                                }
+                            else if (outputs[j].kind == SELF_VAR)
+                                {
+                                    std::copy (xs + i0, xs + i0 + m, outs[j] + i0);
+                                }
+                        }
+                }
+        }
+    };
+
+    template <typename T> const size_t compiled_expression<T>::block_size;
+}
+
+#endif
+// EOF
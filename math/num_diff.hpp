@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <limits>
 #include <cmath>
+#include <vector>
 
 namespace opt_utilities
 {
@@ -24,11 +25,40 @@ namespace opt_utilities
       private:
         virtual pT do_gradient (const pT &p) = 0;
 
+        /**
+           The default evaluates the value and the gradient separately.
+           Override it if both can be computed together more cheaply.
+         */
+        virtual rT do_eval_with_gradient (const pT &p, pT &grad)
+        {
+            opt_assign (grad, do_gradient (p));
+            return this->eval (p);
+        }
+
       public:
         pT gradient (const pT &p)
         {
+            if (this->get_stats () != NULL_PTR)
+                {
+                    this->get_stats ()->count_gradient ();
+                }
             return do_gradient (p);
         }
+
+        /**
+           evaluate the value and the gradient at once
+           \param p the parameter
+           \param grad output as the gradient
+           \return the value
+         */
+        rT eval_with_gradient (const pT &p, pT &grad)
+        {
+            if (this->get_stats () != NULL_PTR)
+                {
+                    this->get_stats ()->count_gradient ();
+                }
+            return do_eval_with_gradient (p, grad);
+        }
     };
 
 
@@ -50,6 +80,74 @@ namespace opt_utilities
         return result;
     }
 
+    /**
+       \brief the buffers of central_gradient, so that it does not allocate
+       when called repeatedly with parameters of the same size
+     */
+    template <typename rT, typename pT> struct central_gradient_workspace
+    {
+        std::vector<pT> points;
+        std::vector<rT> values;
+        std::vector<typename element_type_trait<pT>::element_type> h;
+    };
+
+    /**
+       the gradient by central differences, with the same steps as gradient(f,p,n),
+       the points of up to 32 parameters at a time are evaluated as one batch,
+       see func_obj::eval_many
+       \param f the func_obj
+       \param p the parameter
+       \param result output as the gradient
+       \param ws the buffers
+     */
+    template <typename rT, typename pT>
+    void central_gradient (func_obj<rT, pT> &f, const pT &p, pT &result, central_gradient_workspace<rT, pT> &ws)
+    {
+        typedef typename element_type_trait<pT>::element_type Te;
+        const size_t block = 32;
+        rT ep = std::sqrt (std::numeric_limits<rT>::epsilon ());
+        size_t n = get_size (p);
+        if (get_size (result) != n)
+            {
+                resize (result, n);
+            }
+        ws.points.resize (2 * std::min (n, block), p);
+        ws.values.resize (ws.points.size ());
+        ws.h.resize (ws.points.size () / 2);
+        for (size_t i0 = 0; i0 < n; i0 += block)
+            {
+                size_t m = std::min (block, n - i0);
+                for (size_t k = 0; k < m; ++k)
+                    {
+                        Te old_value = get_element (p, i0 + k);
+                        ws.h[k] = std::max (old_value, rT (1)) * ep;
+                        opt_assign (ws.points[2 * k], p);
+                        opt_assign (ws.points[2 * k + 1], p);
+                        set_element (ws.points[2 * k], i0 + k, old_value + ws.h[k]);
+                        set_element (ws.points[2 * k + 1], i0 + k, old_value - ws.h[k]);
+                    }
+                f.eval_many (&ws.points[0], 2 * m, &ws.values[0]);
+                for (size_t k = 0; k < m; ++k)
+                    {
+                        set_element (result, i0 + k, (ws.values[2 * k] - ws.values[2 * k + 1]) / ws.h[k] / 2);
+                    }
+            }
+    }
+
+    /**
+       the gradient by central differences, see above
+       \param f the func_obj
+       \param p the parameter
+       \return the gradient
+     */
+    template <typename rT, typename pT> pT central_gradient (func_obj<rT, pT> &f, const pT &p)
+    {
+        pT result;
+        central_gradient_workspace<rT, pT> ws;
+        central_gradient (f, p, result, ws);
+        return result;
+    }
+
     template <typename rT, typename pT> pT gradient (func_obj<rT, pT> &f, pT &p)
     {
         diff_func_obj<rT, pT> *pdfo = 0;
@@ -57,13 +155,11 @@ namespace opt_utilities
             {
                 return pdfo->gradient (p);
             }
-        pT result;
-        resize (result, get_size (p));
-        for (int i = 0; i < get_size (p); ++i)
+        if (f.get_stats () != NULL_PTR)
             {
-                set_element (result, i, gradient (f, p, i));
+                f.get_stats ()->count_gradient ();
             }
-        return result;
+        return central_gradient (f, p);
     }
 
 
@@ -73,46 +169,393 @@ namespace opt_utilities
         rT ep = std::sqrt (std::numeric_limits<rT>::epsilon ());
         typename element_type_trait<pT>::element_type hn = std::max (get_element (p, n), rT (1)) * ep;
         typename element_type_trait<pT>::element_type hm = std::max (get_element (p, m), rT (1)) * ep;
-        pT p11;
-        resize (p11, get_size (p));
-        pT p00;
-        resize (p00, get_size (p));
-        pT p10;
-        resize (p10, get_size (p));
-        pT p01;
-        resize (p01, get_size (p));
-
+        // one working copy, perturbed in place
+        pT q;
+        resize (q, get_size (p));
         for (size_t i = 0; i < get_size (p); ++i)
             {
-                set_element (p11, i, get_element (p, i));
-                set_element (p00, i, get_element (p, i));
-                set_element (p01, i, get_element (p, i));
-                set_element (p10, i, get_element (p, i));
+                set_element (q, i, get_element (p, i));
             }
+        typename element_type_trait<pT>::element_type qm = get_element (p, m);
+        typename element_type_trait<pT>::element_type qn = get_element (p, n);
 
-        set_element (p11, m, get_element (p11, m) + hm);
-        set_element (p11, n, get_element (p11, n) + hn);
-        set_element (p00, m, get_element (p00, m) - hm);
-        set_element (p00, n, get_element (p00, n) - hn);
-        set_element (p10, m, get_element (p10, m) + hm);
-        set_element (p10, n, get_element (p10, n) - hn);
-        set_element (p01, m, get_element (p01, m) - hm);
-        set_element (p01, n, get_element (p01, n) + hn);
+        set_element (q, m, qm + hm);
+        set_element (q, n, get_element (q, n) + hn);
+        rT f11 = f (q);
+        set_element (q, m, qm);
+        set_element (q, n, qn);
+        set_element (q, m, qm - hm);
+        set_element (q, n, get_element (q, n) - hn);
+        rT f00 = f (q);
+        set_element (q, m, qm);
+        set_element (q, n, qn);
+        set_element (q, m, qm - hm);
+        set_element (q, n, get_element (q, n) + hn);
+        rT f01 = f (q);
+        set_element (q, m, qm);
+        set_element (q, n, qn);
+        set_element (q, m, qm + hm);
+        set_element (q, n, get_element (q, n) - hn);
+        rT f10 = f (q);
 
-        rT result = (f (p11) + f (p00) - f (p01) - f (p10)) / (4 * hm * hn);
+        rT result = (f11 + f00 - f01 - f10) / (4 * hm * hn);
         return result;
     }
 
 
     template <typename rT, typename pT> rT div (func_obj<rT, pT> &f, const pT &p)
     {
+        // same stencil as sum_i hessian(f,p,i,i), but f(p) is evaluated only once
+        rT ep = std::sqrt (std::numeric_limits<rT>::epsilon ());
+        pT q;
+        resize (q, get_size (p));
+        for (size_t i = 0; i < get_size (p); ++i)
+            {
+                set_element (q, i, get_element (p, i));
+            }
+        rT f0 = f (q);
         rT result = 0;
-        for (int i = 0; i < get_size (p); ++i)
+        for (size_t i = 0; i < get_size (p); ++i)
             {
-                result += hessian (f, p, i, i);
+                typename element_type_trait<pT>::element_type old_value = get_element (p, i);
+                typename element_type_trait<pT>::element_type h = std::max (old_value, rT (1)) * ep;
+                set_element (q, i, old_value + h);
+                set_element (q, i, get_element (q, i) + h);
+                rT f11 = f (q);
+                set_element (q, i, old_value - h);
+                set_element (q, i, get_element (q, i) - h);
+                rT f00 = f (q);
+                set_element (q, i, old_value);
+                result += (f11 + f00 - f0 - f0) / (4 * h * h);
             }
         return result;
     }
+
+
+    /**
+       the finite difference schemes of diff_engine
+     */
+    enum diff_mode
+    {
+        /// (f(p+h)-f(p))/h, n extra evaluations for a gradient
+        diff_forward,
+        /// (f(p+h)-f(p-h))/2h, 2n evaluations for a gradient
+        diff_central,
+        /// Richardson extrapolation of central differences with h and h/2, 4n evaluations
+        diff_richardson
+    };
+
+    /**
+       \brief finite-difference engine.
+       It collects all the stencil points of a gradient or a Hessian first,
+       and then evaluates them as one batch by func_obj::eval_many, i.e.,
+       concurrently when the eval_executor of the process has several threads.
+       The points and their values are kept in reused buffers.
+       The result does not depend on the number of threads.
+       \tparam rT return type of the func_obj
+       \tparam pT parameter type of the func_obj
+     */
+    template <typename rT, typename pT> class diff_engine
+    {
+      public:
+        typedef typename element_type_trait<pT>::element_type Te;
+
+      private:
+        func_obj<rT, pT> *p_fo;
+        diff_mode mode;
+        std::vector<Te> steps;
+
+        std::vector<pT> points;
+        std::vector<rT> values;
+        size_t npoints;
+
+      private:
+        diff_engine (const diff_engine &);
+        diff_engine &operator= (const diff_engine &);
+
+        // step for the i-th parameter, the default is scale*max(|p_i|,1)
+        Te step (const pT &p, size_t i, rT scale) const
+        {
+            if (i < steps.size () && steps[i] > 0)
+                {
+                    return steps[i];
+                }
+            Te a = std::abs (get_element (p, i));
+            return std::max (a, Te (1)) * scale;
+        }
+
+        // append p + hi*e_i + hj*e_j to the list of points, return its index
+        size_t add_point (const pT &p, size_t i, Te hi, size_t j, Te hj)
+        {
+            if (npoints == points.size ())
+                {
+                    points.push_back (pT ());
+                }
+            pT &q = points[npoints];
+            if (get_size (q) != get_size (p))
+                {
+                    resize (q, get_size (p));
+                }
+            for (size_t k = 0; k < get_size (p); ++k)
+                {
+                    set_element (q, k, get_element (p, k));
+                }
+            if (hi != 0)
+                {
+                    set_element (q, i, get_element (q, i) + hi);
+                }
+            if (hj != 0)
+                {
+                    set_element (q, j, get_element (q, j) + hj);
+                }
+            return npoints++;
+        }
+
+        void eval_points ()
+        {
+            values.resize (npoints);
+            if (npoints != 0)
+                {
+                    p_fo->eval_many (&points[0], npoints, &values[0]);
+                }
+        }
+
+      public:
+        /**
+           construct an engine on a func_obj, which must outlive the engine
+           \param f the func_obj
+           \param m the difference scheme
+         */
+        explicit diff_engine (func_obj<rT, pT> &f, diff_mode m = diff_central)
+        : p_fo (&f), mode (m), npoints (0)
+        {
+        }
+
+        /**
+           set the difference scheme used by gradient
+         */
+        void set_mode (diff_mode m)
+        {
+            mode = m;
+        }
+
+        diff_mode get_mode () const
+        {
+            return mode;
+        }
+
+        /**
+           set the step of every parameter, a step <= 0 means the default one
+         */
+        void set_steps (const pT &h)
+        {
+            steps.resize (get_size (h));
+            for (size_t i = 0; i < get_size (h); ++i)
+                {
+                    steps[i] = get_element (h, i);
+                }
+        }
+
+        /**
+           set the step of the i-th parameter
+         */
+        void set_step (size_t i, Te h)
+        {
+            if (steps.size () <= i)
+                {
+                    steps.resize (i + 1, Te (0));
+                }
+            steps[i] = h;
+        }
+
+        /**
+           \return the number of function evaluations made by the last call
+         */
+        size_t get_num_evals () const
+        {
+            return npoints;
+        }
+
+        /**
+           the gradient of the func_obj at p
+           \param p the parameter
+           \return the gradient
+         */
+        pT gradient (const pT &p)
+        {
+            if (p_fo->get_stats () != NULL_PTR)
+                {
+                    p_fo->get_stats ()->count_gradient ();
+                }
+            const rT ep = std::numeric_limits<rT>::epsilon ();
+            size_t n = get_size (p);
+            pT result;
+            resize (result, n);
+            npoints = 0;
+            switch (mode)
+                {
+                case diff_forward:
+                    {
+                        add_point (p, 0, 0, 0, 0);
+                        for (size_t i = 0; i < n; ++i)
+                            {
+                                add_point (p, i, step (p, i, std::sqrt (ep)), i, 0);
+                            }
+                        eval_points ();
+                        for (size_t i = 0; i < n; ++i)
+                            {
+                                set_element (result, i, (values[i + 1] - values[0]) / step (p, i, std::sqrt (ep)));
+                            }
+                        break;
+                    }
+                case diff_central:
+                    {
+                        for (size_t i = 0; i < n; ++i)
+                            {
+                                Te h = step (p, i, std::cbrt (ep));
+                                add_point (p, i, h, i, 0);
+                                add_point (p, i, -h, i, 0);
+                            }
+                        eval_points ();
+                        for (size_t i = 0; i < n; ++i)
+                            {
+                                Te h = step (p, i, std::cbrt (ep));
+                                set_element (result, i, (values[2 * i] - values[2 * i + 1]) / (2 * h));
+                            }
+                        break;
+                    }
+                case diff_richardson:
+                    {
+                        for (size_t i = 0; i < n; ++i)
+                            {
+                                Te h = step (p, i, std::pow (ep, rT (.2)));
+                                add_point (p, i, h, i, 0);
+                                add_point (p, i, -h, i, 0);
+                                add_point (p, i, h / 2, i, 0);
+                                add_point (p, i, -h / 2, i, 0);
+                            }
+                        eval_points ();
+                        for (size_t i = 0; i < n; ++i)
+                            {
+                                Te h = step (p, i, std::pow (ep, rT (.2)));
+                                rT d1 = (values[4 * i] - values[4 * i + 1]) / (2 * h);
+                                rT d2 = (values[4 * i + 2] - values[4 * i + 3]) / h;
+                                set_element (result, i, (4 * d2 - d1) / 3);
+                            }
+                        break;
+                    }
+                }
+            return result;
+        }
+
+        /**
+           The full Hessian at p, on a shared stencil: f(p), the 2n axis
+           points p+-h_i e_i, and the n(n-1) points p+h_i e_i+h_j e_j,
+           p-h_i e_i-h_j e_j for i<j, i.e., 1+n+n^2 evaluations in total.
+           \param p the parameter
+           \param h the Hessian in row-major order, resized to n*n
+         */
+        void hessian (const pT &p, std::vector<rT> &h)
+        {
+            const rT scale = std::pow (std::numeric_limits<rT>::epsilon (), rT (.25));
+            size_t n = get_size (p);
+            npoints = 0;
+            add_point (p, 0, 0, 0, 0);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    Te hi = step (p, i, scale);
+                    add_point (p, i, hi, i, 0);
+                    add_point (p, i, -hi, i, 0);
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    for (size_t j = i + 1; j < n; ++j)
+                        {
+                            Te hi = step (p, i, scale);
+                            Te hj = step (p, j, scale);
+                            add_point (p, i, hi, j, hj);
+                            add_point (p, i, -hi, j, -hj);
+                        }
+                }
+            eval_points ();
+            h.resize (n * n);
+            const rT f0 = values[0];
+            for (size_t i = 0; i < n; ++i)
+                {
+                    Te hi = step (p, i, scale);
+                    h[i * n + i] = (values[1 + 2 * i] - 2 * f0 + values[2 + 2 * i]) / (hi * hi);
+                }
+            size_t k = 1 + 2 * n;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    for (size_t j = i + 1; j < n; ++j, k += 2)
+                        {
+                            Te hi = step (p, i, scale);
+                            Te hj = step (p, j, scale);
+                            rT fpp = values[k];
+                            rT fmm = values[k + 1];
+                            rT fpi = values[1 + 2 * i];
+                            rT fmi = values[2 + 2 * i];
+                            rT fpj = values[1 + 2 * j];
+                            rT fmj = values[2 + 2 * j];
+                            rT hij = (fpp - fpi - fpj + 2 * f0 - fmi - fmj + fmm) / (2 * hi * hj);
+                            h[i * n + j] = hij;
+                            h[j * n + i] = hij;
+                        }
+                }
+        }
+
+        /**
+           one element of the Hessian, with the same stencil as hessian
+         */
+        rT hessian (const pT &p, size_t m, size_t n)
+        {
+            const rT scale = std::pow (std::numeric_limits<rT>::epsilon (), rT (.25));
+            Te hm = step (p, m, scale);
+            npoints = 0;
+            add_point (p, 0, 0, 0, 0);
+            add_point (p, m, hm, m, 0);
+            add_point (p, m, -hm, m, 0);
+            if (m == n)
+                {
+                    eval_points ();
+                    return (values[1] - 2 * values[0] + values[2]) / (hm * hm);
+                }
+            Te hn = step (p, n, scale);
+            add_point (p, n, hn, n, 0);
+            add_point (p, n, -hn, n, 0);
+            add_point (p, m, hm, n, hn);
+            add_point (p, m, -hm, n, -hn);
+            eval_points ();
+            return (values[5] - values[1] - values[3] + 2 * values[0] - values[2] - values[4] + values[6]) /
+                   (2 * hm * hn);
+        }
+
+        /**
+           the trace of the Hessian, with 1+2n evaluations
+         */
+        rT laplacian (const pT &p)
+        {
+            const rT scale = std::pow (std::numeric_limits<rT>::epsilon (), rT (.25));
+            size_t n = get_size (p);
+            npoints = 0;
+            add_point (p, 0, 0, 0, 0);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    Te hi = step (p, i, scale);
+                    add_point (p, i, hi, i, 0);
+                    add_point (p, i, -hi, i, 0);
+                }
+            eval_points ();
+            rT result = 0;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    Te hi = step (p, i, scale);
+                    result += (values[1 + 2 * i] - 2 * values[0] + values[2 + 2 * i]) / (hi * hi);
+                }
+            return result;
+        }
+    };
 }
 
 #endif
@@ -8,6 +8,7 @@
 #ifndef VECTOR_OPERATION_HPP
 #define VECTOR_OPERATION_HPP
 #include <core/opt_traits.hpp>
+#include <type_traits>
 namespace opt_utilities
 {
 
@@ -32,9 +33,13 @@ namespace opt_utilities
         return x1 * x2;
     }
 
+    // the enable_if keeps scalar arguments from instantiating element_type_trait,
+    // so that they fall back to the overload above
     template <typename pT>
-    typename element_type_trait<pT>::element_type
-    contract (const pT &v1, const pT &v2, const typename element_type_trait<pT>::element_type &)
+    typename std::enable_if<!std::is_arithmetic<pT>::value, element_type_trait<pT>>::type::element_type
+    contract (const pT &v1,
+              const pT &v2,
+              const typename std::enable_if<!std::is_arithmetic<pT>::value, element_type_trait<pT>>::type::element_type &)
     {
         typename element_type_trait<pT>::element_type result (0);
         for (int i = 0; i < get_size (v1); ++i)
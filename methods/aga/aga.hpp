@@ -12,11 +12,13 @@
 #include <limits>
 #include <cstdlib>
 #include <core/opt_traits.hpp>
+#include <misc/random.hpp>
 #include <cassert>
 #include <cmath>
-#include <ctime>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 /*
  *
  */
@@ -47,6 +49,12 @@ namespace opt_utilities
        \brief Implement of the asexual genetic algorithm
        2009A&A...501.1259C
        http://adsabs.harvard.edu/abs/2009A%26A...501.1259C
+       The samples of a generation are evaluated as one batch by
+       func_obj::eval_many, i.e., concurrently when the eval_executor of
+       the process has several threads.
+       The random numbers are drawn from counter-based streams keyed on the
+       seed, the generation and the sample, so a run with a fixed seed,
+       see set_seed, gives the same result for any number of threads.
        \tparam rT return type of the object function
        \tparam pT parameter type of the object function
      */
@@ -80,13 +88,38 @@ namespace opt_utilities
         pT reproduction_box;
         std::vector<vp_pair<rT, pT>> samples;
         std::vector<pT> buffer;
+        pT lb;
+        pT ub;
         mutable bool bstop;
 
+        bool user_seeded;
+        unsigned long long seed;
+        unsigned long long generation;
+        std::vector<pT> batch_points;
+        std::vector<rT> batch_values;
+
       private:
         typename element_type_trait<pT>::element_type
-        uni_rand (typename element_type_trait<pT>::element_type x1, typename element_type_trait<pT>::element_type x2)
+        uni_rand (counter_rng &rng, typename element_type_trait<pT>::element_type x1,
+                  typename element_type_trait<pT>::element_type x2)
+        {
+            return rng.uniform (x1, x2);
+        }
+
+        // the stream used for the i-th sample of the current generation
+        counter_rng sample_rng (size_t i) const
+        {
+            return counter_rng (seed, generation * samples.size () + i);
+        }
+
+        // the seed of an unseeded run, from the clock and the number of
+        // the runs so far, so that the runs started within one tick of
+        // the clock, e.g. of the clones, get different streams
+        static unsigned long long fresh_seed ()
         {
-            return rand () / (double)RAND_MAX * (x2 - x1) + x1;
+            static std::atomic<unsigned long long> n_runs (0);
+            counter_rng rng (std::chrono::high_resolution_clock::now ().time_since_epoch ().count (), n_runs++);
+            return rng ();
         }
 
       private:
@@ -101,16 +134,36 @@ namespace opt_utilities
             return p_fo->eval (x);
         }
 
+        // evaluate all the samples as one batch
+        void eval_samples ()
+        {
+            assert (p_fo != 0);
+            batch_points.resize (samples.size ());
+            batch_values.resize (samples.size ());
+            for (size_t i = 0; i < samples.size (); ++i)
+                {
+                    opt_assign (batch_points[i], samples[i].p);
+                }
+            if (!samples.empty ())
+                {
+                    p_fo->eval_many (&batch_points[0], samples.size (), &batch_values[0]);
+                }
+            for (size_t i = 0; i < samples.size (); ++i)
+                {
+                    samples[i].v = batch_values[i];
+                }
+        }
+
       public:
         aga_method (int _n1, int _n2)
         : n1 (_n1), n2 (_n2), n0 (n1 * n2 + n1), p_fo (0), p_optimizer (0), threshold (1e-4),
-          decay_factor (.999), samples (n1 * n2 + n1)
+          decay_factor (.999), samples (n1 * n2 + n1), user_seeded (false), seed (0), generation (0)
         {
         }
 
         aga_method ()
         : n1 (50), n2 (20), n0 (n1 * n2 + n1), p_fo (0), p_optimizer (0), threshold (1e-4),
-          decay_factor (.999), samples (n1 * n2 + n1)
+          decay_factor (.999), samples (n1 * n2 + n1), user_seeded (false), seed (0), generation (0)
         {
         }
 
@@ -119,7 +172,8 @@ namespace opt_utilities
 
         aga_method (const aga_method<rT, pT> &rhs)
         : n1 (rhs.n1), n2 (rhs.n2), n0 (rhs.n0), p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer),
-          threshold (rhs.threshold), decay_factor (rhs.decay_factor), samples (rhs.samples)
+          threshold (rhs.threshold), decay_factor (rhs.decay_factor), samples (rhs.samples),
+          user_seeded (rhs.user_seeded), seed (rhs.seed), generation (rhs.generation)
         {
         }
 
@@ -132,6 +186,10 @@ namespace opt_utilities
             n1 = rhs.n1;
             n2 = rhs.n2;
             n0 = rhs.n0;
+            user_seeded = rhs.user_seeded;
+            seed = rhs.seed;
+            generation = rhs.generation;
+            return *this;
         }
 
         void set_decay_factor (typename element_type_trait<pT>::element_type _decay_factor)
@@ -139,6 +197,19 @@ namespace opt_utilities
             decay_factor = _decay_factor;
         }
 
+        /**
+           Fix the seed of the random numbers, so that the run is reproducible.
+           Without calling this function, every run draws a new seed from
+           the clock.
+           Should be called before setting the start point.
+           \param s the seed
+         */
+        void set_seed (unsigned long long s)
+        {
+            seed = s;
+            user_seeded = true;
+        }
+
 
         opt_method<rT, pT> *do_clone () const
         {
@@ -147,15 +218,21 @@ namespace opt_utilities
 
         void do_set_start_point (const array1d_type &p)
         {
+            if (!user_seeded)
+                {
+                    seed = fresh_seed ();
+                }
+            generation = 0;
             for (size_t i = 0; i < samples.size (); ++i)
                 {
+                    counter_rng rng (sample_rng (i));
                     //  cout<<i<<" ";
                     resize (samples[i].p, get_size (p));
                     //	  std::cout<<samples[i].p.size()<<std::endl;;
                     for (size_t j = 0; j < get_size (p); ++j)
                         {
                             set_element (samples[i].p, j,
-                                         uni_rand (get_element (lower_bound, j), get_element (upper_bound, j)));
+                                         uni_rand (rng, get_element (lower_bound, j), get_element (upper_bound, j)));
                         }
                 }
         }
@@ -204,25 +281,29 @@ namespace opt_utilities
 
         bool iter ()
         {
+            ++generation;
             rT sum2 = 0;
             rT sum = 0;
+            eval_samples ();
             for (size_t i = 0; i < samples.size (); ++i)
                 {
-                    samples[i].v = func (samples[i].p);
                     sum2 += samples[i].v * samples[i].v;
                     sum += samples[i].v;
                 }
 
             std::sort (samples.begin (), samples.end (), vp_comp<rT, pT> ());
+            p_optimizer->get_stats ().add_iteration (samples[0].v, samples[0].p);
             if (sum2 / samples.size () - pow (sum / samples.size (), 2) < threshold)
                 {
                     return false;
                 }
-            pT lb (get_size (samples[0].p));
-            pT ub (get_size (samples[0].p));
+            resize (lb, get_size (samples[0].p));
+            resize (ub, get_size (samples[0].p));
             for (int i = 0; i < n2 && !bstop; ++i)
                 {
-                    pT p (samples[i].p);
+                    counter_rng rng (sample_rng (i));
+                    pT &p = buffer[i];
+                    opt_assign (p, samples[i].p);
                     for (size_t j = 0; j < get_size (p); ++j)
                         {
                             if (i == 0)
@@ -234,7 +315,7 @@ namespace opt_utilities
                             lb[j] = min1 (lb[j], p[j]);
 
                             set_element (p, j,
-                                         get_element (p, j) + uni_rand (-get_element (reproduction_box, j),
+                                         get_element (p, j) + uni_rand (rng, -get_element (reproduction_box, j),
                                                                         get_element (reproduction_box, j)));
                             if (get_element (p, j) > get_element (upper_bound, j))
                                 {
@@ -245,7 +326,6 @@ namespace opt_utilities
                                     set_element (p, j, get_element (lower_bound, j));
                                 }
                         }
-                    buffer[i] = p;
                 }
             if (bstop)
                 {
@@ -255,8 +335,7 @@ namespace opt_utilities
                 {
                     for (int j = 0; j < n2 && !bstop; ++j)
                         {
-                            pT p (samples[i].p);
-                            for (size_t k = 0; k < get_size (p); ++k)
+                            for (size_t k = 0; k < get_size (samples[i].p); ++k)
                                 {
                                     set_element (samples[i * n2 + j + n1].p, k,
                                                  (get_element (samples[i].p, k) + get_element (buffer[j], k)) / 2.);
@@ -284,7 +363,6 @@ namespace opt_utilities
         pT do_optimize ()
         {
             bstop = false;
-            srand (time (0));
             buffer.resize (n2);
             double n_per_dim = pow ((double)n0, 1. / get_size (lower_bound));
             resize (reproduction_box, get_size (lower_bound));
@@ -145,9 +145,11 @@ namespace opt_utilities
             resize (y, get_size (start_point));
             for (;;)
                 {
+                    // the whole gradient at once, so that an analytic gradient
+                    // of a diff_func_obj is used when available
+                    opt_assign (old_grad, gradient (*p_fo, start_point));
                     for (size_t i = 0; i != get_size (p); ++i)
                         {
-                            set_element (old_grad, i, gradient (*p_fo, start_point, i));
                             set_element (s, i, 0);
                             for (size_t j = 0; j != get_size (p); ++j)
                                 {
@@ -156,10 +158,12 @@ namespace opt_utilities
                         }
                     double fret;
                     linmin (start_point, s, fret, *p_fo);
+                    p_optimizer->get_stats ().add_iteration (fret, start_point);
 
+                    opt_assign (y, gradient (*p_fo, start_point));
                     for (size_t i = 0; i != get_size (p); ++i)
                         {
-                            set_element (y, i, gradient (*p_fo, start_point, i) - get_element (old_grad, i));
+                            set_element (y, i, get_element (y, i) - get_element (old_grad, i));
                         }
 
                     rT sy = 0;
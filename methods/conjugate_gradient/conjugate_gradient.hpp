@@ -13,6 +13,7 @@
 #include <cassert>
 #include <cmath>
 #include "../linmin/linmin.hpp"
+#include "../linmin/parallel_linmin.hpp"
 #include <math/num_diff.hpp>
 #include <algorithm>
 #include <iostream>
@@ -47,6 +48,7 @@ namespace opt_utilities
 
       private:
         rT threshold;
+        size_t line_search_width;
         array1d_type g;
         array1d_type h;
         array1d_type xi;
@@ -58,6 +60,18 @@ namespace opt_utilities
             return p_fo->eval (x);
         }
 
+        void line_search (pT &p, pT &xi, rT &fret)
+        {
+            if (line_search_width == 0)
+                {
+                    linmin (p, xi, fret, *p_fo);
+                }
+            else
+                {
+                    parallel_linmin (p, xi, fret, *p_fo, line_search_width);
+                }
+        }
+
 
       private:
         void clear_xi ()
@@ -91,7 +105,8 @@ namespace opt_utilities
             for (its = 1; its <= ITMAX; ++its)
                 {
                     iter = its;
-                    linmin (p, xi, fret, *p_fo);
+                    line_search (p, xi, fret);
+                    p_optimizer->get_stats ().add_iteration (fret, p);
                     // std::cerr<<"######:"<<its<<"\t"<<abs(fret-fp)/(abs(fret)+fabs(fp)+EPS)<<std::endl;
                     if (2.0 * abs (fret - fp) <= ftol * (abs (fret) + fabs (fp) + EPS))
                         {
@@ -123,7 +138,7 @@ namespace opt_utilities
 
 
       public:
-        conjugate_gradient () : threshold (1e-4), g (0), h (0), xi (0)
+        conjugate_gradient () : threshold (1e-4), line_search_width (0), g (0), h (0), xi (0)
         {
         }
 
@@ -135,13 +150,14 @@ namespace opt_utilities
         conjugate_gradient (const conjugate_gradient<rT, pT> &rhs)
         : opt_method<rT, pT> (rhs), p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer),
           start_point (rhs.start_point), end_point (rhs.end_point), threshold (rhs.threshold),
-          g (0), h (0), xi (0)
+          line_search_width (rhs.line_search_width), g (0), h (0), xi (0)
         {
         }
 
         conjugate_gradient<rT, pT> &operator= (const conjugate_gradient<rT, pT> &rhs)
         {
             threshold = rhs.threshold;
+            line_search_width = rhs.line_search_width;
             p_fo = rhs.p_fo;
             p_optimizer = rhs.p_optimizer;
             start_point = rhs.start_point;
@@ -149,6 +165,22 @@ namespace opt_utilities
             threshold = rhs.threshold;
         }
 
+        /**
+           Use parallel_linmin for the line searches, which evaluates
+           width trial steps at once, see eval_executor.
+           \param width the number of trial steps per round, 0 (the default)
+           for the sequential linmin
+         */
+        void set_line_search_width (size_t width)
+        {
+            line_search_width = width;
+        }
+
+        size_t get_line_search_width () const
+        {
+            return line_search_width;
+        }
+
         opt_method<rT, pT> *do_clone () const
         {
             return new conjugate_gradient<rT, pT> (*this);
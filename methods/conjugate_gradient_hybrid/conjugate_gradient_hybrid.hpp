@@ -97,6 +97,7 @@ namespace opt_utilities
 
                     iter = its;
                     linmin (p, xi, fret, *p_fo);
+                    p_optimizer->get_stats ().add_iteration (fret, p);
                     // std::cerr<<"######:"<<its<<"\t"<<abs(fret-fp)/(abs(fret)+fabs(fp)+EPS)<<std::endl;
                     if (!cg_on)
                         {
@@ -163,6 +163,8 @@ namespace opt_utilities
             s = gsl_multimin_fminimizer_alloc (T, get_size (start_point));
             gsl_multimin_fminimizer_set (s, &minex_func, x, ss);
 
+            // the current vertex, filled only when the trace is kept
+            pT current;
             do
                 {
                     iter++;
@@ -172,6 +174,15 @@ namespace opt_utilities
                         {
                             break;
                         }
+                    if (p_optimizer->get_stats ().get_trace_capacity () > 0)
+                        {
+                            resize (current, get_size (start_point));
+                            for (size_t i = 0; i < get_size (start_point); ++i)
+                                {
+                                    set_element (current, i, gsl_vector_get (s->x, i));
+                                }
+                        }
+                    p_optimizer->get_stats ().add_iteration (s->fval, current);
                     // std::cerr<<"threshold="<<threshold<<std::endl;
                     size = gsl_multimin_fminimizer_size (s);
                     status = gsl_multimin_test_size (size, threshold);
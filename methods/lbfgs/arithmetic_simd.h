@@ -0,0 +1,206 @@
+/*
+ * Vector arithmetic of lbfgs with SSE2 or AVX instructions, for
+ * LBFGS_FLOAT == 64. The instruction set is chosen at build time from
+ * the target of the compiler (e.g., -mavx2 or -march=native for AVX,
+ * SSE2 is always present on x86-64); on other targets, or for single
+ * precision, the scalar arithmetic_ansi.h is used.
+ * Unlike the SSE arithmetic of upstream liblbfgs, the vectors need
+ * neither be aligned nor have a length multiple of the vector width,
+ * the remaining elements are processed by scalar loops. The vectors
+ * allocated by vecalloc are aligned to 32 bytes all the same, so that
+ * the loads and stores do not cross cache lines.
+ */
+
+#if LBFGS_FLOAT == 64 && (defined(__AVX__) || defined(__SSE2__))
+
+#include <cstdlib>
+#include <memory>
+#include <cstring>
+#include <immintrin.h>
+
+#define fsigndiff(x, y) (*(x) * (*(y) / fabs(*(y))) < 0.)
+
+#if defined(__AVX__)
+
+typedef __m256d lbfgs_simd_t;
+#define LBFGS_SIMD_WIDTH 4
+
+inline static lbfgs_simd_t simd_load(const double *x) { return _mm256_loadu_pd(x); }
+inline static void simd_store(double *x, lbfgs_simd_t a) { _mm256_storeu_pd(x, a); }
+inline static lbfgs_simd_t simd_set1(double c) { return _mm256_set1_pd(c); }
+inline static lbfgs_simd_t simd_zero() { return _mm256_setzero_pd(); }
+inline static lbfgs_simd_t simd_add(lbfgs_simd_t a, lbfgs_simd_t b) { return _mm256_add_pd(a, b); }
+inline static lbfgs_simd_t simd_sub(lbfgs_simd_t a, lbfgs_simd_t b) { return _mm256_sub_pd(a, b); }
+inline static lbfgs_simd_t simd_mul(lbfgs_simd_t a, lbfgs_simd_t b) { return _mm256_mul_pd(a, b); }
+
+inline static double simd_hsum(lbfgs_simd_t a)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+#else
+
+typedef __m128d lbfgs_simd_t;
+#define LBFGS_SIMD_WIDTH 2
+
+inline static lbfgs_simd_t simd_load(const double *x) { return _mm_loadu_pd(x); }
+inline static void simd_store(double *x, lbfgs_simd_t a) { _mm_storeu_pd(x, a); }
+inline static lbfgs_simd_t simd_set1(double c) { return _mm_set1_pd(c); }
+inline static lbfgs_simd_t simd_zero() { return _mm_setzero_pd(); }
+inline static lbfgs_simd_t simd_add(lbfgs_simd_t a, lbfgs_simd_t b) { return _mm_add_pd(a, b); }
+inline static lbfgs_simd_t simd_sub(lbfgs_simd_t a, lbfgs_simd_t b) { return _mm_sub_pd(a, b); }
+inline static lbfgs_simd_t simd_mul(lbfgs_simd_t a, lbfgs_simd_t b) { return _mm_mul_pd(a, b); }
+
+inline static double simd_hsum(lbfgs_simd_t a)
+{
+    return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+}
+
+#endif
+
+/* the number of leading elements processed by the vector loops */
+#define LBFGS_SIMD_HEAD(n) ((n) - (n) % LBFGS_SIMD_WIDTH)
+
+inline static void* vecalloc(size_t size)
+{
+    void *memblock = _mm_malloc(size == 0 ? 1 : size, 32);
+    if (memblock) {
+        memset(memblock, 0, size);
+    }
+    return memblock;
+}
+
+inline static void vecfree(void *memblock)
+{
+    if (memblock) {
+        _mm_free(memblock);
+    }
+}
+
+inline static void vecset(lbfgsfloatval_t *x, const lbfgsfloatval_t c, const int n)
+{
+    int i;
+    const int m = LBFGS_SIMD_HEAD(n);
+    const lbfgs_simd_t vc = simd_set1(c);
+
+    for (i = 0;i < m;i += LBFGS_SIMD_WIDTH) {
+        simd_store(x + i, vc);
+    }
+    for (;i < n;++i) {
+        x[i] = c;
+    }
+}
+
+inline static void veccpy(lbfgsfloatval_t *y, const lbfgsfloatval_t *x, const int n)
+{
+    memcpy(y, x, sizeof(lbfgsfloatval_t) * n);
+}
+
+inline static void vecncpy(lbfgsfloatval_t *y, const lbfgsfloatval_t *x, const int n)
+{
+    int i;
+    const int m = LBFGS_SIMD_HEAD(n);
+    const lbfgs_simd_t zero = simd_zero();
+
+    for (i = 0;i < m;i += LBFGS_SIMD_WIDTH) {
+        simd_store(y + i, simd_sub(zero, simd_load(x + i)));
+    }
+    for (;i < n;++i) {
+        y[i] = -x[i];
+    }
+}
+
+inline static void vecadd(lbfgsfloatval_t *y, const lbfgsfloatval_t *x, const lbfgsfloatval_t c, const int n)
+{
+    int i;
+    const int m = LBFGS_SIMD_HEAD(n);
+    const lbfgs_simd_t vc = simd_set1(c);
+
+    for (i = 0;i < m;i += LBFGS_SIMD_WIDTH) {
+        simd_store(y + i, simd_add(simd_load(y + i), simd_mul(vc, simd_load(x + i))));
+    }
+    for (;i < n;++i) {
+        y[i] += c * x[i];
+    }
+}
+
+inline static void vecdiff(lbfgsfloatval_t *z, const lbfgsfloatval_t *x, const lbfgsfloatval_t *y, const int n)
+{
+    int i;
+    const int m = LBFGS_SIMD_HEAD(n);
+
+    for (i = 0;i < m;i += LBFGS_SIMD_WIDTH) {
+        simd_store(z + i, simd_sub(simd_load(x + i), simd_load(y + i)));
+    }
+    for (;i < n;++i) {
+        z[i] = x[i] - y[i];
+    }
+}
+
+inline static void vecscale(lbfgsfloatval_t *y, const lbfgsfloatval_t c, const int n)
+{
+    int i;
+    const int m = LBFGS_SIMD_HEAD(n);
+    const lbfgs_simd_t vc = simd_set1(c);
+
+    for (i = 0;i < m;i += LBFGS_SIMD_WIDTH) {
+        simd_store(y + i, simd_mul(vc, simd_load(y + i)));
+    }
+    for (;i < n;++i) {
+        y[i] *= c;
+    }
+}
+
+inline static void vecmul(lbfgsfloatval_t *y, const lbfgsfloatval_t *x, const int n)
+{
+    int i;
+    const int m = LBFGS_SIMD_HEAD(n);
+
+    for (i = 0;i < m;i += LBFGS_SIMD_WIDTH) {
+        simd_store(y + i, simd_mul(simd_load(y + i), simd_load(x + i)));
+    }
+    for (;i < n;++i) {
+        y[i] *= x[i];
+    }
+}
+
+inline static void vecdot(lbfgsfloatval_t* s, const lbfgsfloatval_t *x, const lbfgsfloatval_t *y, const int n)
+{
+    int i;
+    const int m2 = n - n % (2 * LBFGS_SIMD_WIDTH);
+    /* two accumulators, to hide the latency of the additions */
+    lbfgs_simd_t s0 = simd_zero();
+    lbfgs_simd_t s1 = simd_zero();
+    double r;
+
+    for (i = 0;i < m2;i += 2 * LBFGS_SIMD_WIDTH) {
+        s0 = simd_add(s0, simd_mul(simd_load(x + i), simd_load(y + i)));
+        s1 = simd_add(s1, simd_mul(simd_load(x + i + LBFGS_SIMD_WIDTH), simd_load(y + i + LBFGS_SIMD_WIDTH)));
+    }
+    r = simd_hsum(simd_add(s0, s1));
+    for (;i < n;++i) {
+        r += x[i] * y[i];
+    }
+    *s = r;
+}
+
+inline static void vec2norm(lbfgsfloatval_t* s, const lbfgsfloatval_t *x, const int n)
+{
+    vecdot(s, x, x, n);
+    *s = (lbfgsfloatval_t)sqrt(*s);
+}
+
+inline static void vec2norminv(lbfgsfloatval_t* s, const lbfgsfloatval_t *x, const int n)
+{
+    vec2norm(s, x, n);
+    *s = (lbfgsfloatval_t)(1.0 / *s);
+}
+
+#undef LBFGS_SIMD_HEAD
+
+#else
+
+#include "arithmetic_ansi.h"
+
+#endif
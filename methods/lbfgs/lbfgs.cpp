@@ -1,7 +1,12 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+/* define LBFGS_NO_SIMD to use the scalar arithmetic */
+#ifdef LBFGS_NO_SIMD
 #include "arithmetic_ansi.h"
+#else
+#include "arithmetic_simd.h"
+#endif
 
 
 //#define min2(a, b)      ((a) <= (b) ? (a) : (b))
@@ -30,28 +30,104 @@ using std::endl;
 
 namespace opt_utilities
 {
+    /**
+       \brief the state shared by lbfgs_adapter and lbfgs_progress during one
+       optimization, the buffers are allocated once and reused by every call
+     */
+    template <typename rT, typename pT> struct lbfgs_instance
+    {
+        func_obj<rT, pT> *p_fo;
+        // non-null if the value and the gradient can be obtained together
+        diff_func_obj<rT, pT> *p_dfo;
+        pT px;
+        pT grad;
+        central_gradient_workspace<rT, pT> workspace;
+        const volatile bool *p_stop;
+        lbfgs_progress_t user_progress;
+        void *user_instance;
+
+        void set_x (const lbfgsfloatval_t *x, int n)
+        {
+            for (int i = 0; i < n; ++i)
+                {
+                    set_element (px, i, x[i]);
+                }
+        }
+    };
 
     template <typename rT, typename pT>
     lbfgsfloatval_t
     lbfgs_adapter (void *instance, const lbfgsfloatval_t *x, lbfgsfloatval_t *g, const int n, const lbfgsfloatval_t step)
     {
-        pT px;
-        resize (px, n);
-        for (int i = 0; i < n; ++i)
+        lbfgs_instance<rT, pT> &inst = *static_cast<lbfgs_instance<rT, pT> *> (instance);
+        inst.set_x (x, n);
+        lbfgsfloatval_t result;
+        if (inst.p_dfo != NULL_PTR)
             {
-                set_element (px, i, x[i]);
+                result = inst.p_dfo->eval_with_gradient (inst.px, inst.grad);
+            }
+        else
+            {
+                result = inst.p_fo->eval (inst.px);
+                if (inst.p_fo->get_stats () != NULL_PTR)
+                    {
+                        inst.p_fo->get_stats ()->count_gradient ();
+                    }
+                central_gradient (*inst.p_fo, inst.px, inst.grad, inst.workspace);
             }
-
-        lbfgsfloatval_t result = ((func_obj<rT, pT> *)instance)->eval (px);
-        pT grad (gradient (*static_cast<func_obj<rT, pT> *> (instance), px));
         for (int i = 0; i < n; ++i)
             {
-                g[i] = get_element (grad, i);
+                g[i] = get_element (inst.grad, i);
             }
         return result;
     }
 
 
+    template <typename rT, typename pT>
+    int lbfgs_progress (void *instance,
+                        const lbfgsfloatval_t *x,
+                        const lbfgsfloatval_t *g,
+                        const lbfgsfloatval_t fx,
+                        const lbfgsfloatval_t xnorm,
+                        const lbfgsfloatval_t gnorm,
+                        const lbfgsfloatval_t step,
+                        int n,
+                        int k,
+                        int ls)
+    {
+        lbfgs_instance<rT, pT> &inst = *static_cast<lbfgs_instance<rT, pT> *> (instance);
+        optimizer_stats<rT, pT> *ps = inst.p_fo->get_stats ();
+        if (ps != NULL_PTR)
+            {
+                if (ps->get_trace_capacity () > 0)
+                    {
+                        inst.set_x (x, n);
+                    }
+                // every iteration of lbfgs performs one line search
+                ps->count_line_search ();
+                ps->add_iteration (fx, inst.px);
+            }
+        if (*inst.p_stop)
+            {
+                return LBFGSERR_CANCELED;
+            }
+        if (inst.user_progress != NULL_PTR)
+            {
+                return inst.user_progress (inst.user_instance, x, g, fx, xnorm, gnorm, step, n, k, ls);
+            }
+        return 0;
+    }
+
+
+    /**
+       \brief the limited memory BFGS method of libLBFGS, with the
+       OWL-QN method for objectives with an L1 penalty.
+       If the object function is a diff_func_obj, its value and gradient
+       are obtained together by diff_func_obj::eval_with_gradient,
+       otherwise the gradient is computed by central differences.
+       The precision sets lbfgs_parameter_t::ftol, all the other
+       parameters can be set by set_parameter or by the individual setters.
+     */
     template <typename rT, typename pT> class lbfgs_method : public opt_method<rT, pT>
     {
       public:
@@ -70,7 +146,11 @@ namespace opt_utilities
         array1d_type end_point;
 
       private:
-        rT threshold;
+        lbfgs_parameter_t param;
+        lbfgs_progress_t user_progress;
+        void *user_instance;
+        int status;
+        volatile bool bstop;
 
       private:
         rT func (const pT &x)
@@ -85,25 +165,31 @@ namespace opt_utilities
         }
 
       public:
-        lbfgs_method () : threshold (1e-4)
+        lbfgs_method () : user_progress (NULL_PTR), user_instance (NULL_PTR), status (0), bstop (false)
         {
+            lbfgs_parameter_init (&param);
         }
 
         virtual ~lbfgs_method (){};
 
         lbfgs_method (const lbfgs_method<rT, pT> &rhs)
         : p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer), start_point (rhs.start_point),
-          end_point (rhs.end_point), threshold (rhs.threshold)
+          end_point (rhs.end_point), param (rhs.param), user_progress (rhs.user_progress),
+          user_instance (rhs.user_instance), status (rhs.status), bstop (false)
         {
         }
 
         lbfgs_method<rT, pT> &operator= (const lbfgs_method<rT, pT> &rhs)
         {
-            threshold = rhs.threshold;
+            param = rhs.param;
+            user_progress = rhs.user_progress;
+            user_instance = rhs.user_instance;
+            status = rhs.status;
             p_fo = rhs.p_fo;
             p_optimizer = rhs.p_optimizer;
             opt_assign (start_point, rhs.start_point);
             opt_assign (end_point, rhs.end_point);
+            return *this;
         }
 
         opt_method<rT, pT> *do_clone () const
@@ -124,12 +210,12 @@ namespace opt_utilities
 
         void do_set_precision (rT t)
         {
-            threshold = t;
+            param.ftol = t;
         }
 
         rT do_get_precision () const
         {
-            return threshold;
+            return param.ftol;
         }
 
         void do_set_optimizer (optimizer<rT, pT> &o)
@@ -138,23 +224,135 @@ namespace opt_utilities
             p_fo = p_optimizer->ptr_func_obj ();
         }
 
+        void do_stop ()
+        {
+            bstop = true;
+        }
+
+        /**
+           set all the parameters of libLBFGS at once
+           \param p the parameters, see lbfgs.h
+         */
+        void set_parameter (const lbfgs_parameter_t &p)
+        {
+            param = p;
+        }
+
+        const lbfgs_parameter_t &get_parameter () const
+        {
+            return param;
+        }
+
+        /**
+           \param m the number of corrections kept to approximate the inverse hessian, 6 by default
+         */
+        void set_num_corrections (int m)
+        {
+            param.m = m;
+        }
+
+        /**
+           \param e the convergence criterion ||g||<e*max(1,||x||), 1e-5 by default
+         */
+        void set_epsilon (rT e)
+        {
+            param.epsilon = e;
+        }
+
+        /**
+           stop when the relative decrease of the value over the last
+           past iterations is below delta
+           \param past the number of iterations, 0 (the default) to disable the test
+           \param delta the minimum relative decrease
+         */
+        void set_delta_test (int past, rT delta)
+        {
+            param.past = past;
+            param.delta = delta;
+        }
+
+        /**
+           \param n the maximum number of iterations, 0 (the default) for no limit
+         */
+        void set_max_iter (int n)
+        {
+            param.max_iterations = n;
+        }
+
+        /**
+           \param ls the line search algorithm, one of the LBFGS_LINESEARCH_ constants
+         */
+        void set_linesearch (int ls)
+        {
+            param.linesearch = ls;
+        }
+
+        /**
+           Minimize f(x)+c*sum_{start<=i<end}|x_i| by the OWL-QN method.
+           It requires a backtracking line search, which is used instead
+           of the default More-Thuente one.
+           \param c the coefficient, 0 to disable the penalty
+           \param start the first penalized parameter
+           \param end one past the last penalized parameter, -1 for all
+         */
+        void set_l1_penalty (rT c, int start = 0, int end = -1)
+        {
+            param.orthantwise_c = c;
+            param.orthantwise_start = start;
+            param.orthantwise_end = end;
+        }
+
+        /**
+           call f after every iteration, in addition to updating the
+           statistics of the optimizer; the optimization is canceled if it
+           returns non-zero
+           \param f the callback, NULL_PTR to remove it
+           \param instance passed to f as its first argument
+         */
+        void set_progress (lbfgs_progress_t f, void *instance)
+        {
+            user_progress = f;
+            user_instance = instance;
+        }
+
+        /**
+           \return the status returned by lbfgs in the last optimization, see lbfgs.h
+         */
+        int get_status () const
+        {
+            return status;
+        }
 
         pT do_optimize ()
         {
-            lbfgs_parameter_t param;
-            lbfgs_parameter_init (&param);
-            param.ftol = threshold;
-            std::vector<lbfgsfloatval_t> buffer (get_size (start_point));
-            for (int i = 0; i < buffer.size (); ++i)
+            bstop = false;
+            lbfgs_parameter_t p (param);
+            if (p.orthantwise_c != 0 && p.linesearch == LBFGS_LINESEARCH_MORETHUENTE)
+                {
+                    p.linesearch = LBFGS_LINESEARCH_BACKTRACKING;
+                }
+            int n = get_size (start_point);
+            lbfgsfloatval_t *buffer = lbfgs_malloc (n);
+            for (int i = 0; i < n; ++i)
                 {
                     buffer[i] = get_element (start_point, i);
                 }
+            lbfgs_instance<rT, pT> inst;
+            inst.p_fo = p_fo;
+            inst.p_dfo = dynamic_cast<diff_func_obj<rT, pT> *> (p_fo);
+            resize (inst.px, n);
+            opt_assign (inst.px, start_point);
+            resize (inst.grad, n);
+            inst.p_stop = &bstop;
+            inst.user_progress = user_progress;
+            inst.user_instance = user_instance;
             lbfgsfloatval_t fx;
-            lbfgs (get_size (start_point), &buffer[0], &fx, lbfgs_adapter<rT, pT>, 0, p_fo, &param);
-            for (int i = 0; i < buffer.size (); ++i)
+            status = lbfgs (n, buffer, &fx, lbfgs_adapter<rT, pT>, lbfgs_progress<rT, pT>, &inst, &p);
+            for (int i = 0; i < n; ++i)
                 {
                     set_element (start_point, i, buffer[i]);
                 }
+            lbfgs_free (buffer);
             return start_point;
         }
     };
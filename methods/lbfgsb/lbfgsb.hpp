@@ -0,0 +1,868 @@
+/**
+   \file lbfgsb.hpp
+   \brief limited memory BFGS method with bound constraints
+   \author Junhua Gu
+ */
+
+#ifndef LBFGSB_METHOD
+#define LBFGSB_METHOD
+#define OPT_HEADER
+#include <core/optimizer.hpp>
+#include <core/opt_traits.hpp>
+#include <math/num_diff.hpp>
+#include <vector>
+#include <limits>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace opt_utilities
+{
+    /**
+       \brief The L-BFGS-B method of Byrd, Lu, Nocedal & Zhu (1995, SIAM
+       J. Sci. Comput. 16, 1190), minimizing within the box between the
+       lower and the upper limits, which the fitter takes from the
+       param_info of the free parameters.
+       Every iteration finds the generalized Cauchy point along the
+       projected steepest descent path on the compact representation of
+       the limited memory BFGS matrix, minimizes the quadratic model over
+       the parameters that are not at their limits, projects the result
+       onto the box (as in L-BFGS-B 3.0), and performs a backtracking line
+       search towards it. When the line search fails, the correction pairs
+       are dropped and the iteration is retried once along the projected
+       steepest descent. The object function is never evaluated outside
+       the box, so the statistics need not penalize the parameters beyond
+       the limits (do not call chisq::consider_limit, which also rejects
+       the parameters on the limits).
+       If the object function is a diff_func_obj, its value and gradient
+       are obtained by diff_func_obj::eval_with_gradient, otherwise the
+       gradient is computed by central differences, shrunk to one side on
+       the limits.
+       The optimization stops when the largest element of the projected
+       gradient is below the gradient tolerance (see set_pgtol), or when
+       an iteration decreases the value relatively less than the precision.
+       All the work arrays are allocated when the optimization starts.
+       \tparam rT return type of the object function
+       \tparam pT parameter type of the object function
+     */
+    template <typename rT, typename pT> class lbfgsb_method : public opt_method<rT, pT>
+    {
+      public:
+        typedef pT array1d_type;
+        typedef typename element_type_trait<pT>::element_type element_type;
+
+      private:
+        typedef element_type Te;
+
+        func_obj<rT, pT> *p_fo;
+        optimizer<rT, pT> *p_optimizer;
+        volatile bool bstop;
+
+        pT start_point;
+        pT end_point;
+        pT lower_limit;
+        pT upper_limit;
+        rT threshold;
+        rT pgtol;
+        size_t m;
+        size_t max_iter;
+
+        // the state of one optimization
+        diff_func_obj<rT, pT> *p_dfo;
+        size_t n;
+        // the number of stored correction pairs, and the slot of the oldest
+        size_t k;
+        size_t head;
+        Te theta;
+        pT px;
+        pT pgrad;
+        std::vector<pT> grad_points;
+        std::vector<rT> grad_values;
+        std::vector<Te> x, g, lo, hi, xc, xbar, xnew, gnew, dir, t;
+        std::vector<size_t> order;
+        std::vector<size_t> free_vars;
+        // s_i and y_i of the slot i, n elements each
+        std::vector<Te> S, Y;
+        // s_i^T y_j and s_i^T s_j, for i and j in the order of age
+        std::vector<Te> SY, SS;
+        // the middle matrix M of B=theta*I-W*M*W^T, W=[Y theta*S], 2k x 2k
+        std::vector<Te> M;
+        std::vector<Te> wb, Mwb, pv, cv, Mcv, vv, A, N;
+
+      private:
+        const char *do_get_type_name () const
+        {
+            return "L-BFGS-B";
+        }
+
+        struct breakpoint_less
+        {
+            const std::vector<Te> &t;
+
+            breakpoint_less (const std::vector<Te> &_t) : t (_t)
+            {
+            }
+
+            bool operator() (size_t a, size_t b) const
+            {
+                return t[a] < t[b] || (t[a] == t[b] && a < b);
+            }
+        };
+
+        Te &s_at (size_t j, size_t i)
+        {
+            return S[((head + j) % m) * n + i];
+        }
+
+        Te &y_at (size_t j, size_t i)
+        {
+            return Y[((head + j) % m) * n + i];
+        }
+
+        // the row i of W, 2k elements
+        void w_row (size_t i, Te *w)
+        {
+            for (size_t j = 0; j < k; ++j)
+                {
+                    w[j] = y_at (j, i);
+                    w[k + j] = theta * s_at (j, i);
+                }
+        }
+
+        // out=M*v
+        void mul_M (const Te *v, Te *out) const
+        {
+            const size_t k2 = 2 * k;
+            for (size_t a = 0; a < k2; ++a)
+                {
+                    Te s = 0;
+                    for (size_t b = 0; b < k2; ++b)
+                        {
+                            s += M[a * k2 + b] * v[b];
+                        }
+                    out[a] = s;
+                }
+        }
+
+        static Te dot (const Te *a, const Te *b, size_t len)
+        {
+            Te s = 0;
+            for (size_t i = 0; i < len; ++i)
+                {
+                    s += a[i] * b[i];
+                }
+            return s;
+        }
+
+        // solve a*x=b by Gauss-Jordan elimination with partial pivoting,
+        // a is len x len and destroyed, b (len x nrhs) is overwritten by x,
+        // false if a is singular
+        static bool solve (Te *a, Te *b, size_t len, size_t nrhs)
+        {
+            for (size_t col = 0; col < len; ++col)
+                {
+                    size_t piv = col;
+                    for (size_t r = col + 1; r < len; ++r)
+                        {
+                            if (std::abs (a[r * len + col]) > std::abs (a[piv * len + col]))
+                                {
+                                    piv = r;
+                                }
+                        }
+                    if (a[piv * len + col] == 0)
+                        {
+                            return false;
+                        }
+                    if (piv != col)
+                        {
+                            for (size_t c = 0; c < len; ++c)
+                                {
+                                    std::swap (a[piv * len + c], a[col * len + c]);
+                                }
+                            for (size_t c = 0; c < nrhs; ++c)
+                                {
+                                    std::swap (b[piv * nrhs + c], b[col * nrhs + c]);
+                                }
+                        }
+                    for (size_t r = 0; r < len; ++r)
+                        {
+                            if (r == col)
+                                {
+                                    continue;
+                                }
+                            Te f = a[r * len + col] / a[col * len + col];
+                            if (f == 0)
+                                {
+                                    continue;
+                                }
+                            for (size_t c = col; c < len; ++c)
+                                {
+                                    a[r * len + c] -= f * a[col * len + c];
+                                }
+                            for (size_t c = 0; c < nrhs; ++c)
+                                {
+                                    b[r * nrhs + c] -= f * b[col * nrhs + c];
+                                }
+                        }
+                }
+            for (size_t r = 0; r < len; ++r)
+                {
+                    for (size_t c = 0; c < nrhs; ++c)
+                        {
+                            b[r * nrhs + c] /= a[r * len + r];
+                        }
+                }
+            return true;
+        }
+
+        // M=[[-D, L^T],[L, theta*S^T S]]^-1, false if singular
+        bool form_M ()
+        {
+            const size_t k2 = 2 * k;
+            for (size_t a = 0; a < k2 * k2; ++a)
+                {
+                    N[a] = 0;
+                    M[a] = 0;
+                }
+            for (size_t i = 0; i < k; ++i)
+                {
+                    N[i * k2 + i] = -SY[i * m + i];
+                    for (size_t j = 0; j < i; ++j)
+                        {
+                            // L_ij=s_i^T y_j for i>j
+                            N[(k + i) * k2 + j] = SY[i * m + j];
+                            N[j * k2 + k + i] = SY[i * m + j];
+                        }
+                    for (size_t j = 0; j < k; ++j)
+                        {
+                            N[(k + i) * k2 + k + j] = theta * SS[i * m + j];
+                        }
+                }
+            for (size_t a = 0; a < k2; ++a)
+                {
+                    M[a * k2 + a] = 1;
+                }
+            return solve (&N[0], &M[0], k2, k2);
+        }
+
+        void add_pair (const Te *s, const Te *y)
+        {
+            if (k == m)
+                {
+                    // drop the oldest pair
+                    for (size_t i = 1; i < m; ++i)
+                        {
+                            for (size_t j = 1; j < m; ++j)
+                                {
+                                    SY[(i - 1) * m + j - 1] = SY[i * m + j];
+                                    SS[(i - 1) * m + j - 1] = SS[i * m + j];
+                                }
+                        }
+                    head = (head + 1) % m;
+                    --k;
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    s_at (k, i) = s[i];
+                    y_at (k, i) = y[i];
+                }
+            ++k;
+            for (size_t j = 0; j < k; ++j)
+                {
+                    Te sy1 = 0, sy2 = 0, ss = 0;
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            sy1 += s_at (k - 1, i) * y_at (j, i);
+                            sy2 += s_at (j, i) * y_at (k - 1, i);
+                            ss += s_at (k - 1, i) * s_at (j, i);
+                        }
+                    SY[(k - 1) * m + j] = sy1;
+                    SY[j * m + k - 1] = sy2;
+                    SS[(k - 1) * m + j] = ss;
+                    SS[j * m + k - 1] = ss;
+                }
+        }
+
+        Te clamp (size_t i, Te v) const
+        {
+            return std::min (std::max (v, lo[i]), hi[i]);
+        }
+
+        // the largest element of the projected gradient
+        Te projected_gradient_norm () const
+        {
+            Te result = 0;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    result = std::max (result, std::abs (clamp (i, x[i] - g[i]) - x[i]));
+                }
+            return result;
+        }
+
+        rT eval_value (const std::vector<Te> &xv)
+        {
+            for (size_t i = 0; i < n; ++i)
+                {
+                    set_element (px, i, xv[i]);
+                }
+            return p_fo->eval (px);
+        }
+
+        // the gradient at px by central differences inside the box
+        void numeric_gradient (std::vector<Te> &gv)
+        {
+            if (p_fo->get_stats () != NULL_PTR)
+                {
+                    p_fo->get_stats ()->count_gradient ();
+                }
+            const size_t block = grad_points.size () / 2;
+            const Te ep = std::sqrt (std::numeric_limits<Te>::epsilon ());
+            for (size_t i0 = 0; i0 < n; i0 += block)
+                {
+                    size_t nb = std::min (block, n - i0);
+                    for (size_t b = 0; b < nb; ++b)
+                        {
+                            size_t i = i0 + b;
+                            Te xi = get_element (px, i);
+                            Te h = std::max (std::abs (xi), Te (1)) * ep;
+                            opt_assign (grad_points[2 * b], px);
+                            opt_assign (grad_points[2 * b + 1], px);
+                            set_element (grad_points[2 * b], i, std::min (xi + h, hi[i]));
+                            set_element (grad_points[2 * b + 1], i, std::max (xi - h, lo[i]));
+                        }
+                    p_fo->eval_many (&grad_points[0], 2 * nb, &grad_values[0]);
+                    for (size_t b = 0; b < nb; ++b)
+                        {
+                            size_t i = i0 + b;
+                            Te dx = get_element (grad_points[2 * b], i) - get_element (grad_points[2 * b + 1], i);
+                            gv[i] = dx > 0 ? (grad_values[2 * b] - grad_values[2 * b + 1]) / dx : Te (0);
+                        }
+                }
+        }
+
+        rT eval_value_gradient (const std::vector<Te> &xv, std::vector<Te> &gv)
+        {
+            for (size_t i = 0; i < n; ++i)
+                {
+                    set_element (px, i, xv[i]);
+                }
+            if (p_dfo != NULL_PTR)
+                {
+                    rT result = p_dfo->eval_with_gradient (px, pgrad);
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            gv[i] = get_element (pgrad, i);
+                        }
+                    return result;
+                }
+            rT result = p_fo->eval (px);
+            numeric_gradient (gv);
+            return result;
+        }
+
+        // the generalized Cauchy point xc, and c=W^T(xc-x) in cv
+        void cauchy_point ()
+        {
+            const size_t k2 = 2 * k;
+            const Te inf = std::numeric_limits<Te>::infinity ();
+            order.clear ();
+            for (size_t i = 0; i < n; ++i)
+                {
+                    if (g[i] < 0)
+                        {
+                            t[i] = (x[i] - hi[i]) / g[i];
+                        }
+                    else if (g[i] > 0)
+                        {
+                            t[i] = (x[i] - lo[i]) / g[i];
+                        }
+                    else
+                        {
+                            t[i] = inf;
+                        }
+                    dir[i] = t[i] == 0 ? Te (0) : -g[i];
+                    if (t[i] > 0 && t[i] < inf)
+                        {
+                            order.push_back (i);
+                        }
+                    xc[i] = x[i];
+                }
+            std::sort (order.begin (), order.end (), breakpoint_less (t));
+            for (size_t a = 0; a < k2; ++a)
+                {
+                    pv[a] = 0;
+                    cv[a] = 0;
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    if (dir[i] != 0)
+                        {
+                            w_row (i, &wb[0]);
+                            for (size_t a = 0; a < k2; ++a)
+                                {
+                                    pv[a] += wb[a] * dir[i];
+                                }
+                        }
+                }
+            Te fp = -dot (&dir[0], &dir[0], n);
+            mul_M (&pv[0], &Mwb[0]);
+            Te fpp = -theta * fp - dot (&pv[0], &Mwb[0], k2);
+            const Te fpp0 = fpp;
+            Te dtmin = fpp > 0 ? -fp / fpp : inf;
+            Te told = 0;
+            for (size_t ib = 0; ib < order.size (); ++ib)
+                {
+                    size_t b = order[ib];
+                    Te dt = t[b] - told;
+                    if (dtmin < dt)
+                        {
+                            break;
+                        }
+                    xc[b] = dir[b] > 0 ? hi[b] : lo[b];
+                    Te zb = xc[b] - x[b];
+                    Te gb = g[b];
+                    for (size_t a = 0; a < k2; ++a)
+                        {
+                            cv[a] += dt * pv[a];
+                        }
+                    w_row (b, &wb[0]);
+                    mul_M (&wb[0], &Mwb[0]);
+                    fp += dt * fpp + gb * gb + theta * gb * zb - gb * dot (&Mwb[0], &cv[0], k2);
+                    fpp -= theta * gb * gb + 2 * gb * dot (&Mwb[0], &pv[0], k2) + gb * gb * dot (&Mwb[0], &wb[0], k2);
+                    fpp = std::max (fpp, std::numeric_limits<Te>::epsilon () * fpp0);
+                    for (size_t a = 0; a < k2; ++a)
+                        {
+                            pv[a] += gb * wb[a];
+                        }
+                    dir[b] = 0;
+                    dtmin = -fp / fpp;
+                    told = t[b];
+                }
+            dtmin = std::max (dtmin, Te (0));
+            if (dtmin == inf)
+                {
+                    // no curvature along an unbounded direction
+                    dtmin = 0;
+                }
+            told += dtmin;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    if (dir[i] != 0)
+                        {
+                            xc[i] = clamp (i, x[i] + told * dir[i]);
+                        }
+                }
+            for (size_t a = 0; a < k2; ++a)
+                {
+                    cv[a] += dtmin * pv[a];
+                }
+        }
+
+        // minimize the model over the free variables at xc, into xbar
+        void subspace_min ()
+        {
+            const size_t k2 = 2 * k;
+            free_vars.clear ();
+            for (size_t i = 0; i < n; ++i)
+                {
+                    xbar[i] = xc[i];
+                    if (xc[i] > lo[i] && xc[i] < hi[i])
+                        {
+                            free_vars.push_back (i);
+                        }
+                }
+            if (free_vars.empty ())
+                {
+                    return;
+                }
+            // the reduced gradient r=Z^T(g+theta*(xc-x)-W*M*c), kept in dir
+            mul_M (&cv[0], &Mcv[0]);
+            for (size_t f = 0; f < free_vars.size (); ++f)
+                {
+                    size_t i = free_vars[f];
+                    w_row (i, &wb[0]);
+                    dir[i] = g[i] + theta * (xc[i] - x[i]) - dot (&wb[0], &Mcv[0], k2);
+                }
+            bool direct = k > 0;
+            if (direct)
+                {
+                    // d=-r/theta-Z^T W (I-M W^T Z Z^T W/theta)^-1 M W^T Z r/theta^2
+                    for (size_t a = 0; a < k2; ++a)
+                        {
+                            vv[a] = 0;
+                        }
+                    for (size_t a = 0; a < k2 * k2; ++a)
+                        {
+                            A[a] = 0;
+                        }
+                    for (size_t f = 0; f < free_vars.size (); ++f)
+                        {
+                            size_t i = free_vars[f];
+                            w_row (i, &wb[0]);
+                            for (size_t a = 0; a < k2; ++a)
+                                {
+                                    vv[a] += wb[a] * dir[i];
+                                    for (size_t b = 0; b < k2; ++b)
+                                        {
+                                            A[a * k2 + b] += wb[a] * wb[b];
+                                        }
+                                }
+                        }
+                    mul_M (&vv[0], &Mcv[0]);
+                    for (size_t a = 0; a < k2; ++a)
+                        {
+                            vv[a] = Mcv[a];
+                            for (size_t b = 0; b < k2; ++b)
+                                {
+                                    Te s = 0;
+                                    for (size_t c = 0; c < k2; ++c)
+                                        {
+                                            s += M[a * k2 + c] * A[c * k2 + b];
+                                        }
+                                    N[a * k2 + b] = (a == b ? Te (1) : Te (0)) - s / theta;
+                                }
+                        }
+                    direct = solve (&N[0], &vv[0], k2, 1);
+                }
+            for (size_t f = 0; f < free_vars.size (); ++f)
+                {
+                    size_t i = free_vars[f];
+                    Te d = -dir[i] / theta;
+                    if (direct)
+                        {
+                            w_row (i, &wb[0]);
+                            d -= dot (&wb[0], &vv[0], k2) / (theta * theta);
+                        }
+                    dir[i] = d;
+                }
+            Te gd = 0;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    if (xc[i] > lo[i] && xc[i] < hi[i])
+                        {
+                            xbar[i] = clamp (i, xc[i] + dir[i]);
+                        }
+                    gd += g[i] * (xbar[i] - x[i]);
+                }
+            if (gd < 0)
+                {
+                    return;
+                }
+            // the projection spoiled the descent, truncate the step instead
+            Te alpha = 1;
+            for (size_t f = 0; f < free_vars.size (); ++f)
+                {
+                    size_t i = free_vars[f];
+                    if (dir[i] > 0)
+                        {
+                            alpha = std::min (alpha, (hi[i] - xc[i]) / dir[i]);
+                        }
+                    else if (dir[i] < 0)
+                        {
+                            alpha = std::min (alpha, (lo[i] - xc[i]) / dir[i]);
+                        }
+                }
+            gd = 0;
+            for (size_t i = 0; i < n; ++i)
+                {
+                    xbar[i] = xc[i];
+                    if (xc[i] > lo[i] && xc[i] < hi[i])
+                        {
+                            xbar[i] = clamp (i, xc[i] + alpha * dir[i]);
+                        }
+                    gd += g[i] * (xbar[i] - x[i]);
+                }
+            if (gd >= 0)
+                {
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            xbar[i] = xc[i];
+                        }
+                }
+        }
+
+      public:
+        lbfgsb_method ()
+        : p_fo (NULL_PTR), p_optimizer (NULL_PTR), bstop (false), threshold (1e-10), pgtol (1e-5), m (6), max_iter (0)
+        {
+        }
+
+        virtual ~lbfgsb_method ()
+        {
+        }
+
+        lbfgsb_method (const lbfgsb_method<rT, pT> &rhs)
+        : opt_method<rT, pT> (rhs), p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer), bstop (false),
+          start_point (rhs.start_point), end_point (rhs.end_point), lower_limit (rhs.lower_limit),
+          upper_limit (rhs.upper_limit), threshold (rhs.threshold), pgtol (rhs.pgtol), m (rhs.m),
+          max_iter (rhs.max_iter)
+        {
+        }
+
+        lbfgsb_method<rT, pT> &operator= (const lbfgsb_method<rT, pT> &rhs)
+        {
+            p_fo = rhs.p_fo;
+            p_optimizer = rhs.p_optimizer;
+            opt_assign (start_point, rhs.start_point);
+            opt_assign (end_point, rhs.end_point);
+            opt_assign (lower_limit, rhs.lower_limit);
+            opt_assign (upper_limit, rhs.upper_limit);
+            threshold = rhs.threshold;
+            pgtol = rhs.pgtol;
+            m = rhs.m;
+            max_iter = rhs.max_iter;
+            return *this;
+        }
+
+        opt_method<rT, pT> *do_clone () const
+        {
+            return new lbfgsb_method<rT, pT> (*this);
+        }
+
+        /**
+           \param n the number of correction pairs kept, 6 by default
+         */
+        void set_num_corrections (size_t n)
+        {
+            m = std::max (n, size_t (1));
+        }
+
+        size_t get_num_corrections () const
+        {
+            return m;
+        }
+
+        /**
+           \param t stop when no element of the projected gradient exceeds t, 1e-5 by default
+         */
+        void set_pgtol (rT t)
+        {
+            pgtol = t;
+        }
+
+        rT get_pgtol () const
+        {
+            return pgtol;
+        }
+
+        /**
+           \param n the maximum number of iterations, 0 (the default) for no limit
+         */
+        void set_max_iter (size_t n)
+        {
+            max_iter = n;
+        }
+
+        void do_set_start_point (const array1d_type &p)
+        {
+            resize (start_point, get_size (p));
+            opt_assign (start_point, p);
+        }
+
+        array1d_type do_get_start_point () const
+        {
+            return start_point;
+        }
+
+        void do_set_lower_limit (const array1d_type &p)
+        {
+            opt_assign (lower_limit, p);
+        }
+
+        void do_set_upper_limit (const array1d_type &p)
+        {
+            opt_assign (upper_limit, p);
+        }
+
+        array1d_type do_get_lower_limit () const
+        {
+            return lower_limit;
+        }
+
+        array1d_type do_get_upper_limit () const
+        {
+            return upper_limit;
+        }
+
+        void do_set_precision (rT t)
+        {
+            threshold = t;
+        }
+
+        rT do_get_precision () const
+        {
+            return threshold;
+        }
+
+        void do_set_optimizer (optimizer<rT, pT> &o)
+        {
+            p_optimizer = &o;
+            p_fo = p_optimizer->ptr_func_obj ();
+        }
+
+        void do_stop ()
+        {
+            bstop = true;
+        }
+
+        pT do_optimize ()
+        {
+            bstop = false;
+            n = get_size (start_point);
+            opt_assign (end_point, start_point);
+            if (n == 0)
+                {
+                    return end_point;
+                }
+            p_dfo = dynamic_cast<diff_func_obj<rT, pT> *> (p_fo);
+            const Te inf = std::numeric_limits<Te>::infinity ();
+            x.resize (n);
+            g.resize (n);
+            lo.resize (n);
+            hi.resize (n);
+            xc.resize (n);
+            xbar.resize (n);
+            xnew.resize (n);
+            gnew.resize (n);
+            dir.resize (n);
+            t.resize (n);
+            order.clear ();
+            order.reserve (n);
+            free_vars.clear ();
+            free_vars.reserve (n);
+            S.assign (m * n, Te (0));
+            Y.assign (m * n, Te (0));
+            SY.assign (m * m, Te (0));
+            SS.assign (m * m, Te (0));
+            M.assign (4 * m * m, Te (0));
+            A.assign (4 * m * m, Te (0));
+            N.assign (4 * m * m, Te (0));
+            wb.assign (2 * m, Te (0));
+            Mwb.assign (2 * m, Te (0));
+            pv.assign (2 * m, Te (0));
+            cv.assign (2 * m, Te (0));
+            Mcv.assign (2 * m, Te (0));
+            vv.assign (2 * m, Te (0));
+            opt_assign (px, start_point);
+            opt_assign (pgrad, start_point);
+            grad_points.assign (p_dfo == NULL_PTR ? 2 * std::min (n, size_t (32)) : 0, start_point);
+            grad_values.resize (grad_points.size ());
+            for (size_t i = 0; i < n; ++i)
+                {
+                    lo[i] = get_size (lower_limit) == n ? get_element (lower_limit, i) : -inf;
+                    hi[i] = get_size (upper_limit) == n ? get_element (upper_limit, i) : inf;
+                    x[i] = clamp (i, get_element (start_point, i));
+                }
+            k = 0;
+            head = 0;
+            theta = 1;
+
+            rT f = eval_value_gradient (x, g);
+            bool restarted = false;
+            for (size_t iter = 0; (max_iter == 0 || iter < max_iter) && !bstop; ++iter)
+                {
+                    if (projected_gradient_norm () <= pgtol)
+                        {
+                            break;
+                        }
+                    if (k > 0 && !form_M ())
+                        {
+                            // lost positive definiteness, restart from steepest descent
+                            k = 0;
+                            theta = 1;
+                        }
+                    cauchy_point ();
+                    subspace_min ();
+
+                    Te gd = 0;
+                    Te dnorm2 = 0;
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            dir[i] = xbar[i] - x[i];
+                            gd += g[i] * dir[i];
+                            dnorm2 += dir[i] * dir[i];
+                        }
+                    if (!(gd < 0))
+                        {
+                            break;
+                        }
+                    // backtracking within the box, x+lambda*dir stays feasible for lambda<=1
+                    Te lambda = k == 0 ? std::min (Te (1), Te (1) / std::sqrt (dnorm2)) : Te (1);
+                    const Te c1 = 1e-4;
+                    const int max_ls = 20;
+                    bool accepted = false;
+                    rT fnew = f;
+                    for (int ls = 0; ls < max_ls && !accepted; ++ls)
+                        {
+                            for (size_t i = 0; i < n; ++i)
+                                {
+                                    xnew[i] = clamp (i, x[i] + lambda * dir[i]);
+                                }
+                            fnew = p_dfo != NULL_PTR ? eval_value_gradient (xnew, gnew) : eval_value (xnew);
+                            if (fnew <= f + c1 * lambda * gd)
+                                {
+                                    accepted = true;
+                                    break;
+                                }
+                            // the minimum of the quadratic through f, gd and fnew
+                            Te lq = -gd * lambda * lambda / (2 * (fnew - f - gd * lambda));
+                            lambda = (lq == lq) ? std::min (std::max (lq, lambda / 10), lambda / 2) : lambda / 2;
+                        }
+                    p_optimizer->get_stats ().count_line_search ();
+                    if (!accepted)
+                        {
+                            // drop the correction pairs, and try once more
+                            // along the projected steepest descent
+                            if (k == 0 || restarted)
+                                {
+                                    break;
+                                }
+                            k = 0;
+                            theta = 1;
+                            restarted = true;
+                            continue;
+                        }
+                    restarted = false;
+                    if (p_dfo == NULL_PTR)
+                        {
+                            numeric_gradient (gnew);
+                        }
+                    // the correction pair, s in xbar and y in dir
+                    Te sy = 0, yy = 0;
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            xbar[i] = xnew[i] - x[i];
+                            dir[i] = gnew[i] - g[i];
+                            sy += xbar[i] * dir[i];
+                            yy += dir[i] * dir[i];
+                        }
+                    if (sy > std::numeric_limits<Te>::epsilon () * yy)
+                        {
+                            add_pair (&xbar[0], &dir[0]);
+                            theta = yy / sy;
+                        }
+                    const rT fold = f;
+                    f = fnew;
+                    x.swap (xnew);
+                    g.swap (gnew);
+                    for (size_t i = 0; i < n; ++i)
+                        {
+                            set_element (px, i, x[i]);
+                        }
+                    p_optimizer->get_stats ().add_iteration (f, px);
+                    if (fold - f <= threshold * std::max (std::max (std::abs (fold), std::abs (f)), rT (1)))
+                        {
+                            break;
+                        }
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    set_element (end_point, i, x[i]);
+                }
+            return end_point;
+        }
+    };
+}
+
+#endif
+// EOF
@@ -0,0 +1,490 @@
+/**
+   \file levmar.hpp
+   \brief Levenberg-Marquardt method for least-squares statistics
+   \author Junhua Gu
+ */
+
+#ifndef LEVMAR_METHOD
+#define LEVMAR_METHOD
+#define OPT_HEADER
+#include <core/optimizer.hpp>
+#include <core/opt_traits.hpp>
+#include <core/residual_provider.hpp>
+#include <limits>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+
+namespace opt_utilities
+{
+    /**
+       \brief Levenberg-Marquardt method.
+       It works on the residuals of the object function rather than on its
+       value, so the object function must implement residual_provider,
+       as chisq and leastsq do.
+       The Jacobian is taken from residual_provider::eval_jacobian when
+       the model supplies analytic derivatives, and by forward differences
+       otherwise.
+       The lower and upper limits are respected by holding the parameters
+       that sit on a limit fixed while the step would leave the box through
+       it, and by projecting every trial point back into the box.
+       \tparam rT return type of the object function
+       \tparam pT parameter type of the object function
+     */
+    template <typename rT, typename pT> class levmar_method : public opt_method<rT, pT>
+    {
+      public:
+        typedef pT array1d_type;
+
+      private:
+        func_obj<rT, pT> *p_fo;
+        optimizer<rT, pT> *p_optimizer;
+        volatile bool bstop;
+        rT threshold;
+        int max_iter;
+        rT lambda0;
+
+        pT start_point;
+        pT lower_bound;
+        pT upper_bound;
+
+        // workspace, reused across iterations and calls
+        pT trial_point;
+        std::vector<rT> r;
+        std::vector<rT> r_trial;
+        std::vector<rT> jac;
+        std::vector<rT> jtj;
+        std::vector<rT> jtr;
+        std::vector<rT> a;
+        std::vector<rT> delta;
+        std::vector<rT> rhs;
+        std::vector<char> fixed;
+
+      private:
+        const char *do_get_type_name () const
+        {
+            return "Levenberg-Marquardt method";
+        }
+
+        residual_provider<rT, pT> *get_residual_provider ()
+        {
+            assert (p_fo != NULL_PTR);
+            residual_provider<rT, pT> *prp = dynamic_cast<residual_provider<rT, pT> *> (p_fo);
+            if (prp == NULL_PTR)
+                {
+                    throw opt_exception ("levmar_method requires an object function implementing residual_provider");
+                }
+            return prp;
+        }
+
+        // evaluate the residuals, counted as one evaluation of the object function
+        void eval_residuals (residual_provider<rT, pT> &rp, const pT &p, rT *res)
+        {
+            optimizer_stats<rT, pT> *ps = p_fo->get_stats ();
+            if (ps == NULL_PTR)
+                {
+                    rp.eval_residuals (p, res);
+                    return;
+                }
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now ();
+            rp.eval_residuals (p, res);
+            ps->count_eval (
+            std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now () - t0).count ());
+        }
+
+        static rT sum_sq (const std::vector<rT> &x)
+        {
+            rT result (0);
+            for (size_t i = 0; i < x.size (); ++i)
+                {
+                    result += x[i] * x[i];
+                }
+            return result;
+        }
+
+        void clamp (pT &p) const
+        {
+            for (size_t j = 0; j < get_size (p); ++j)
+                {
+                    if (get_size (upper_bound) == get_size (p) && get_element (p, j) > get_element (upper_bound, j))
+                        {
+                            set_element (p, j, get_element (upper_bound, j));
+                        }
+                    if (get_size (lower_bound) == get_size (p) && get_element (p, j) < get_element (lower_bound, j))
+                        {
+                            set_element (p, j, get_element (lower_bound, j));
+                        }
+                }
+        }
+
+        // residuals and Jacobian at p, r must already hold the residuals at p
+        void jacobian (residual_provider<rT, pT> &rp, pT &p)
+        {
+            size_t m = r.size ();
+            size_t n = get_size (p);
+            if (p_fo->get_stats () != NULL_PTR)
+                {
+                    p_fo->get_stats ()->count_gradient ();
+                }
+            if (rp.eval_jacobian (p, &r[0], &jac[0]))
+                {
+                    return;
+                }
+            const rT ep = std::sqrt (std::numeric_limits<rT>::epsilon ());
+            for (size_t j = 0; j < n; ++j)
+                {
+                    typename element_type_trait<pT>::element_type old_value = get_element (p, j);
+                    typename element_type_trait<pT>::element_type h =
+                    ep * std::max (std::abs (old_value), typename element_type_trait<pT>::element_type (1));
+                    // step backward when the forward step would leave the box
+                    if (get_size (upper_bound) == n && old_value + h > get_element (upper_bound, j))
+                        {
+                            h = -h;
+                        }
+                    set_element (p, j, old_value + h);
+                    eval_residuals (rp, p, &r_trial[0]);
+                    set_element (p, j, old_value);
+                    for (size_t i = 0; i < m; ++i)
+                        {
+                            jac[i * n + j] = (r_trial[i] - r[i]) / h;
+                        }
+                }
+        }
+
+        // whether the j-th parameter sits on a limit and a step dj moves it out of the box
+        bool leaves_box (const pT &p, size_t j, rT dj) const
+        {
+            size_t n = get_size (p);
+            return (dj > 0 && get_size (upper_bound) == n && !(get_element (p, j) < get_element (upper_bound, j))) ||
+                   (dj < 0 && get_size (lower_bound) == n && !(get_element (p, j) > get_element (lower_bound, j)));
+        }
+
+        // the damped step from p into delta, with the parameters that would
+        // leave the box through the limit they sit on held fixed;
+        // return false if the damped J^T J is not positive definite
+        bool solve_step (const pT &p, rT lambda)
+        {
+            size_t n = get_size (p);
+            std::fill (fixed.begin (), fixed.end (), 0);
+            for (;;)
+                {
+                    // damped normal equations, (J^T J + lambda diag(J^T J)) delta = -J^T r
+                    std::copy (jtj.begin (), jtj.end (), a.begin ());
+                    std::copy (jtr.begin (), jtr.end (), rhs.begin ());
+                    for (size_t j = 0; j < n; ++j)
+                        {
+                            rT d = jtj[j * n + j];
+                            a[j * n + j] += lambda * (d > 0 ? d : rT (1));
+                        }
+                    for (size_t j = 0; j < n; ++j)
+                        {
+                            if (fixed[j])
+                                {
+                                    for (size_t k = 0; k < n; ++k)
+                                        {
+                                            a[j * n + k] = 0;
+                                            a[k * n + j] = 0;
+                                        }
+                                    a[j * n + j] = 1;
+                                    rhs[j] = 0;
+                                }
+                        }
+                    if (!cholesky_solve (a, rhs, delta, n))
+                        {
+                            return false;
+                        }
+                    bool changed = false;
+                    for (size_t j = 0; j < n; ++j)
+                        {
+                            if (!fixed[j] && leaves_box (p, j, delta[j]))
+                                {
+                                    fixed[j] = 1;
+                                    changed = true;
+                                }
+                        }
+                    if (!changed)
+                        {
+                            return true;
+                        }
+                }
+        }
+
+        // solve a*x=b by Cholesky decomposition, a is overwritten
+        // return false if a is not positive definite
+        static bool cholesky_solve (std::vector<rT> &a, const std::vector<rT> &b, std::vector<rT> &x, size_t n)
+        {
+            for (size_t j = 0; j < n; ++j)
+                {
+                    rT d = a[j * n + j];
+                    for (size_t k = 0; k < j; ++k)
+                        {
+                            d -= a[j * n + k] * a[j * n + k];
+                        }
+                    if (!(d > 0))
+                        {
+                            return false;
+                        }
+                    d = std::sqrt (d);
+                    a[j * n + j] = d;
+                    for (size_t i = j + 1; i < n; ++i)
+                        {
+                            rT s = a[i * n + j];
+                            for (size_t k = 0; k < j; ++k)
+                                {
+                                    s -= a[i * n + k] * a[j * n + k];
+                                }
+                            a[i * n + j] = s / d;
+                        }
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    rT s = b[i];
+                    for (size_t k = 0; k < i; ++k)
+                        {
+                            s -= a[i * n + k] * x[k];
+                        }
+                    x[i] = s / a[i * n + i];
+                }
+            for (size_t i = n; i-- > 0;)
+                {
+                    rT s = x[i];
+                    for (size_t k = i + 1; k < n; ++k)
+                        {
+                            s -= a[k * n + i] * x[k];
+                        }
+                    x[i] = s / a[i * n + i];
+                }
+            return true;
+        }
+
+      public:
+        levmar_method ()
+        : p_fo (NULL_PTR), p_optimizer (NULL_PTR), bstop (false), threshold (1e-8), max_iter (500), lambda0 (1e-3)
+        {
+        }
+
+        virtual ~levmar_method ()
+        {
+        }
+
+        levmar_method (const levmar_method<rT, pT> &rhs)
+        : opt_method<rT, pT> (rhs), p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer), bstop (false),
+          threshold (rhs.threshold), max_iter (rhs.max_iter), lambda0 (rhs.lambda0), start_point (rhs.start_point),
+          lower_bound (rhs.lower_bound), upper_bound (rhs.upper_bound)
+        {
+        }
+
+        levmar_method<rT, pT> &operator= (const levmar_method<rT, pT> &rhs)
+        {
+            p_fo = rhs.p_fo;
+            p_optimizer = rhs.p_optimizer;
+            threshold = rhs.threshold;
+            max_iter = rhs.max_iter;
+            lambda0 = rhs.lambda0;
+            opt_assign (start_point, rhs.start_point);
+            opt_assign (lower_bound, rhs.lower_bound);
+            opt_assign (upper_bound, rhs.upper_bound);
+            return *this;
+        }
+
+        opt_method<rT, pT> *do_clone () const
+        {
+            return new levmar_method<rT, pT> (*this);
+        }
+
+        /**
+           set the maximum number of iterations
+         */
+        void set_max_iter (int n)
+        {
+            max_iter = n;
+        }
+
+        /**
+           set the initial damping factor
+         */
+        void set_initial_lambda (rT l)
+        {
+            lambda0 = l;
+        }
+
+        void do_set_start_point (const array1d_type &p)
+        {
+            resize (start_point, get_size (p));
+            opt_assign (start_point, p);
+        }
+
+        array1d_type do_get_start_point () const
+        {
+            return start_point;
+        }
+
+        void do_set_lower_limit (const array1d_type &p)
+        {
+            opt_assign (lower_bound, p);
+        }
+
+        array1d_type do_get_lower_limit () const
+        {
+            return lower_bound;
+        }
+
+        void do_set_upper_limit (const array1d_type &p)
+        {
+            opt_assign (upper_bound, p);
+        }
+
+        array1d_type do_get_upper_limit () const
+        {
+            return upper_bound;
+        }
+
+        /**
+           the iteration stops when an accepted step reduces the sum of
+           squares by less than this fraction
+         */
+        void do_set_precision (rT t)
+        {
+            threshold = t;
+        }
+
+        rT do_get_precision () const
+        {
+            return threshold;
+        }
+
+        void do_set_optimizer (optimizer<rT, pT> &o)
+        {
+            p_optimizer = &o;
+            p_fo = p_optimizer->ptr_func_obj ();
+        }
+
+        pT do_optimize ()
+        {
+            bstop = false;
+            residual_provider<rT, pT> &rp = *get_residual_provider ();
+            size_t m = rp.num_residuals ();
+            size_t n = get_size (start_point);
+            pT p;
+            opt_assign (p, start_point);
+            clamp (p);
+            if (n == 0 || m == 0)
+                {
+                    return p;
+                }
+
+            r.resize (m);
+            r_trial.resize (m);
+            jac.resize (m * n);
+            jtj.resize (n * n);
+            jtr.resize (n);
+            a.resize (n * n);
+            delta.resize (n);
+            rhs.resize (n);
+            fixed.resize (n);
+            resize (trial_point, n);
+
+            eval_residuals (rp, p, &r[0]);
+            rT cost = sum_sq (r);
+            rT lambda = lambda0;
+            bool need_jacobian = true;
+
+            for (int iter = 0; iter < max_iter && !bstop; ++iter)
+                {
+                    if (need_jacobian)
+                        {
+                            jacobian (rp, p);
+                            for (size_t j = 0; j < n; ++j)
+                                {
+                                    rT s (0);
+                                    for (size_t i = 0; i < m; ++i)
+                                        {
+                                            s += jac[i * n + j] * r[i];
+                                        }
+                                    jtr[j] = -s;
+                                    for (size_t k = 0; k <= j; ++k)
+                                        {
+                                            rT t (0);
+                                            for (size_t i = 0; i < m; ++i)
+                                                {
+                                                    t += jac[i * n + j] * jac[i * n + k];
+                                                }
+                                            jtj[j * n + k] = t;
+                                            jtj[k * n + j] = t;
+                                        }
+                                }
+                            need_jacobian = false;
+                        }
+
+                    if (!solve_step (p, lambda))
+                        {
+                            lambda *= 10;
+                            if (lambda > 1e16)
+                                {
+                                    break;
+                                }
+                            continue;
+                        }
+
+                    rT step (0);
+                    for (size_t j = 0; j < n; ++j)
+                        {
+                            set_element (trial_point, j, get_element (p, j) + delta[j]);
+                        }
+                    clamp (trial_point);
+                    for (size_t j = 0; j < n; ++j)
+                        {
+                            step = std::max (step, std::abs (rT (get_element (trial_point, j) - get_element (p, j))));
+                        }
+                    // a larger damping turns the step toward the steepest
+                    // descent, which may not be cut off by the box
+                    if (step == 0)
+                        {
+                            lambda *= 10;
+                            if (lambda > 1e16)
+                                {
+                                    break;
+                                }
+                            continue;
+                        }
+
+                    eval_residuals (rp, trial_point, &r_trial[0]);
+                    rT new_cost = sum_sq (r_trial);
+                    if (new_cost < cost)
+                        {
+                            rT decrease = cost - new_cost;
+                            opt_assign (p, trial_point);
+                            r.swap (r_trial);
+                            cost = new_cost;
+                            lambda = std::max (lambda / 10, std::numeric_limits<rT>::epsilon ());
+                            need_jacobian = true;
+                            p_optimizer->get_stats ().add_iteration (cost, p);
+                            if (decrease <= threshold * cost)
+                                {
+                                    break;
+                                }
+                        }
+                    else
+                        {
+                            lambda *= 10;
+                            if (lambda > 1e16)
+                                {
+                                    break;
+                                }
+                        }
+                }
+            return p;
+        }
+
+        void do_stop ()
+        {
+            bstop = true;
+        }
+    };
+}
+
+#endif
+// EOF
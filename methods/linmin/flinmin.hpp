@@ -64,9 +64,6 @@ namespace opt_utilities
         // cout<<xx<<endl;
         fret = fbrent (ax, xx, bx, fadpt, TOL, xmin);
         // cout<<xmin<<endl;
-#ifdef OPT_USE_OMP
-#pragma omp parallel for
-#endif
         for (j = 0; j < n; ++j)
             {
                 // get_element(xi,j)*=xmin;
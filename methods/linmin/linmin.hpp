@@ -61,9 +61,6 @@ namespace opt_utilities
 
             pT xt;
             opt_assign (xt, p1);
-#ifdef OPT_USE_OMP
-#pragma omp parallel for
-#endif
             for (size_t i = 0; i < get_size (xt); ++i)
                 {
                     // get_element(xt,i)+=x*get_element((pT)xi1,i);
@@ -83,6 +80,10 @@ namespace opt_utilities
         //  assert(p.size()==10);
         // assert(xi.size()==10);
         func_adaptor<rT, pT> fadpt (p, xi, func);
+        if (func.get_stats () != NULL_PTR)
+            {
+                func.get_stats ()->count_line_search ();
+            }
 
         int j = 0;
         const rT TOL = std::sqrt (std::numeric_limits<rT>::epsilon ());
@@ -98,9 +99,6 @@ namespace opt_utilities
         // cout<<xx<<endl;
         fret = brent (ax, xx, bx, fadpt, TOL, xmin);
         // cout<<xmin<<endl;
-#ifdef OPT_USE_OMP
-#pragma omp parallel for
-#endif
         for (j = 0; j < n; ++j)
             {
                 // get_element(xi,j)*=xmin;
@@ -0,0 +1,226 @@
+/**
+   \file parallel_linmin.hpp
+   \brief linear search evaluating several trial steps at once
+   \author Junhua Gu
+ */
+
+
+#ifndef PARALLEL_LINMIN_HPP
+#define PARALLEL_LINMIN_HPP
+#define OPT_HEADER
+#include <core/optimizer.hpp>
+#include <core/opt_traits.hpp>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+namespace opt_utilities
+{
+    /**
+       \brief The trial steps of parallel_linmin along p+x*xi, every round
+       of probes is evaluated as one batch by func_obj::eval_many.
+     */
+    template <typename rT, typename pT> class line_probes
+    {
+      private:
+        const pT &p;
+        const pT &xi;
+        func_obj<rT, pT> &func;
+        std::map<rT, rT> values;
+        std::vector<rT> steps;
+        std::vector<pT> points;
+        std::vector<rT> results;
+
+      public:
+        line_probes (const pT &_p, const pT &_xi, func_obj<rT, pT> &f) : p (_p), xi (_xi), func (f)
+        {
+        }
+
+        /**
+           queue a step, unless it has been evaluated
+         */
+        void add (rT x)
+        {
+            if (values.find (x) == values.end () && std::find (steps.begin (), steps.end (), x) == steps.end ())
+                {
+                    steps.push_back (x);
+                }
+        }
+
+        /**
+           evaluate the queued steps as one batch
+         */
+        void eval ()
+        {
+            if (steps.empty ())
+                {
+                    return;
+                }
+            points.resize (steps.size ());
+            results.resize (steps.size ());
+            for (size_t k = 0; k < steps.size (); ++k)
+                {
+                    opt_assign (points[k], p);
+                    for (size_t i = 0; i < get_size (p); ++i)
+                        {
+                            set_element (points[k], i, get_element (p, i) + steps[k] * get_element (xi, i));
+                        }
+                }
+            func.eval_many (&points[0], steps.size (), &results[0]);
+            for (size_t k = 0; k < steps.size (); ++k)
+                {
+                    values[steps[k]] = results[k];
+                }
+            steps.clear ();
+        }
+
+        /**
+           \return the evaluated steps and values, in ascending order of the steps
+         */
+        const std::map<rT, rT> &get_values () const
+        {
+            return values;
+        }
+    };
+
+    /**
+       Minimize func along the direction xi from p, the same as linmin,
+       but with a few rounds of width trial steps evaluated concurrently
+       (see func_obj::eval_many and eval_executor) instead of the
+       sequential steps of mnbrak and brent.
+       The minimum is bracketed by one round of steps growing
+       geometrically in both directions (more rounds only if it lies
+       beyond them), and the bracket is then narrowed by rounds of probes
+       around the parabolic estimate of the minimum and evenly spaced
+       across the bracket.
+       It takes more evaluations than linmin, and less wall time when the
+       evaluations are expensive and the executor has about width threads.
+       \param p the start point, output as the minimum
+       \param xi the direction, output as the actual displacement
+       \param fret output as the value at the minimum
+       \param func the object function
+       \param width the number of trial steps per round, at least 3
+     */
+    template <typename rT, typename pT>
+    void parallel_linmin (pT &p, pT &xi, rT &fret, func_obj<rT, pT> &func, size_t width)
+    {
+        if (func.get_stats () != NULL_PTR)
+            {
+                func.get_stats ()->count_line_search ();
+            }
+        const rT GOLD = 1.618034;
+        const rT TOL = std::sqrt (std::numeric_limits<rT>::epsilon ());
+        const rT ZEPS = std::numeric_limits<rT>::epsilon () * 1.e-3;
+        const int ITMAX = 100;
+        width = std::max (width, size_t (3));
+
+        line_probes<rT, pT> probes (p, xi, func);
+        // the bracketing round, steps of +-GOLD^k around the unit step, and 0
+        probes.add (0);
+        size_t half = (width - 1) / 2;
+        for (size_t k = 0; k < half; ++k)
+            {
+                rT x = std::pow (GOLD, rT (k) - rT (half / 2));
+                probes.add (x);
+                probes.add (-x);
+            }
+        if (width % 2 == 0)
+            {
+                probes.add (std::pow (GOLD, rT (half) - rT (half / 2)));
+            }
+        probes.eval ();
+
+        std::vector<rT> xs;
+        std::vector<rT> fs;
+        rT xmin = 0;
+        fret = probes.get_values ().find (rT (0))->second;
+        for (int iter = 0; iter < ITMAX; ++iter)
+            {
+                xs.clear ();
+                fs.clear ();
+                size_t imin = 0;
+                for (typename std::map<rT, rT>::const_iterator i = probes.get_values ().begin ();
+                     i != probes.get_values ().end (); ++i)
+                    {
+                        xs.push_back (i->first);
+                        fs.push_back (i->second);
+                        // on ties prefer the shortest step, so a flat line stays at 0
+                        if (i->second < fs[imin] || (i->second == fs[imin] && std::abs (i->first) < std::abs (xs[imin])))
+                            {
+                                imin = fs.size () - 1;
+                            }
+                    }
+                xmin = xs[imin];
+                fret = fs[imin];
+                size_t last = xs.size () - 1;
+                if (imin == 0 || imin == last)
+                    {
+                        // beyond the evaluated steps, go on growing in that direction
+                        rT x0 = xs[imin];
+                        rT d = imin == 0 ? xs[0] - xs[1] : xs[last] - xs[last - 1];
+                        for (size_t k = 1; k <= width; ++k)
+                            {
+                                probes.add (x0 + d * std::pow (GOLD, rT (k)));
+                            }
+                        probes.eval ();
+                        continue;
+                    }
+                rT a = xs[imin - 1];
+                rT b = xs[imin];
+                rT c = xs[imin + 1];
+                rT tol1 = TOL * std::abs (b) + ZEPS;
+                if (std::max (b - a, c - b) <= 2 * tol1)
+                    {
+                        break;
+                    }
+                // the vertex of the parabola through the bracket
+                rT fa = fs[imin - 1];
+                rT fb = fs[imin];
+                rT fc = fs[imin + 1];
+                rT r = (b - a) * (fb - fc);
+                rT q = (b - c) * (fb - fa);
+                rT den = 2 * (q - r);
+                size_t n_probes = 0;
+                if (den != 0)
+                    {
+                        rT u = b - ((b - c) * q - (b - a) * r) / den;
+                        if (u > a && u < c)
+                            {
+                                // probes clustered around the vertex
+                                rT s = std::max (std::abs (u - b) / 2, tol1);
+                                probes.add (u);
+                                ++n_probes;
+                                for (size_t k = 1; n_probes + 2 <= width / 2 + 1; ++k)
+                                    {
+                                        if (u - k * s > a)
+                                            {
+                                                probes.add (u - k * s);
+                                            }
+                                        if (u + k * s < c)
+                                            {
+                                                probes.add (u + k * s);
+                                            }
+                                        n_probes += 2;
+                                    }
+                            }
+                    }
+                // the rest evenly spaced in the bracket
+                size_t n_even = width - n_probes;
+                for (size_t k = 1; k <= n_even; ++k)
+                    {
+                        probes.add (a + (c - a) * k / (n_even + 1));
+                    }
+                probes.eval ();
+            }
+        for (size_t j = 0; j < get_size (p); ++j)
+            {
+                set_element (xi, j, get_element (xi, j) * xmin);
+                set_element (p, j, get_element (p, j) + get_element (xi, j));
+            }
+    }
+}
+
+
+#endif
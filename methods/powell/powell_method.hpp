@@ -13,6 +13,7 @@
 #include <cassert>
 #include <cmath>
 #include "../linmin/linmin.hpp"
+#include "../linmin/parallel_linmin.hpp"
 #include <algorithm>
 #include <iostream>
 
@@ -49,6 +50,7 @@ namespace opt_utilities
         array1d_type pcom_p;
         array1d_type xicom_p;
         rT threshold;
+        size_t line_search_width;
         T **xi;
         T *xi_1d;
 
@@ -59,6 +61,18 @@ namespace opt_utilities
             return p_fo->eval (x);
         }
 
+        void line_search (pT &p, pT &xi, rT &fret)
+        {
+            if (line_search_width == 0)
+                {
+                    linmin (p, xi, fret, *p_fo);
+                }
+            else
+                {
+                    parallel_linmin (p, xi, fret, *p_fo, line_search_width);
+                }
+        }
+
 
       private:
         void clear_xi ()
@@ -116,22 +130,20 @@ namespace opt_utilities
                     del = 0.0;
                     for (i = 0; i < n; ++i)
                         {
-#ifdef OPT_USE_OMP
-#pragma omp parallel for
-#endif
                             for (j = 0; j < n; ++j)
                                 {
                                     // get_element(xit,j)=xi[j][i];
                                     set_element (xit, j, xi[j][i]);
                                 }
                             fptt = fret;
-                            linmin (p, xit, fret, (*p_fo));
+                            line_search (p, xit, fret);
                             if ((fptt - fret) > del)
                                 {
                                     del = fptt - fret;
                                     ibig = i + 1;
                                 }
                         }
+                    p_optimizer->get_stats ().add_iteration (fret, p);
                     if (T (2.) * (fp - fret) <= ftol * (tabs (fp) + tabs (fret)) + TINY)
                         {
                             return;
@@ -141,9 +153,6 @@ namespace opt_utilities
                             std::cerr << "powell exceeding maximun iterations." << std::endl;
                             return;
                         }
-#ifdef OPT_USE_OMP
-#pragma omp parallel for
-#endif
                     for (j = 0; j < n; ++j)
                         {
                             // get_element(ptt,j)=T(2.)*get_element(p,j)-get_element(pt,j);
@@ -161,10 +170,7 @@ namespace opt_utilities
                                 del * sqr (T (fp - fptt));
                             if (t < T (0.))
                                 {
-                                    linmin (p, xit, fret, *p_fo);
-#ifdef OPT_USE_OMP
-#pragma omp parallel for
-#endif
+                                    line_search (p, xit, fret);
                                     for (j = 0; j < n; ++j)
                                         {
                                             xi[j][ibig - 1] = xi[j][n - 1];
@@ -177,7 +183,7 @@ namespace opt_utilities
 
 
       public:
-        powell_method () : threshold (1e-4), xi (NULL_PTR), xi_1d (NULL_PTR)
+        powell_method () : threshold (1e-4), line_search_width (0), xi (NULL_PTR), xi_1d (NULL_PTR)
         {
         }
 
@@ -189,7 +195,7 @@ namespace opt_utilities
         powell_method (const powell_method<rT, pT> &rhs)
         : opt_method<rT, pT> (rhs), p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer),
           start_point (rhs.start_point), end_point (rhs.end_point), ncom (rhs.ncom),
-          threshold (rhs.threshold), xi (NULL_PTR), xi_1d (NULL_PTR)
+          threshold (rhs.threshold), line_search_width (rhs.line_search_width), xi (NULL_PTR), xi_1d (NULL_PTR)
         {
         }
 
@@ -198,6 +204,7 @@ namespace opt_utilities
             threshold = rhs.threshold;
             xi = 0;
             xi_1d = 0;
+            line_search_width = rhs.line_search_width;
             p_fo = rhs.p_fo;
             p_optimizer = rhs.p_optimizer;
             start_point = rhs.start_point;
@@ -206,6 +213,22 @@ namespace opt_utilities
             threshold = rhs.threshold;
         }
 
+        /**
+           Use parallel_linmin for the line searches, which evaluates
+           width trial steps at once, see eval_executor.
+           \param width the number of trial steps per round, 0 (the default)
+           for the sequential linmin
+         */
+        void set_line_search_width (size_t width)
+        {
+            line_search_width = width;
+        }
+
+        size_t get_line_search_width () const
+        {
+            return line_search_width;
+        }
+
         opt_method<rT, pT> *do_clone () const
         {
             return new powell_method<rT, pT> (*this);
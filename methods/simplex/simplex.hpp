@@ -0,0 +1,396 @@
+/**
+   \file simplex.hpp
+   \brief Nelder-Mead simplex method
+   \author Junhua Gu
+ */
+
+#ifndef SIMPLEX_METHOD
+#define SIMPLEX_METHOD
+#define OPT_HEADER
+#include <core/optimizer.hpp>
+#include <core/opt_traits.hpp>
+#include <vector>
+#include <limits>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace opt_utilities
+{
+    /**
+       \brief Nelder-Mead simplex method, without derivatives.
+       The coefficients adapt to the dimension n as proposed by Gao & Han
+       (2012, Comput. Optim. Appl. 51, 259): reflection 1, expansion 1+2/n,
+       contraction 3/4-1/(2n) and shrink 1-1/n, which reduce to the standard
+       ones for n=2 and keep the method effective in high dimensions; the
+       standard ones are used for n=1 as well.
+       The initial simplex extends from the start point along every axis by
+       a tenth of the range between the limits, if both are finite, otherwise
+       by 5% of the start value (0.00025 if it is 0), unless the steps are
+       set by set_initial_steps.
+       The initial simplex and the shrink steps are evaluated as batches,
+       see func_obj::eval_many.
+       All the vertices are allocated when the optimization starts, and the
+       iterations do not allocate.
+       The optimization stops when the mean distance of the vertices to their
+       centroid is below the precision, the same criterion as gsl_simplex.
+       It costs O(n^2), so it is tested every n+1 iterations and after
+       every shrink, which keeps an iteration O(n) on the average.
+       \tparam rT return type of the object function
+       \tparam pT parameter type of the object function
+     */
+    template <typename rT, typename pT> class simplex_method : public opt_method<rT, pT>
+    {
+      public:
+        typedef pT array1d_type;
+        typedef typename element_type_trait<pT>::element_type element_type;
+
+      private:
+        func_obj<rT, pT> *p_fo;
+        optimizer<rT, pT> *p_optimizer;
+        volatile bool bstop;
+
+        pT start_point;
+        pT end_point;
+        pT lower_limit;
+        pT upper_limit;
+        pT initial_steps;
+        rT threshold;
+        size_t max_iter;
+
+        // n+1 vertices and their values
+        std::vector<pT> vertices;
+        std::vector<rT> values;
+        // the sum of all the vertices, for the centroid
+        pT vertex_sum;
+        pT trial1;
+        pT trial2;
+
+      private:
+        const char *do_get_type_name () const
+        {
+            return "Nelder-Mead simplex";
+        }
+
+        rT func (const pT &x)
+        {
+            assert (p_fo != NULL_PTR);
+            return p_fo->eval (x);
+        }
+
+        element_type initial_step (size_t i) const
+        {
+            if (get_size (initial_steps) == get_size (start_point))
+                {
+                    return get_element (initial_steps, i);
+                }
+            const element_type x = get_element (start_point, i);
+            if (get_size (lower_limit) == get_size (start_point) && get_size (upper_limit) == get_size (start_point))
+                {
+                    element_type range = get_element (upper_limit, i) - get_element (lower_limit, i);
+                    if (range > 0 && range < std::numeric_limits<element_type>::max ())
+                        {
+                            return range / 10;
+                        }
+                }
+            return x != 0 ? x / 20 : element_type (0.00025);
+        }
+
+        void sum_vertices ()
+        {
+            size_t n = get_size (start_point);
+            for (size_t j = 0; j < n; ++j)
+                {
+                    element_type s = 0;
+                    for (size_t i = 0; i <= n; ++i)
+                        {
+                            s += get_element (vertices[i], j);
+                        }
+                    set_element (vertex_sum, j, s);
+                }
+        }
+
+        // out=centroid+t*(centroid-vertices[k]), the centroid of all but vertices[k]
+        void move (size_t k, element_type t, pT &out)
+        {
+            size_t n = get_size (start_point);
+            for (size_t j = 0; j < n; ++j)
+                {
+                    element_type c = (get_element (vertex_sum, j) - get_element (vertices[k], j)) / element_type (n);
+                    set_element (out, j, c + t * (c - get_element (vertices[k], j)));
+                }
+        }
+
+        void replace (size_t k, const pT &p, rT v)
+        {
+            size_t n = get_size (start_point);
+            for (size_t j = 0; j < n; ++j)
+                {
+                    set_element (vertex_sum, j, get_element (vertex_sum, j) - get_element (vertices[k], j) + get_element (p, j));
+                    set_element (vertices[k], j, get_element (p, j));
+                }
+            values[k] = v;
+        }
+
+        // the mean distance of the vertices to their centroid
+        element_type simplex_size () const
+        {
+            size_t n = get_size (start_point);
+            element_type result = 0;
+            for (size_t i = 0; i <= n; ++i)
+                {
+                    element_type d2 = 0;
+                    for (size_t j = 0; j < n; ++j)
+                        {
+                            element_type d = get_element (vertices[i], j) - get_element (vertex_sum, j) / element_type (n + 1);
+                            d2 += d * d;
+                        }
+                    result += std::sqrt (d2);
+                }
+            return result / element_type (n + 1);
+        }
+
+      public:
+        simplex_method ()
+        : p_fo (NULL_PTR), p_optimizer (NULL_PTR), bstop (false), threshold (1e-4), max_iter (0)
+        {
+        }
+
+        virtual ~simplex_method ()
+        {
+        }
+
+        simplex_method (const simplex_method<rT, pT> &rhs)
+        : opt_method<rT, pT> (rhs), p_fo (rhs.p_fo), p_optimizer (rhs.p_optimizer), bstop (false),
+          start_point (rhs.start_point), end_point (rhs.end_point), lower_limit (rhs.lower_limit),
+          upper_limit (rhs.upper_limit), initial_steps (rhs.initial_steps), threshold (rhs.threshold),
+          max_iter (rhs.max_iter)
+        {
+        }
+
+        simplex_method<rT, pT> &operator= (const simplex_method<rT, pT> &rhs)
+        {
+            p_fo = rhs.p_fo;
+            p_optimizer = rhs.p_optimizer;
+            opt_assign (start_point, rhs.start_point);
+            opt_assign (end_point, rhs.end_point);
+            opt_assign (lower_limit, rhs.lower_limit);
+            opt_assign (upper_limit, rhs.upper_limit);
+            opt_assign (initial_steps, rhs.initial_steps);
+            threshold = rhs.threshold;
+            max_iter = rhs.max_iter;
+            return *this;
+        }
+
+        opt_method<rT, pT> *do_clone () const
+        {
+            return new simplex_method<rT, pT> (*this);
+        }
+
+        /**
+           set the initial extent of the simplex along every axis
+           \param s the steps, an empty array to derive them from the limits
+         */
+        void set_initial_steps (const pT &s)
+        {
+            opt_assign (initial_steps, s);
+        }
+
+        /**
+           \param n the maximum number of iterations, 0 (the default) for 1000 times the dimension
+         */
+        void set_max_iter (size_t n)
+        {
+            max_iter = n;
+        }
+
+        void do_set_start_point (const array1d_type &p)
+        {
+            resize (start_point, get_size (p));
+            opt_assign (start_point, p);
+        }
+
+        array1d_type do_get_start_point () const
+        {
+            return start_point;
+        }
+
+        void do_set_lower_limit (const array1d_type &p)
+        {
+            opt_assign (lower_limit, p);
+        }
+
+        void do_set_upper_limit (const array1d_type &p)
+        {
+            opt_assign (upper_limit, p);
+        }
+
+        array1d_type do_get_lower_limit () const
+        {
+            return lower_limit;
+        }
+
+        array1d_type do_get_upper_limit () const
+        {
+            return upper_limit;
+        }
+
+        void do_set_precision (rT t)
+        {
+            threshold = t;
+        }
+
+        rT do_get_precision () const
+        {
+            return threshold;
+        }
+
+        void do_set_optimizer (optimizer<rT, pT> &o)
+        {
+            p_optimizer = &o;
+            p_fo = p_optimizer->ptr_func_obj ();
+        }
+
+        pT do_optimize ()
+        {
+            bstop = false;
+            const size_t n = get_size (start_point);
+            opt_assign (end_point, start_point);
+            if (n == 0)
+                {
+                    return end_point;
+                }
+            // the shrink 1-1/n would collapse a simplex of one dimension
+            const element_type m = element_type (std::max (n, size_t (2)));
+            const element_type alpha = 1;
+            const element_type beta = 1 + 2 / m;
+            const element_type gamma = element_type (.75) - 1 / (2 * m);
+            const element_type delta = 1 - 1 / m;
+            const size_t itmax = max_iter == 0 ? 1000 * n : max_iter;
+
+            vertices.resize (n + 1);
+            values.resize (n + 1);
+            for (size_t i = 0; i <= n; ++i)
+                {
+                    opt_assign (vertices[i], start_point);
+                }
+            for (size_t i = 0; i < n; ++i)
+                {
+                    element_type h = initial_step (i);
+                    element_type x = get_element (start_point, i);
+                    // keep the vertex inside the limits if possible
+                    if (get_size (upper_limit) == n && x + h > get_element (upper_limit, i))
+                        {
+                            h = -h;
+                        }
+                    set_element (vertices[i + 1], i, x + h);
+                }
+            resize (vertex_sum, n);
+            opt_assign (trial1, start_point);
+            opt_assign (trial2, start_point);
+            p_fo->eval_many (&vertices[0], n + 1, &values[0]);
+            sum_vertices ();
+
+            bool shrunk = false;
+            for (size_t iter = 0; iter < itmax && !bstop; ++iter)
+                {
+                    size_t best = 0;
+                    size_t worst = 0;
+                    for (size_t i = 1; i <= n; ++i)
+                        {
+                            if (values[i] < values[best])
+                                {
+                                    best = i;
+                                }
+                            if (values[i] >= values[worst])
+                                {
+                                    worst = i;
+                                }
+                        }
+                    size_t second = worst == 0 ? 1 : 0;
+                    for (size_t i = 0; i <= n; ++i)
+                        {
+                            if (i != worst && values[i] > values[second])
+                                {
+                                    second = i;
+                                }
+                        }
+                    p_optimizer->get_stats ().add_iteration (values[best], vertices[best]);
+                    if (shrunk || iter % (n + 1) == n)
+                        {
+                            // against the drift of the incremental updates
+                            sum_vertices ();
+                            if (simplex_size () < threshold)
+                                {
+                                    break;
+                                }
+                        }
+                    shrunk = false;
+
+                    move (worst, alpha, trial1);
+                    rT fr = func (trial1);
+                    if (fr < values[best])
+                        {
+                            move (worst, beta, trial2);
+                            rT fe = func (trial2);
+                            if (fe < fr)
+                                {
+                                    replace (worst, trial2, fe);
+                                }
+                            else
+                                {
+                                    replace (worst, trial1, fr);
+                                }
+                            continue;
+                        }
+                    if (fr < values[second])
+                        {
+                            replace (worst, trial1, fr);
+                            continue;
+                        }
+                    // outside contraction if the reflection is better than the worst, else inside
+                    bool outside = fr < values[worst];
+                    move (worst, outside ? alpha * gamma : -gamma, trial2);
+                    rT fc = func (trial2);
+                    if (outside ? fc <= fr : fc < values[worst])
+                        {
+                            replace (worst, trial2, fc);
+                            continue;
+                        }
+                    // shrink towards the best vertex, moved to the front so that
+                    // the n new vertices are evaluated as one batch
+                    std::swap (vertices[0], vertices[best]);
+                    std::swap (values[0], values[best]);
+                    for (size_t i = 1; i <= n; ++i)
+                        {
+                            for (size_t j = 0; j < n; ++j)
+                                {
+                                    element_type b = get_element (vertices[0], j);
+                                    set_element (vertices[i], j, b + delta * (get_element (vertices[i], j) - b));
+                                }
+                        }
+                    p_fo->eval_many (&vertices[1], n, &values[1]);
+                    shrunk = true;
+                }
+
+            size_t best = 0;
+            for (size_t i = 1; i <= n; ++i)
+                {
+                    if (values[i] < values[best])
+                        {
+                            best = i;
+                        }
+                }
+            opt_assign (end_point, vertices[best]);
+            return end_point;
+        }
+
+        void do_stop ()
+        {
+            bstop = true;
+        }
+    };
+}
+
+#endif
+// EOF
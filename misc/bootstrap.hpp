@@ -9,14 +9,17 @@
 #define BOOT_STRAP
 #define OPT_HEADER
 #include <core/fitter.hpp>
+#include <core/thread_pool.hpp>
 #include <vector>
-#include <list>
 #include <cstdlib>
 #include <iostream>
 #include <utility>
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <atomic>
 #include <data_sets/default_data_set.hpp>
+#include <misc/random.hpp>
 using std::cerr;
 namespace opt_utilities
 {
@@ -31,9 +34,17 @@ namespace opt_utilities
         return y;
     }
 
-
     /**
        \brief using bootstrap method to estimate confidence interval
+       The resamples run on several threads, each with its own copy of
+       the model, statistic and method, and its own copy of the data,
+       whose y values are redrawn in place for every resample.
+       The i-th resample draws from the i-th stream of a counter_rng,
+       so the results depend only on the seed, not on the number of threads.
+       The y values are drawn from N(y,(y_upper_err+y_lower_err)/2)
+       in one pass over the column with normal_generator::fill_normal.
+       The fitted parameters are kept in one contiguous
+       (samples x params) matrix.
        \tparam Ty the return type of a model
        \tparam Tx the type of self-var
        \tparam Tp the type of model parameters
@@ -45,23 +56,32 @@ namespace opt_utilities
       private:
         typedef typename Tdata::Ty Ty;
         typedef typename Tdata::Tx Tx;
+        typedef typename element_type_trait<Tp>::element_type Te;
 
       public:
-        typedef typename std::list<Tp>::const_iterator param_iterator;
-
-      public:
-        std::list<Tp> param_pool;
-        default_data_set<Tdata> current_data_set;
         default_data_set<Tdata> origin_data_set;
         fitter<Tdata, Tp, Ts, Tstr> *p_fitter;
         Tp origin_param;
-        mutable bool bstop;
+
+      private:
+        std::vector<Ty> origin_y;
+        std::vector<Ty> y_sigma;
+        std::vector<Te> param_matrix;
+        size_t num_params;
+        size_t num_samples;
+        unsigned long long seed;
+        std::shared_ptr<thread_pool> p_pool;
+        std::atomic<bool> bstop;
+
+      private:
+        bootstrap (const bootstrap &);
+        bootstrap &operator= (const bootstrap &);
 
       public:
         /**
            default construct
          */
-        bootstrap () : p_fitter (NULL)
+        bootstrap () : p_fitter (NULL_PTR), num_params (0), num_samples (0), seed (0), bstop (false)
         {
         }
 
@@ -80,22 +100,55 @@ namespace opt_utilities
          */
         void set_fitter (fitter<Tdata, Tp, Ts, Tstr> &pf)
         {
-            param_pool.clear ();
+            param_matrix.clear ();
+            num_samples = 0;
             p_fitter = &pf;
-            origin_data_set = dynamic_cast<const default_data_set<Tdata> &> (pf.get_data_set ());
+            origin_data_set = default_data_set<Tdata> (pf.get_data_set ());
+            origin_y.resize (origin_data_set.size ());
+            y_sigma.resize (origin_data_set.size ());
+            for (size_t i = 0; i < origin_data_set.size (); ++i)
+                {
+                    const Tdata &d = origin_data_set.get_data (i);
+                    origin_y[i] = d.get_y ();
+                    y_sigma[i] = (d.get_y_upper_err () + d.get_y_lower_err ()) / 2.;
+                }
             origin_param = pf.get_all_params ();
+            num_params = get_size (origin_param);
+        }
+
+        /**
+           set the seed, the resamples are reproducible for a given seed
+         */
+        void set_seed (unsigned long long s)
+        {
+            seed = s;
+        }
+
+        /**
+           resample on n threads
+           \param n the number of threads, 0 for all the cores
+         */
+        void set_num_threads (size_t n)
+        {
+            p_pool.reset (n == 1 ? NULL_PTR : new thread_pool (n));
+        }
+
+        /**
+           Same as set_num_threads, but use an existing thread pool
+         */
+        void set_thread_pool (const std::shared_ptr<thread_pool> &pool)
+        {
+            p_pool = pool;
         }
 
         /**
            reset the estimation
-           reload the data
            restore the parameters
          */
         void reset ()
         {
             if (p_fitter != 0)
                 {
-                    p_fitter->load_data (origin_data_set);
                     p_fitter->set_param_value (origin_param);
                 }
             p_fitter = 0;
@@ -103,26 +156,83 @@ namespace opt_utilities
 
 
         /**
-           resample n times
+           resample n times, the results are appended to the pool
            \param n the times to sample
          */
         void sample (int n)
         {
             bstop = false;
-            if (p_fitter != NULL)
+            if (p_fitter == NULL_PTR)
                 {
-                    for (int i = 0; i < n && !bstop; ++i)
-                        {
-                            sample ();
-                        }
+                    throw opt_exception ("Fitter not_set");
+                }
+            if (n <= 0)
+                {
+                    return;
+                }
+            size_t first = num_samples;
+            param_matrix.resize ((first + n) * num_params);
+            std::vector<char> done (n, 0);
 
-                    p_fitter->load_data (origin_data_set);
-                    p_fitter->set_param_value (origin_param);
+            size_t n_workers = p_pool.get () == NULL_PTR ? 1 : std::min (p_pool->get_num_threads (), size_t (n));
+            std::vector<std::unique_ptr<default_data_set<Tdata>>> data_sets (n_workers);
+            std::vector<std::unique_ptr<fitter<Tdata, Tp, Ts, Tstr>>> fitters (n_workers);
+            std::vector<std::vector<Ty>> y_buffers (n_workers, std::vector<Ty> (origin_y.size ()));
+            for (size_t w = 0; w < n_workers; ++w)
+                {
+                    // a copy of the fitter keeps the settings of its optimizer,
+                    // e.g., the method and the precision; it sees its
+                    // data set through a view, so that redrawing the y values
+                    // does not copy the data set
+                    data_sets[w].reset (new default_data_set<Tdata> (origin_data_set));
+                    fitters[w].reset (new fitter<Tdata, Tp, Ts, Tstr> (*p_fitter));
+                    fitters[w]->load_data (data_set_view<Tdata> (*data_sets[w]));
+                }
+
+            std::atomic<size_t> next (0);
+            size_t nsamples = n;
+            auto worker = [&](size_t w) {
+                for (;;)
+                    {
+                        size_t i = next.fetch_add (1);
+                        if (i >= nsamples || bstop)
+                            {
+                                break;
+                            }
+                        Tp p (sample (*data_sets[w], *fitters[w], y_buffers[w], first + i));
+                        for (size_t j = 0; j < num_params; ++j)
+                            {
+                                param_matrix[(first + i) * num_params + j] = get_element (p, j);
+                            }
+                        done[i] = 1;
+                    }
+            };
+            if (n_workers == 1)
+                {
+                    worker (0);
                 }
             else
                 {
-                    throw opt_exception ("Fitter not_set");
+                    p_pool->parallel_for (n_workers, worker);
+                }
+
+            // drop the resamples skipped after a stop
+            size_t k = first;
+            for (size_t i = 0; i < nsamples; ++i)
+                {
+                    if (done[i])
+                        {
+                            if (k != first + i)
+                                {
+                                    std::copy (param_matrix.begin () + (first + i) * num_params,
+                                               param_matrix.begin () + (first + i + 1) * num_params,
+                                               param_matrix.begin () + k * num_params);
+                                }
+                            ++k;
+                        }
                 }
+            num_samples = k;
+            param_matrix.resize (num_samples * num_params);
         }
 
         void stop ()
@@ -135,64 +245,48 @@ namespace opt_utilities
            \param i the order of parameter
            \return the parameter
          */
-        const Tp &get_param (int n) const
+        Tp get_param (int n) const
         {
-            // return param_pool.at(i);
-            int cnt = 0;
-            for (typename std::list<Tp>::const_iterator i = param_pool.begin (); i != param_pool.end (); ++i)
+            if (n < 0 || size_t (n) >= num_samples)
                 {
-                    if (cnt == n)
-                        {
-                            return *i;
-                        }
-                    ++cnt;
+                    throw opt_exception ("excesses param_pool size");
                 }
-            throw opt_exception ("excesses param_pool size");
-            return *param_pool.begin ();
-        }
-
-        typename std::list<Tp>::const_iterator param_begin () const
-        {
-            return param_pool.begin ();
+            Tp result;
+            resize (result, num_params);
+            for (size_t j = 0; j < num_params; ++j)
+                {
+                    set_element (result, j, param_matrix[n * num_params + j]);
+                }
+            return result;
         }
 
-        typename std::list<Tp>::const_iterator param_end () const
+        /**
+           \return the results as a (samples x params) matrix in row-major order
+         */
+        const std::vector<Te> &get_param_matrix () const
         {
-            return param_pool.end ();
+            return param_matrix;
         }
 
-
         int get_param_pool_size () const
         {
-            return param_pool.size ();
+            return num_samples;
         }
 
       private:
-        Tp sample ()
+        Tp sample (default_data_set<Tdata> &ds, fitter<Tdata, Tp, Ts, Tstr> &f, std::vector<Ty> &y, size_t index)
         {
-            if (p_fitter == NULL)
+            if (!y.empty ())
                 {
-                    throw fitter_not_set ();
+                    normal_generator<counter_rng> gen (counter_rng (seed, index));
+                    gen.fill_normal (&origin_y[0], &y_sigma[0], &y[0], y.size ());
                 }
-            current_data_set = default_data_set<Tdata> ();
-            for (size_t i = 0; i < origin_data_set.size (); ++i)
+            for (size_t i = 0; i < y.size (); ++i)
                 {
-                    Tdata d;
-                    d = origin_data_set.get_data (i);
-                    d.set_y (rand_norm (d.get_y (), (d.get_y_upper_err () + d.get_y_lower_err ()) / 2.));
-                    current_data_set.add_data (d);
-                }
-            p_fitter->load_data (current_data_set);
-            p_fitter->set_param_value (origin_param);
-            param_pool.push_back (p_fitter->fit ());
-#if 0
-      for(size_t i=0;i<(param_pool.back()).size();++i)
-	{
-	  cerr<<param_pool.back()[i]<<",";
-	}
-      std::cerr<<std::endl;
-#endif
-            return param_pool.back ();
+                    ds.data_vec[i].set_y (y[i]);
+                }
+            f.set_param_value (origin_param);
+            return f.fit ();
         }
 
       public:
@@ -202,33 +296,39 @@ namespace opt_utilities
            \param level the confidence level
            \return a std::pair containing the lower and upper boundaries of the confidence interval
          */
-        std::pair<typename element_type_trait<Tp>::element_type, typename element_type_trait<Tp>::element_type>
-        interval (const Tstr &param_name, double level)
+        std::pair<Te, Te> interval (const Tstr &param_name, double level)
         {
             if (p_fitter == NULL)
                 {
                     throw opt_exception ("Fitter not_set");
                 }
-            if (param_pool.empty ())
+            if (num_samples == 0)
                 {
                     throw opt_exception ("Bootstrap not done");
                 }
-            // sample();
-            std::vector<typename element_type_trait<Tp>::element_type> _tmp;
             int order = p_fitter->get_param_order (param_name);
-            for (typename std::list<Tp>::iterator i = param_pool.begin (); i != param_pool.end (); ++i)
-                {
-                    _tmp.push_back ((*i)[order]);
-                }
-            sort (_tmp.begin (), _tmp.end ());
-            std::pair<typename std::vector<typename element_type_trait<Tp>::element_type>::iterator,
-                      typename std::vector<typename element_type_trait<Tp>::element_type>::iterator>
-            itv = equal_range (_tmp.begin (), _tmp.end (), origin_param[order]);
-            int current_param_position = itv.second - _tmp.begin ();
-            // std::cerr<<_tmp.size()<<std::endl;
-            return std::pair<typename element_type_trait<Tp>::element_type, typename element_type_trait<Tp>::element_type> (
-            _tmp.at ((int)((1 - level) * current_param_position)),
-            _tmp.at ((int)(current_param_position + level * (_tmp.size () - current_param_position))));
+            std::vector<Te> _tmp (num_samples);
+            size_t current_param_position = 0;
+            for (size_t i = 0; i < num_samples; ++i)
+                {
+                    _tmp[i] = param_matrix[i * num_params + order];
+                    if (!(origin_param[order] < _tmp[i]))
+                        {
+                            ++current_param_position;
+                        }
+                }
+            // the same order statistics as sorting the whole column
+            size_t lower = (size_t) ((1 - level) * current_param_position);
+            size_t upper = (size_t) (current_param_position + level * (num_samples - current_param_position));
+            if (upper >= num_samples)
+                {
+                    throw opt_exception ("too few bootstrap samples for the confidence level");
+                }
+            std::nth_element (_tmp.begin (), _tmp.begin () + upper, _tmp.end ());
+            Te upper_value = _tmp[upper];
+            std::nth_element (_tmp.begin (), _tmp.begin () + lower, _tmp.begin () + upper);
+            Te lower_value = lower < upper ? _tmp[lower] : upper_value;
+            return std::pair<Te, Te> (lower_value, upper_value);
         }
     };
 }
@@ -6,6 +6,9 @@
 #include <methods/powell/powell_method.hpp>
 #include <methods/lbfgs/lbfgs_method.hpp>
 #include <methods/bfgs/bfgs.hpp>
+#include <methods/levmar/levmar.hpp>
+#include <methods/simplex/simplex.hpp>
+#include <methods/lbfgsb/lbfgsb.hpp>
 #include <methods/gsl_simplex/gsl_simplex.hpp>
 #include <data_sets/default_data_set.hpp>
 #include <data_sets/sorted_data_set.hpp>
@@ -0,0 +1,219 @@
+/**
+   \file random.hpp
+   \brief seedable counter-based random number generator and normal generator
+   \author Junhua Gu
+*/
+
+#ifndef OPT_RANDOM_HPP
+#define OPT_RANDOM_HPP
+#define OPT_HEADER
+#include <cstddef>
+#include <cmath>
+
+namespace opt_utilities
+{
+    /**
+       \brief a counter-based random number generator.
+       The n-th number of a stream is a pure function of (seed, stream, n),
+       so independent streams can be handed to different threads, or
+       to different samples, and the results are reproducible no matter
+       how the work is scheduled.
+       The mixing function is the finalizer of SplitMix64.
+     */
+    class counter_rng
+    {
+      public:
+        typedef unsigned long long result_type;
+
+      private:
+        result_type key;
+        result_type counter;
+
+        static result_type mix (result_type z)
+        {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        static result_type make_key (result_type seed, result_type stream)
+        {
+            return mix (mix (seed + 0x9e3779b97f4a7c15ULL) ^ (stream * 0xd1b54a32d192ed03ULL + 1));
+        }
+
+      public:
+        /**
+           construct a generator
+           \param seed the seed
+           \param stream the index of the stream
+         */
+        counter_rng (result_type seed = 0, result_type stream = 0) : key (make_key (seed, stream)), counter (0)
+        {
+        }
+
+        /**
+           restart the generator on a new (seed, stream) pair
+         */
+        void reset (result_type seed, result_type stream = 0)
+        {
+            key = make_key (seed, stream);
+            counter = 0;
+        }
+
+        /**
+           jump to the n-th number of the current stream
+         */
+        void set_counter (result_type n)
+        {
+            counter = n;
+        }
+
+        /**
+           \return the index of the next number in the current stream
+         */
+        result_type get_counter () const
+        {
+            return counter;
+        }
+
+        /**
+           \return the next 64-bit random integer
+         */
+        result_type operator() ()
+        {
+            return mix (key + 0x9e3779b97f4a7c15ULL * (++counter));
+        }
+
+        static result_type min ()
+        {
+            return 0;
+        }
+
+        static result_type max ()
+        {
+            return ~result_type (0);
+        }
+
+        /**
+           \return a uniform random number in [0,1)
+         */
+        double uniform ()
+        {
+            return ((*this) () >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        /**
+           \return a uniform random number in [x1,x2)
+         */
+        double uniform (double x1, double x2)
+        {
+            return uniform () * (x2 - x1) + x1;
+        }
+    };
+
+    /**
+       \brief normal random numbers by the Box-Muller transform.
+       Every pair of uniform numbers gives two normal numbers, so there is
+       no rejection and only one log and one sqrt per pair.
+       \tparam Engine the uniform generator, anything with a member
+       uniform() returning a number in [0,1), e.g., counter_rng
+     */
+    template <typename Engine = counter_rng> class normal_generator
+    {
+      private:
+        enum
+        {
+            block_size = 128
+        };
+
+        Engine engine;
+        bool has_spare;
+        double spare;
+        double u[block_size];
+        double z[block_size];
+
+        // z[0..m) = standard normal numbers, m must be even
+        void fill_block (size_t m)
+        {
+            for (size_t i = 0; i < m; ++i)
+                {
+                    u[i] = engine.uniform ();
+                }
+            const double two_pi = 6.283185307179586476925286766559;
+            for (size_t i = 0; i < m; i += 2)
+                {
+                    double r = std::sqrt (-2 * std::log (1 - u[i]));
+                    double t = two_pi * u[i + 1];
+                    z[i] = r * std::cos (t);
+                    z[i + 1] = r * std::sin (t);
+                }
+        }
+
+      public:
+        /**
+           \param e the uniform generator, which is copied
+         */
+        explicit normal_generator (const Engine &e = Engine ()) : engine (e), has_spare (false), spare (0)
+        {
+        }
+
+        /**
+           \return the uniform generator in use
+         */
+        Engine &get_engine ()
+        {
+            return engine;
+        }
+
+        /**
+           \return a standard normal random number
+         */
+        double operator() ()
+        {
+            if (has_spare)
+                {
+                    has_spare = false;
+                    return spare;
+                }
+            fill_block (2);
+            has_spare = true;
+            spare = z[1];
+            return z[0];
+        }
+
+        /**
+           \return a normal random number
+           \param mean the mean
+           \param sigma the standard deviation
+         */
+        template <typename T> T operator() (T mean, T sigma)
+        {
+            return mean + sigma * T ((*this) ());
+        }
+
+        /**
+           out[i]=mean[i]+sigma[i]*N(0,1) for i in [0,n)
+           The normal numbers are made in blocks, and do not use the
+           spare number left by operator().
+           \param mean the means
+           \param sigma the standard deviations
+           \param out the output, may be the same array as mean
+           \param n the number of elements
+         */
+        template <typename T> void fill_normal (const T *mean, const T *sigma, T *out, size_t n)
+        {
+            for (size_t b = 0; b < n; b += block_size)
+                {
+                    size_t m = n - b < size_t (block_size) ? n - b : size_t (block_size);
+                    fill_block ((m + 1) / 2 * 2);
+                    for (size_t i = 0; i < m; ++i)
+                        {
+                            out[b + i] = mean[b + i] + sigma[b + i] * T (z[i]);
+                        }
+                }
+        }
+    };
+}
+
+#endif
+// EOF
@@ -169,6 +169,44 @@ namespace opt_utilities
                 }
             return pm1->eval (x, p1) + pm2->eval (x, p2);
         }
+
+        void do_eval_grad (const Tx &x, const Tp &param, Ty &y, Tp &dy_dp)
+        {
+            if (!pm1 || !pm2)
+                {
+                    throw opt_exception ("incomplete model!");
+                }
+            Tp p1 (pm1->get_num_params ());
+            Tp p2 (pm2->get_num_params ());
+            int i = 0;
+            int j = 0;
+            for (i = 0; i < pm1->get_num_params (); ++i, ++j)
+                {
+                    set_element (p1, i, get_element (param, j));
+                }
+            for (i = 0; i < pm2->get_num_params (); ++i, ++j)
+                {
+                    set_element (p2, i, get_element (param, j));
+                }
+            Ty y1, y2;
+            Tp g1, g2;
+            pm1->eval_grad_reformed (x, p1, y1, g1);
+            pm2->eval_grad_reformed (x, p2, y2, g2);
+            y = y1 + y2;
+            for (i = 0, j = 0; i < pm1->get_num_params (); ++i, ++j)
+                {
+                    set_element (dy_dp, j, get_element (g1, i));
+                }
+            for (i = 0; i < pm2->get_num_params (); ++i, ++j)
+                {
+                    set_element (dy_dp, j, get_element (g2, i));
+                }
+        }
+
+        bool do_provides_grad () const
+        {
+            return pm1 && pm2 && pm1->provides_grad () && pm2->provides_grad ();
+        }
     };
 
     template <typename Tdata, typename Tp, typename Tstr>
@@ -47,6 +47,43 @@ namespace opt_utilities
             return bkg + S0 * pow (1 + (x * x) / (r_c * r_c), -3 * beta + static_cast<T> (.5));
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T S0 = std::abs (get_element (param, 0));
+            const T r_c = get_element (param, 1);
+            const T beta = std::abs (get_element (param, 2));
+            const T bkg = std::abs (get_element (param, 3));
+            const T rc2 = r_c * r_c;
+            const T index = -3 * beta + static_cast<T> (.5);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = bkg + S0 * pow (1 + (xs[i] * xs[i]) / rc2, index);
+                }
+        }
+
+        void do_eval_grad (const T &x, const std::vector<T> &param, T &y, std::vector<T> &dy_dp)
+        {
+            T S0 = std::abs (get_element (param, 0));
+            T r_c = get_element (param, 1);
+            T beta = std::abs (get_element (param, 2));
+            T bkg = std::abs (get_element (param, 3));
+            T t = 1 + (x * x) / (r_c * r_c);
+            T index = -3 * beta + static_cast<T> (.5);
+            T tp = pow (t, index);
+            y = bkg + S0 * tp;
+            // d|p|/dp is taken as sign(p)
+            set_element (dy_dp, 0, get_element (param, 0) < 0 ? -tp : tp);
+            set_element (dy_dp, 1, S0 * index * tp / t * (-2 * x * x / (r_c * r_c * r_c)));
+            T dbeta = -3 * S0 * tp * log (t);
+            set_element (dy_dp, 2, get_element (param, 2) < 0 ? -dbeta : dbeta);
+            set_element (dy_dp, 3, get_element (param, 3) < 0 ? T (-1) : T (1));
+        }
+
+        bool do_provides_grad () const
+        {
+            return true;
+        }
+
         std::string do_get_information () const
         {
             return "<math xmlns=\"http://www.w3.org/1998/Math/MathML\" display=\"block\" "
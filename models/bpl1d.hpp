@@ -51,6 +51,42 @@ namespace opt_utilities
                 }
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T x_b = get_element (param, 0);
+            const T f_b = get_element (param, 1);
+            const T gamma1 = get_element (param, 2);
+            const T gamma2 = get_element (param, 3);
+            const T norm1 = pow (x_b, gamma1);
+            const T norm2 = pow (x_b, gamma2);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    const T x = xs[i];
+                    out[i] = x < x_b ? f_b * pow (x, gamma1) / norm1 : f_b * pow (x, gamma2) / norm2;
+                }
+        }
+
+        void do_eval_grad (const T &x, const std::vector<T> &param, T &y, std::vector<T> &dy_dp)
+        {
+            T x_b = get_element (param, 0);
+            T f_b = get_element (param, 1);
+            T gamma1 = get_element (param, 2);
+            T gamma2 = get_element (param, 3);
+            T gamma = x < x_b ? gamma1 : gamma2;
+            T r = pow (x, gamma) / pow (x_b, gamma);
+            y = f_b * r;
+            set_element (dy_dp, 0, -gamma * y / x_b);
+            set_element (dy_dp, 1, r);
+            T dgamma = x == 0 ? T (0) : y * (log (x) - log (x_b));
+            set_element (dy_dp, 2, x < x_b ? dgamma : T (0));
+            set_element (dy_dp, 3, x < x_b ? T (0) : dgamma);
+        }
+
+        bool do_provides_grad () const
+        {
+            return true;
+        }
+
 
       private:
         std::string do_get_information () const
@@ -41,6 +41,16 @@ namespace opt_utilities
             return norm * sqrt (kT) * exp (-x / kT);
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T kT = get_element (param, 1);
+            const T A = get_element (param, 0) * sqrt (kT);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = A * exp (-xs[i] / kT);
+                }
+        }
+
       private:
         std::string do_get_information () const
         {
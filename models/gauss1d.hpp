@@ -44,6 +44,36 @@ namespace opt_utilities
             return N * exp (-y * y / 2);
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T N = get_element (param, 0);
+            const T x0 = get_element (param, 1);
+            const T sigma = get_element (param, 2);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    const T y = (xs[i] - x0) / sigma;
+                    out[i] = N * exp (-y * y / 2);
+                }
+        }
+
+        void do_eval_grad (const T &x, const std::vector<T> &param, T &y, std::vector<T> &dy_dp)
+        {
+            T N = get_element (param, 0);
+            T x0 = get_element (param, 1);
+            T sigma = get_element (param, 2);
+            T u = (x - x0) / sigma;
+            T e = exp (-u * u / 2);
+            y = N * e;
+            set_element (dy_dp, 0, e);
+            set_element (dy_dp, 1, y * u / sigma);
+            set_element (dy_dp, 2, y * u * u / sigma);
+        }
+
+        bool do_provides_grad () const
+        {
+            return true;
+        }
+
       private:
         std::string do_get_information () const
         {
@@ -42,6 +42,28 @@ namespace opt_utilities
             return x * get_element (param, 0) + get_element (param, 1);
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T k = get_element (param, 0);
+            const T b = get_element (param, 1);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = xs[i] * k + b;
+                }
+        }
+
+        void do_eval_grad (const T &x, const std::vector<T> &param, T &y, std::vector<T> &dy_dp)
+        {
+            y = x * get_element (param, 0) + get_element (param, 1);
+            set_element (dy_dp, 0, x);
+            set_element (dy_dp, 1, T (1));
+        }
+
+        bool do_provides_grad () const
+        {
+            return true;
+        }
+
       private:
         std::string do_get_information () const
         {
@@ -9,6 +9,7 @@
 #define OPT_HEADER
 #include <core/fitter.hpp>
 #include <cmath>
+#include <type_traits>
 
 namespace opt_utilities
 {
@@ -163,6 +164,60 @@ namespace opt_utilities
                 }
             return pm1->eval (x, p1) * pm2->eval (x, p2);
         }
+
+        void do_eval_grad (const Tx &x, const Tp &param, Ty &y, Tp &dy_dp)
+        {
+            if (!pm1 || !pm2)
+                {
+                    throw opt_exception ("incomplete model!");
+                }
+            Tp p1 (pm1->get_num_params ());
+            Tp p2 (pm2->get_num_params ());
+            int i = 0;
+            int j = 0;
+            for (i = 0; i < pm1->get_num_params (); ++i, ++j)
+                {
+                    set_element (p1, i, get_element (param, j));
+                }
+            for (i = 0; i < pm2->get_num_params (); ++i, ++j)
+                {
+                    set_element (p2, i, get_element (param, j));
+                }
+            Ty y1, y2;
+            Tp g1, g2;
+            pm1->eval_grad_reformed (x, p1, y1, g1);
+            pm2->eval_grad_reformed (x, p2, y2, g2);
+            y = y1 * y2;
+            // product rule
+            for (i = 0, j = 0; i < pm1->get_num_params (); ++i, ++j)
+                {
+                    set_element (dy_dp, j, scale (get_element (g1, i), y2));
+                }
+            for (i = 0; i < pm2->get_num_params (); ++i, ++j)
+                {
+                    set_element (dy_dp, j, scale (get_element (g2, i), y1));
+                }
+        }
+
+        bool do_provides_grad () const
+        {
+            return std::is_arithmetic<Ty>::value && pm1 && pm2 && pm1->provides_grad () && pm2->provides_grad ();
+        }
+
+      private:
+        typedef typename element_type_trait<Tp>::element_type Te;
+
+        template <typename W>
+        static Te scale (const Te &d, const W &w, typename std::enable_if<std::is_arithmetic<W>::value>::type * = 0)
+        {
+            return d * w;
+        }
+
+        template <typename W>
+        static Te scale (const Te &, const W &, typename std::enable_if<!std::is_arithmetic<W>::value>::type * = 0)
+        {
+            throw gradient_not_available ();
+        }
     };
 
     template <typename Tdata, typename Tp, typename Tstr>
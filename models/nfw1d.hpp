@@ -43,6 +43,17 @@ namespace opt_utilities
             return rho0 / (x / rs * (1 + x / rs) * (1 + x / rs));
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T rho0 = get_element (param, 0);
+            const T rs = get_element (param, 1);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    const T r = xs[i] / rs;
+                    out[i] = rho0 / (r * (1 + r) * (1 + r));
+                }
+        }
+
         std::string do_get_information () const
         {
             return "NFW model\n"
@@ -40,6 +40,32 @@ namespace opt_utilities
             return A * pow (x, gamma);
         }
 
+        void do_eval_batch (const T *xs, size_t n, const std::vector<T> &param, T *out)
+        {
+            const T A = get_element (param, 0);
+            const T gamma = get_element (param, 1);
+            for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = A * pow (xs[i], gamma);
+                }
+        }
+
+        void do_eval_grad (const T &x, const std::vector<T> &param, T &y, std::vector<T> &dy_dp)
+        {
+            T A = get_element (param, 0);
+            T gamma = get_element (param, 1);
+            T xg = pow (x, gamma);
+            y = A * xg;
+            set_element (dy_dp, 0, xg);
+            // y*log(x) tends to 0 at x=0, where log(x) is not finite
+            set_element (dy_dp, 1, x == 0 ? T (0) : y * log (x));
+        }
+
+        bool do_provides_grad () const
+        {
+            return true;
+        }
+
       private:
         std::string do_get_information () const
         {
@@ -59,6 +59,23 @@ namespace opt_utilities
             return result;
         }
 
+        void do_eval_grad (const T &x, const std::vector<T> &param, T &y, std::vector<T> &dy_dp)
+        {
+            y = T (0);
+            T xn (1);
+            for (int i = 0; i <= n; ++i)
+                {
+                    y += get_element (param, i) * xn;
+                    set_element (dy_dp, i, xn);
+                    xn *= x;
+                }
+        }
+
+        bool do_provides_grad () const
+        {
+            return true;
+        }
+
       private:
         std::string do_get_information () const
         {
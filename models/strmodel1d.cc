@@ -1,9 +1,18 @@
 #include "strmodel1d.hpp"
 
-using namespace mu;
 using namespace std;
 using namespace opt_utilities;
 
+namespace
+{
+  //the buffers of the evaluations, one set per thread;
+  //the values and the gradients have their own workspaces, so that
+  //each keeps the scalars of its program between the calls
+  thread_local expression_workspace<double> value_workspace;
+  thread_local expression_workspace<double> grad_workspace;
+  thread_local vector<double*> grad_outs;
+}
+
 strmodel1d* strmodel1d::do_clone()const
 {
   return new strmodel1d(*this);
@@ -11,73 +20,88 @@ strmodel1d* strmodel1d::do_clone()const
 
 strmodel1d::strmodel1d()
 {
-  set_buildin_fun();
 }
 
 strmodel1d::strmodel1d(const strmodel1d& rhs)
-  :par_vec(rhs.par_vec),
+  :model<data<double,double>,vector<double>,string>(rhs),
+   p_program(rhs.p_program),
+   p_grad_program(rhs.p_grad_program),
    par_names(rhs.par_names),
    expr(rhs.expr),
    var_name(rhs.var_name)
-   
 {
-  set_buildin_fun();
-  set_expr(expr,par_names,var_name);
 }
 
 strmodel1d& strmodel1d::operator=(const strmodel1d& rhs)
 {
-  set_buildin_fun();
+  model<data<double,double>,vector<double>,string>::operator=(rhs);
+  p_program=rhs.p_program;
+  p_grad_program=rhs.p_grad_program;
   expr=rhs.expr;
   par_names=rhs.par_names;
   var_name=rhs.var_name;
-  par_vec=rhs.par_vec;
-  set_expr(expr,par_names,var_name);
   return *this;
 }
 
-void strmodel1d::set_buildin_fun()
-{
-  mp.DefineFun("sin",sin);
-  mp.DefineFun("cos",cos);
-  mp.DefineFun("exp",exp);
-  mp.DefineFun("tan",tan);
-  mp.DefineFun("log",log);
-}
-
 
 void strmodel1d::set_expr(const string& _expr,
 			  const std::vector<std::string>& _par_names,
 			  const std::string& _var_name)
 {
+  expression<double> e;
+  e.parse(_expr,_par_names,_var_name);
+  vector<size_t> roots(1,e.get_root());
+  p_program.reset(new compiled_expression<double>(e,roots));
+  for(size_t i=0;i<_par_names.size();++i)
+    {
+      roots.push_back(e.derivative(e.get_root(),i));
+    }
+  p_grad_program.reset(new compiled_expression<double>(e,roots));
   expr=_expr;
   par_names=_par_names;
   var_name=_var_name;
   this->clear_param_info();
-  par_vec.resize(par_names.size());
-  mp.ClearVar();
-  //  mp.ClearFun();
-  for(unsigned int i=0;i<par_vec.size();++i)
+  for(unsigned int i=0;i<par_names.size();++i)
     {
-      mp.DefineVar(par_names[i].c_str(),&par_vec[i]);
       this->push_param_info(param_info<std::vector<double> >(par_names[i],0));
     }
-  mp.DefineVar(var_name.c_str(),&x);
-  mp.SetExpr(expr.c_str());
 }
 
 
 double strmodel1d::do_eval(const double& _x,const vector<double>& p)
 {
-  for(unsigned int i=0;i<par_vec.size();++i)
+  double result;
+  do_eval_batch(&_x,1,p,&result);
+  return result;
+}
+
+void strmodel1d::do_eval_batch(const double* xs,size_t n,const vector<double>& p,double* out)
+{
+  if(!p_program)
     {
-      //get_element(par_vec,i)=get_element(p,i);
-      set_element(par_vec,i,get_element(p,i));
-      //      cout<<par_vec[i]<<" ";
+      throw expression_error("the expression is not set");
     }
-  x=_x;
-  //  cout<<x<<" ";
-  double result(mp.Eval());
-  //  cout<<result<<endl;
-  return result;
+  double* outs[1]={out};
+  p_program->eval(p.empty()?NULL:&p[0],xs,n,outs,value_workspace);
+}
+
+void strmodel1d::do_eval_grad(const double& x,const vector<double>& p,double& y,vector<double>& dy_dp)
+{
+  if(!p_grad_program)
+    {
+      throw expression_error("the expression is not set");
+    }
+  dy_dp.resize(p.size());
+  grad_outs.resize(p.size()+1);
+  grad_outs[0]=&y;
+  for(size_t i=0;i<p.size();++i)
+    {
+      grad_outs[i+1]=&dy_dp[i];
+    }
+  p_grad_program->eval(p.empty()?NULL:&p[0],&x,1,&grad_outs[0],grad_workspace);
+}
+
+bool strmodel1d::do_provides_grad()const
+{
+  return static_cast<bool>(p_grad_program);
 }
@@ -1,6 +1,6 @@
 /**
    \file strmodel1d.hpp
-   \brief evaluating model from string, by usig muparser
+   \brief evaluating model from string, compiled by expression.hpp
    \author Junhua Gu
  */
 
@@ -9,24 +9,37 @@
 #define STRMODEL1D_HPP
 #define OPT_HEADER
 #include <core/fitter.hpp>
+#include <math/expression.hpp>
 #include <cmath>
 #include <sstream>
 #include <cassert>
-#include <muParser.h>
+#include <memory>
 #include <vector>
 #include <string>
 
-class strmodel1d : public opt_utilities::model<data<double, double>, std::vector<double>, std::string>
+/**
+   \brief A model given as an expression of the parameters and the self-var,
+   in the syntax of muParser, see opt_utilities::expression.
+   The expression is parsed and compiled once by set_expr, and the copies
+   share the compiled program. The buffers of the evaluation are kept
+   per thread, so do_eval and do_eval_batch are reentrant, as required by
+   fitter::set_parallel.
+   do_eval_batch evaluates the whole column of self-vars at once, with the
+   subexpressions of the parameters computed only once.
+   The derivatives with respect to every parameter are differentiated
+   symbolically and compiled together with the value, so the statistics
+   get exact gradients through do_eval_grad.
+ */
+class strmodel1d : public opt_utilities::model<opt_utilities::data<double, double>, std::vector<double>, std::string>
 {
   private:
-    mu::Parser mp;
+    std::shared_ptr<const opt_utilities::compiled_expression<double>> p_program;
+    // the value followed by the derivatives
+    std::shared_ptr<const opt_utilities::compiled_expression<double>> p_grad_program;
     strmodel1d *do_clone () const;
-    std::vector<double> par_vec;
     std::vector<std::string> par_names;
     std::string expr;
     std::string var_name;
-    double x;
-    void set_buildin_fun ();
 
     const char *do_get_type_name () const
     {
@@ -35,11 +48,20 @@ class strmodel1d : public opt_utilities::model<data<double, double>, std::vector
 
   public:
     double do_eval (const double &x, const std::vector<double> &p);
+    void do_eval_batch (const double *xs, size_t n, const std::vector<double> &p, double *out);
+    void do_eval_grad (const double &x, const std::vector<double> &p, double &y, std::vector<double> &dy_dp);
+    bool do_provides_grad () const;
     strmodel1d ();
     strmodel1d (const strmodel1d &rhs);
     strmodel1d &operator= (const strmodel1d &rhs);
 
 
+    /**
+       parse and compile an expression, the parameters are set to 0
+       \param _expr the expression
+       \param _par_names the names of the parameters
+       \param _var_name the name of the self-var
+     */
     void set_expr (const std::string &_expr, const std::vector<std::string> &_par_names, const std::string &_var_name);
 };
 
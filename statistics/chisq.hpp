@@ -8,6 +8,7 @@
 #define CHI_SQ_HPP
 #define OPT_HEADER
 #include <core/fitter.hpp>
+#include <core/residual_provider.hpp>
 #include <iostream>
 #include <vector>
 #include <misc/optvec.hpp>
@@ -27,7 +28,7 @@ namespace opt_utilities
        \tparam Tstr the type of the string used
      */
     template <typename Tdata, typename Tp, typename Ts, typename Tstr>
-    class chisq : public statistic<Tdata, Tp, Ts, Tstr>
+    class chisq : public statistic<Tdata, Tp, Ts, Tstr>, public residual_provider<Ts, Tp>
     {
       public:
         typedef typename Tdata::Tx Tx;
@@ -82,13 +83,25 @@ namespace opt_utilities
                         }
                 }
 
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
             Ts result (0);
-            for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
+            if (ds.is_columnar ())
+                {
+                    const Ty *ys = ds.get_y_column ();
+                    const Ty *yus = ds.get_y_upper_err_column ();
+                    const Ty *ms = &model_y[0];
+                    result = this->sum_over_data (ds.size (), [ys, yus, ms](size_t i) {
+                        Ty chi = (ys[i] - ms[i]) / yus[i];
+                        return Ts (chi * chi);
+                    });
+                }
+            else
                 {
-                    Ty chi = (this->get_data_set ().get_data (i).get_y () -
-                              this->eval_model (this->get_data_set ().get_data (i).get_x (), p)) /
-                             this->get_data_set ().get_data (i).get_y_upper_err ();
-                    result += chi * chi;
+                    result = this->sum_over_data (ds.size (), [&ds, &model_y](size_t i) {
+                        Ty chi = (ds.get_data (i).get_y () - model_y[i]) / ds.get_data (i).get_y_upper_err ();
+                        return Ts (chi * chi);
+                    });
                 }
             if (verb)
                 {
@@ -107,13 +120,59 @@ namespace opt_utilities
 
             return result;
         }
+
+      private:
+        Tp do_gradient (const Tp &p)
+        {
+            if (!this->analytic_gradient_available ())
+                {
+                    return this->numeric_gradient (p);
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            return this->sum_gradient_over_data (p, [fields](size_t i, const Ty &y_model) {
+                const Ty &sigma = fields.y_upper_err (i);
+                return -2 * (fields.y (i) - y_model) / (sigma * sigma);
+            });
+        }
+
+        size_t do_num_residuals ()
+        {
+            return this->get_data_set ().size ();
+        }
+
+        void do_eval_residuals (const Tp &p, Ts *r)
+        {
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
+            const data_fields<Tdata> fields (ds);
+            for (size_t i = 0; i < ds.size (); ++i)
+                {
+                    r[i] = (fields.y (i) - model_y[i]) / fields.y_upper_err (i);
+                }
+        }
+
+        bool do_eval_jacobian (const Tp &p, Ts *r, Ts *jac)
+        {
+            if (!this->analytic_gradient_available ())
+                {
+                    return false;
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            this->fill_residual_jacobian (p, r, jac, [fields](size_t i, const Ty &y_model, Ts &ri) {
+                const Ty &sigma = fields.y_upper_err (i);
+                ri = (fields.y (i) - y_model) / sigma;
+                return -1 / sigma;
+            });
+            return true;
+        }
     };
 
 #if 1
 
     template <>
     class chisq<data<double, double>, std::vector<double>, double, std::string>
-    : public statistic<data<double, double>, std::vector<double>, double, std::string>
+    : public statistic<data<double, double>, std::vector<double>, double, std::string>,
+      public residual_provider<double, std::vector<double>>
     {
       public:
         typedef double Ty;
@@ -139,6 +198,73 @@ namespace opt_utilities
             return "chi^2 statistics (specialized for double)";
         }
 
+        /**
+           the contribution of one data point to the chi^2
+         */
+        Ty chi_sq (Tx x, Tx x_lower_err, Tx x_upper_err, Ty y_obs, Ty y_lower_err, Ty y_upper_err, Ty y_model)
+        {
+            Ty c = chi (x, x_lower_err, x_upper_err, y_obs, y_lower_err, y_upper_err, y_model);
+            return c * c;
+        }
+
+        /**
+           the residual of one data point, chi_sq is its square
+         */
+        Ty chi (Tx x, Tx x_lower_err, Tx x_upper_err, Ty y_obs, Ty y_lower_err, Ty y_upper_err, Ty y_model)
+        {
+#ifdef HAVE_X_ERROR
+            Tx x1 = x - x_lower_err;
+            Tx x2 = x + x_upper_err;
+            Ty errx1 = (this->eval_model_reformed (x1) - y_model);
+            Ty errx2 = (this->eval_model_reformed (x2) - y_model);
+            // Ty errx=0;
+#else
+            // the x errors are only used with HAVE_X_ERROR
+            (void)x;
+            (void)x_lower_err;
+            (void)x_upper_err;
+            Ty errx1 = 0;
+            Ty errx2 = 0;
+#endif
+            Ty y_err;
+
+            Ty errx = 0;
+            if (errx1 < errx2)
+                {
+                    if (y_obs < y_model)
+                        {
+                            errx = errx1 > 0 ? errx1 : -errx1;
+                        }
+                    else
+                        {
+                            errx = errx2 > 0 ? errx2 : -errx2;
+                        }
+                }
+            else
+                {
+                    if (y_obs < y_model)
+                        {
+                            errx = errx2 > 0 ? errx2 : -errx2;
+                        }
+                    else
+                        {
+                            errx = errx1 > 0 ? errx1 : -errx1;
+                        }
+                }
+
+
+            if (y_model > y_obs)
+                {
+                    y_err = y_upper_err;
+                }
+            else
+                {
+                    y_err = y_lower_err;
+                }
+
+            return (y_obs - y_model) / std::sqrt (y_err * y_err + errx * errx);
+        }
+
       public:
         void verbose (bool v)
         {
@@ -171,72 +297,29 @@ namespace opt_utilities
                         }
                 }
 
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
             Ty result (0);
-            for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
+            if (ds.is_columnar ())
                 {
-
-#ifdef HAVE_X_ERROR
-                    Tx x1 = this->get_data_set ().get_data (i).get_x () -
-                            this->get_data_set ().get_data (i).get_x_lower_err ();
-                    Tx x2 = this->get_data_set ().get_data (i).get_x () +
-                            this->get_data_set ().get_data (i).get_x_upper_err ();
-                    Tx x = this->get_data_set ().get_data (i).get_x ();
-                    Ty errx1 = (this->eval_model (x1, p) - this->eval_model (x, p));
-                    Ty errx2 = (this->eval_model (x2, p) - this->eval_model (x, p));
-                    // Ty errx=0;
-#else
-                    Ty errx1 = 0;
-                    Ty errx2 = 0;
-#endif
-
-                    Ty y_model = this->eval_model (this->get_data_set ().get_data (i).get_x (), p);
-                    Ty y_obs = this->get_data_set ().get_data (i).get_y ();
-                    Ty y_err;
-
-                    Ty errx = 0;
-                    if (errx1 < errx2)
-                        {
-                            if (y_obs < y_model)
-                                {
-                                    errx = errx1 > 0 ? errx1 : -errx1;
-                                }
-                            else
-                                {
-                                    errx = errx2 > 0 ? errx2 : -errx2;
-                                }
-                        }
-                    else
-                        {
-                            if (y_obs < y_model)
-                                {
-                                    errx = errx2 > 0 ? errx2 : -errx2;
-                                }
-                            else
-                                {
-                                    errx = errx1 > 0 ? errx1 : -errx1;
-                                }
-                        }
-
-
-                    if (y_model > y_obs)
-                        {
-                            y_err = this->get_data_set ().get_data (i).get_y_upper_err ();
-                        }
-                    else
-                        {
-                            y_err = this->get_data_set ().get_data (i).get_y_lower_err ();
-                        }
-
-                    Ty chi = (y_obs - y_model) / std::sqrt (y_err * y_err + errx * errx);
-
-                    //	  Ty
-                    //chi=(this->get_data_set().get_data(i).get_y()-this->eval_model(this->get_data_set().get_data(i).get_x(),p));
-                    //	  cerr<<chi<<"\n";
-                    result += chi * chi;
-                    // std::cerr<<chi<<std::endl;
-                    // cerr<<this->eval_model(this->get_data_set()[i].x,p)<<endl;
-                    // cerr<<this->get_data_set()[i].y_upper_err<<endl;
-                    //	  cerr<<this->get_data_set()[i].x<<"\t"<<this->get_data_set()[i].y<<"\t"<<this->eval_model(this->get_data_set()[i].x,p)<<endl;
+                    const Tx *xs = ds.get_x_column ();
+                    const Tx *xls = ds.get_x_lower_err_column ();
+                    const Tx *xus = ds.get_x_upper_err_column ();
+                    const Ty *ys = ds.get_y_column ();
+                    const Ty *yls = ds.get_y_lower_err_column ();
+                    const Ty *yus = ds.get_y_upper_err_column ();
+                    const Ty *ms = &model_y[0];
+                    result = this->sum_over_data (ds.size (), [=](size_t i) {
+                        return chi_sq (xs[i], xls[i], xus[i], ys[i], yls[i], yus[i], ms[i]);
+                    });
+                }
+            else
+                {
+                    result = this->sum_over_data (ds.size (), [this, &ds, &model_y](size_t i) {
+                        const Tdata &d = ds.get_data (i);
+                        return chi_sq (d.get_x (), d.get_x_lower_err (), d.get_x_upper_err (), d.get_y (),
+                                       d.get_y_lower_err (), d.get_y_upper_err (), model_y[i]);
+                    });
                 }
             if (verb)
                 {
@@ -254,6 +337,65 @@ namespace opt_utilities
 
             return result;
         }
+
+      private:
+        Tp do_gradient (const Tp &p)
+        {
+#ifdef HAVE_X_ERROR
+            return this->numeric_gradient (p);
+#else
+            if (!this->analytic_gradient_available ())
+                {
+                    return this->numeric_gradient (p);
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            return this->sum_gradient_over_data (p, [fields](size_t i, Ty y_model) {
+                Ty y_obs = fields.y (i);
+                Ty y_err = y_model > y_obs ? fields.y_upper_err (i) : fields.y_lower_err (i);
+                return -2 * (y_obs - y_model) / (y_err * y_err);
+            });
+#endif
+        }
+
+        size_t do_num_residuals ()
+        {
+            return this->get_data_set ().size ();
+        }
+
+        void do_eval_residuals (const Tp &p, Ts *r)
+        {
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
+            const data_fields<Tdata> fields (ds);
+            for (size_t i = 0; i < ds.size (); ++i)
+                {
+                    r[i] = chi (fields.x (i), fields.x_lower_err (i), fields.x_upper_err (i), fields.y (i),
+                                fields.y_lower_err (i), fields.y_upper_err (i), model_y[i]);
+                }
+        }
+
+        bool do_eval_jacobian (const Tp &p, Ts *r, Ts *jac)
+        {
+#ifdef HAVE_X_ERROR
+            (void)p;
+            (void)r;
+            (void)jac;
+            return false;
+#else
+            if (!this->analytic_gradient_available ())
+                {
+                    return false;
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            this->fill_residual_jacobian (p, r, jac, [fields](size_t i, Ty y_model, Ts &ri) {
+                Ty y_obs = fields.y (i);
+                Ty y_err = y_model > y_obs ? fields.y_upper_err (i) : fields.y_lower_err (i);
+                ri = (y_obs - y_model) / y_err;
+                return -1 / y_err;
+            });
+            return true;
+#endif
+        }
     };
 #endif
 
@@ -294,13 +436,14 @@ namespace opt_utilities
 
         Ts do_eval (const Tp &p)
         {
+            const std::vector<Ty> &model_ys = this->eval_model_on_data_set (p);
             Ts result (0);
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
                     Ty chi (this->get_data_set ().get_data (0).get_y ().size ());
+                    const Ty &model_y = model_ys[i];
                     for (int j = 0; j < chi.size (); ++j)
                         {
-                            Ty model_y (this->eval_model (this->get_data_set ().get_data (i).get_x (), p));
                             if (model_y[j] > this->get_data_set ().get_data (i).get_y ()[j])
                                 {
                                     chi[j] = (this->get_data_set ().get_data (i).get_y ()[j] - model_y[j]) /
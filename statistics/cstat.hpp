@@ -63,15 +63,30 @@ namespace opt_utilities
         Ts do_eval (const Tp &p)
         {
             Ts result (0);
+            const std::vector<Ty> &model_ys = this->eval_model_on_data_set (p);
+            const data_fields<Tdata> fields (this->get_data_set ());
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
-                    Ty model_y = this->eval_model (this->get_data_set ().get_data (i).get_x (), p);
+                    const Ty &model_y = model_ys[i];
                     result -=
-                    contract (this->get_data_set ().get_data (i).get_y (), std::log (model_y), result);
+                    contract (fields.y (i), std::log (model_y), result);
                 }
 
             return result;
         }
+
+      private:
+        Tp do_gradient (const Tp &p)
+        {
+            if (!this->analytic_gradient_available ())
+                {
+                    return this->numeric_gradient (p);
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            return this->sum_gradient_over_data (p, [fields](size_t i, const Ty &y_model) {
+                return -fields.y (i) / y_model;
+            });
+        }
     };
 
     /**
@@ -123,11 +138,13 @@ namespace opt_utilities
                     // std::cout<<p[4]<<std::endl;
                     return 1e99;
                 }
+            const std::vector<Ty> &model_ys = this->eval_model_on_data_set (p);
+            const data_fields<Tdata> fields (this->get_data_set ());
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
-                    Ty model_y = this->eval_model (this->get_data_set ().get_data (i).get_x (), p);
+                    const Ty &model_y = model_ys[i];
                     result -=
-                    contract1 (this->get_data_set ().get_data (i).get_y (), std::log (model_y), result);
+                    contract1 (fields.y (i), std::log (model_y), result);
                 }
 
             return result;
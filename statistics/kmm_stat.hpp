@@ -69,10 +69,11 @@ namespace opt_utilities
                     throw opt_exception ("model is not a kmm component");
                 }
 
+            const optvec<T> &full_p = this->prepare_param (p);
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
                     optvec<T> unsummed_possibility (
-                    kmm->eval_unsumed (this->get_data_set ().get_data (i).get_x (), p));
+                    kmm->eval_unsumed (this->get_data_set ().get_data (i).get_x (), full_p));
                     T maxp = *max_element (unsummed_possibility.begin (), unsummed_possibility.end ());
                     T logp = std::log (maxp);
                     result -= this->get_data_set ().get_data (i).get_y ()[0] * logp;
@@ -8,6 +8,7 @@
 #define LEAST_SQ_HPP
 #define OPT_HEADER
 #include <core/fitter.hpp>
+#include <core/residual_provider.hpp>
 #include <misc/optvec.hpp>
 #include <iostream>
 #include <vector>
@@ -27,7 +28,7 @@ namespace opt_utilities
        \tparam Tstr the type of the string used
     */
     template <typename Tdata, typename Tp, typename Ts, typename Tstr>
-    class leastsq : public statistic<Tdata, Tp, Ts, Tstr>
+    class leastsq : public statistic<Tdata, Tp, Ts, Tstr>, public residual_provider<Ts, Tp>
     {
       private:
         bool verb;
@@ -81,12 +82,24 @@ namespace opt_utilities
                 }
 
 
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
             Ts result (0);
-            for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
+            if (ds.is_columnar ())
+                {
+                    const Ty *ys = ds.get_y_column ();
+                    const Ty *ms = &model_y[0];
+                    result = this->sum_over_data (ds.size (), [ys, ms](size_t i) {
+                        Ty chi = (ys[i] - ms[i]);
+                        return Ts (chi * chi);
+                    });
+                }
+            else
                 {
-                    Ty chi = (this->get_data_set ().get_data (i).get_y () -
-                              this->eval_model (this->get_data_set ().get_data (i).get_x (), p));
-                    result += chi * chi;
+                    result = this->sum_over_data (ds.size (), [&ds, &model_y](size_t i) {
+                        Ty chi = (ds.get_data (i).get_y () - model_y[i]);
+                        return Ts (chi * chi);
+                    });
                 }
             if (verb)
                 {
@@ -105,6 +118,49 @@ namespace opt_utilities
 
             return result;
         }
+
+      private:
+        Tp do_gradient (const Tp &p)
+        {
+            if (!this->analytic_gradient_available ())
+                {
+                    return this->numeric_gradient (p);
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            return this->sum_gradient_over_data (p, [fields](size_t i, const Ty &y_model) {
+                return -2 * (fields.y (i) - y_model);
+            });
+        }
+
+        size_t do_num_residuals ()
+        {
+            return this->get_data_set ().size ();
+        }
+
+        void do_eval_residuals (const Tp &p, Ts *r)
+        {
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
+            const data_fields<Tdata> fields (ds);
+            for (size_t i = 0; i < ds.size (); ++i)
+                {
+                    r[i] = fields.y (i) - model_y[i];
+                }
+        }
+
+        bool do_eval_jacobian (const Tp &p, Ts *r, Ts *jac)
+        {
+            if (!this->analytic_gradient_available ())
+                {
+                    return false;
+                }
+            const data_fields<Tdata> fields (this->get_data_set ());
+            this->fill_residual_jacobian (p, r, jac, [fields](size_t i, const Ty &y_model, Ts &ri) {
+                ri = fields.y (i) - y_model;
+                return Ts (-1);
+            });
+            return true;
+        }
     };
 
     template <typename T, typename Ts, typename Tstr>
@@ -162,13 +218,14 @@ namespace opt_utilities
                         }
                 }
 
+            const std::vector<Ty> &model_ys = this->eval_model_on_data_set (p);
             Ts result (0);
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
                     Ty chi (this->get_data_set ().get_data (0).get_y ().size ());
+                    const Ty &model_y = model_ys[i];
                     for (int j = 0; j < chi.size (); ++j)
                         {
-                            Ty model_y (this->eval_model (this->get_data_set ().get_data (i).get_x (), p));
                             if (model_y[j] > this->get_data_set ().get_data (i).get_y ()[j])
                                 {
                                     chi[j] = (this->get_data_set ().get_data (i).get_y ()[j] - model_y[j]);
@@ -72,15 +72,28 @@ namespace opt_utilities
 
         Ts do_eval (const Tp &p)
         {
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_set<Tdata> &ds = this->get_data_set ();
             Ts result (0);
-            for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
+            if (ds.is_columnar ())
                 {
-                    Ty y = std::log (this->get_data_set ().get_data (i).get_y ());
-                    Ty ym = std::log (this->eval_model (this->get_data_set ().get_data (i).get_x (), p));
-                    Ty ye1 = std::log (1 + this->get_data_set ().get_data (i).get_y_upper_err () /
-                                           this->get_data_set ().get_data (i).get_y ());
-                    Ty chi = (y - ym) / ye1;
-                    result += chi * chi;
+                    const Ty *ys = ds.get_y_column ();
+                    const Ty *yus = ds.get_y_upper_err_column ();
+                    const Ty *ms = &model_y[0];
+                    result = this->sum_over_data (ds.size (), [ys, yus, ms](size_t i) {
+                        Ty chi = (std::log (ys[i]) - std::log (ms[i])) / std::log (1 + yus[i] / ys[i]);
+                        return Ts (chi * chi);
+                    });
+                }
+            else
+                {
+                    result = this->sum_over_data (ds.size (), [&ds, &model_y](size_t i) {
+                        Ty y = std::log (ds.get_data (i).get_y ());
+                        Ty ym = std::log (model_y[i]);
+                        Ty ye1 = std::log (1 + ds.get_data (i).get_y_upper_err () / ds.get_data (i).get_y ());
+                        Ty chi = (y - ym) / ye1;
+                        return Ts (chi * chi);
+                    });
                 }
             if (verb)
                 {
@@ -144,21 +157,23 @@ namespace opt_utilities
 
         Ty do_eval (const Tp &p)
         {
+            const std::vector<Ty> &model_ys = this->eval_model_on_data_set (p);
+            const data_fields<Tdata> fields (this->get_data_set ());
             Ty result (0);
             for (int i = 0; i != (this->get_data_set ()).size (); ++i)
                 {
 
-                    Ty y_model = this->eval_model (this->get_data_set ().get_data (i).get_x (), p);
-                    Ty y_obs = this->get_data_set ().get_data (i).get_y ();
+                    Ty y_model = model_ys[i];
+                    Ty y_obs = fields.y (i);
                     Ty y_err;
 
                     if (y_model > y_obs)
                         {
-                            y_err = std::abs (this->get_data_set ().get_data (i).get_y_upper_err ());
+                            y_err = std::abs (fields.y_upper_err (i));
                         }
                     else
                         {
-                            y_err = -std::abs (this->get_data_set ().get_data (i).get_y_lower_err ());
+                            y_err = -std::abs (fields.y_lower_err (i));
                         }
                     if (y_obs + y_err < 0)
                         {
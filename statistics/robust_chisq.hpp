@@ -63,12 +63,12 @@ namespace opt_utilities
 
         Ts do_eval (const Tp &p)
         {
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_fields<Tdata> fields (this->get_data_set ());
             Ts result (0);
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
-                    Ty chi = (this->get_data_set ().get_data (i).get_y () -
-                              this->eval_model (this->get_data_set ().get_data (i).get_x (), p)) /
-                             this->get_data_set ().get_data (i).get_y_upper_err ();
+                    Ty chi = (fields.y (i) - model_y[i]) / fields.y_upper_err (i);
                     result += std::abs (chi);
                 }
             if (verb)
@@ -133,26 +133,25 @@ namespace opt_utilities
 
         Ty do_eval (const Tp &p)
         {
+            const std::vector<Ty> &model_y = this->eval_model_on_data_set (p);
+            const data_fields<Tdata> fields (this->get_data_set ());
             Ty result (0);
             for (int i = (this->get_data_set ()).size () - 1; i >= 0; --i)
                 {
 
 #ifdef HAVE_X_ERROR
-                    Tx x1 = this->get_data_set ().get_data (i).get_x () -
-                            this->get_data_set ().get_data (i).get_x_lower_err ();
-                    Tx x2 = this->get_data_set ().get_data (i).get_x () +
-                            this->get_data_set ().get_data (i).get_x_upper_err ();
-                    Tx x = this->get_data_set ().get_data (i).get_x ();
-                    Ty errx1 = (this->eval_model (x1, p) - this->eval_model (x, p));
-                    Ty errx2 = (this->eval_model (x2, p) - this->eval_model (x, p));
+                    Tx x1 = fields.x (i) - fields.x_lower_err (i);
+                    Tx x2 = fields.x (i) + fields.x_upper_err (i);
+                    Ty errx1 = (this->eval_model_reformed (x1) - model_y[i]);
+                    Ty errx2 = (this->eval_model_reformed (x2) - model_y[i]);
                     // Ty errx=0;
 #else
                     Ty errx1 = 0;
                     Ty errx2 = 0;
 #endif
 
-                    Ty y_model = this->eval_model (this->get_data_set ().get_data (i).get_x (), p);
-                    Ty y_obs = this->get_data_set ().get_data (i).get_y ();
+                    Ty y_model = model_y[i];
+                    Ty y_obs = fields.y (i);
                     Ty y_err;
 
                     Ty errx = 0;
@@ -182,11 +181,11 @@ namespace opt_utilities
 
                     if (y_model > y_obs)
                         {
-                            y_err = this->get_data_set ().get_data (i).get_y_upper_err ();
+                            y_err = fields.y_upper_err (i);
                         }
                     else
                         {
-                            y_err = this->get_data_set ().get_data (i).get_y_lower_err ();
+                            y_err = fields.y_lower_err (i);
                         }
 
                     Ty chi = (y_obs - y_model) / std::sqrt (y_err * y_err + errx * errx);
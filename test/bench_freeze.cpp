@@ -0,0 +1,114 @@
+#include <core/fitter.hpp>
+#include <core/freeze_param.hpp>
+#include <statistics/chisq.hpp>
+#include <models/gauss1d.hpp>
+#include <models/pl1d.hpp>
+#include <models/bpl1d.hpp>
+#include <models/lin1d.hpp>
+#include <misc/data_loaders.hpp>
+#include <methods/powell/powell_method.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace opt_utilities;
+
+typedef data<double,double> Tdata;
+typedef vector<double> Tp;
+typedef fitter<Tdata,Tp,double,std::string> fitter_type;
+
+//the statistic as it was evaluated before: one eval_model, thus
+//one reform_param, for every data point
+class per_point_chisq
+  :public statistic<Tdata,Tp,double,std::string>
+{
+  statistic<Tdata,Tp,double,std::string>* do_clone()const
+  {
+    return new per_point_chisq(*this);
+  }
+
+  double do_eval(const Tp& p)
+  {
+    double result=0;
+    for(int i=get_data_set().size()-1;i>=0;--i)
+      {
+	double chi=(get_data_set().get_data(i).get_y()-
+		    eval_model(get_data_set().get_data(i).get_x(),p))/
+	  get_data_set().get_data(i).get_y_upper_err();
+	result+=chi*chi;
+      }
+    return result;
+  }
+};
+
+//returns the time per statistic evaluation in micro seconds
+double time_eval(fitter_type& f,int n_eval)
+{
+  Tp p(f.get_model().deform_param(f.get_all_params()));
+  statistic<Tdata,Tp,double,std::string>& s=f.get_statistic();
+  volatile double sink=0;
+  chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+  for(int i=0;i<n_eval;++i)
+    {
+      sink=sink+s.eval(p);
+    }
+  chrono::steady_clock::time_point t1=chrono::steady_clock::now();
+  return chrono::duration<double,micro>(t1-t0).count()/n_eval;
+}
+
+void bench(const char* file_name,
+	   const model<Tdata,Tp>& m,const std::string& frozen_param,int n_eval)
+{
+  dl_x_xu_xl_y_yu_yl<double,double> dl;
+  ifstream ifs(file_name);
+  if(!ifs.good())
+    {
+      cerr<<"cannot open "<<file_name<<endl;
+      return;
+    }
+  ifs>>dl;
+
+  fitter_type f;
+  f.set_model(m);
+  f.set_opt_method(powell_method<double,Tp>());
+  f.load_data(dl.get_data_set());
+
+  double t[4];
+  for(int k=0;k<2;++k)
+    {
+      if(k==0)
+	{
+	  f.set_statistic(chisq<Tdata,Tp,double,std::string>());
+	}
+      else
+	{
+	  f.set_statistic(per_point_chisq());
+	}
+      f.clear_param_modifier();
+      t[2*k]=time_eval(f,n_eval);
+      f.set_param_modifier(freeze_param<Tdata,Tp,std::string>(frozen_param));
+      t[2*k+1]=time_eval(f,n_eval);
+    }
+  printf("%-26s %6d %10.2f %10.2f %6.3f %10.2f %10.2f %6.3f\n",
+	 file_name,(int)f.get_data_set().size(),
+	 t[0],t[1],t[1]/t[0],t[2],t[3],t[3]/t[2]);
+}
+
+
+int main(int argc,char* argv[])
+{
+  int n_eval=argc>1?atoi(argv[1]):2000;
+  std::string dir=argc>2?argv[2]:"../sample_data";
+  printf("time per statistic evaluation in us, %d evaluations each\n",n_eval);
+  printf("%-26s %6s %10s %10s %6s %10s %10s %6s\n",
+	 "data","n","batch","frozen","ratio","per-point","frozen","ratio");
+  bench((dir+"/gauss.dat").c_str(),gauss1d<double>(),"x0",n_eval);
+  bench((dir+"/powerlaw.dat").c_str(),pl1d<double>(),"gamma",n_eval);
+  bench((dir+"/bpl.dat").c_str(),bpl1d<double>(),"bpx",n_eval);
+  bench((dir+"/linear.dat").c_str(),lin1d<double>(),"b",n_eval);
+}
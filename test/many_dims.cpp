@@ -15,18 +15,6 @@ using namespace std;
 class foo1
   :public func_obj<double,vector<double> >
 {
-  long long n_eval;
-public:
-  foo1()
-    :n_eval(0)
-  {
-  }
-
-  ~foo1()
-  {
-    cerr<<n_eval<<" evaluations done"<<endl;
-  }
-
   foo1* do_clone()const
   {
     return new foo1(*this);
@@ -36,7 +24,6 @@ public:
 
   double do_eval(const vector<double>& p)
   {
-    ++n_eval;
     double result=0;
     for(int i=0;i!=p.size();++i)
       {
@@ -165,7 +152,11 @@ void test_opt(const func_obj<double,vector<double> >& fo,
   opt.set_start_point(p);
   opt.set_precision(1E-7);
   p=opt.optimize();
-
+  const optimizer_stats<double,vector<double> >& stats=opt.get_stats();
+  cerr<<stats.num_evals()<<" evaluations, "
+      <<stats.num_gradients()<<" gradients, "
+      <<stats.num_iterations()<<" iterations done in "
+      <<stats.wall_time()<<" s ("<<stats.eval_time()<<" s in the object function)"<<endl;
 
   cout<<"the result is:\n";
   for(int i=0;i<p.size();++i)
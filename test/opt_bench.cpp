@@ -0,0 +1,565 @@
+//Benchmark of the optimization methods on standard test functions.
+//Every (method, function, dimension) run is limited by an evaluation
+//and a time budget, and the results are written as JSON.
+//A run that ends normally is "converged" only if its final value is
+//within the tolerance of the minimum, otherwise it is "not_converged".
+//
+//usage: opt_bench [--dims 2,10,100,1000] [--methods powell,bfgs,...]
+//                 [--functions sphere,rosenbrock,...] [--max-evals N]
+//                 [--max-seconds T] [--precision P] [--tolerance E]
+//                 [--output file.json]
+
+#include <core/optimizer.hpp>
+#include <methods/powell/powell_method.hpp>
+#include <methods/bfgs/bfgs.hpp>
+#include <methods/lbfgs/lbfgs_method.hpp>
+#include <methods/conjugate_gradient/conjugate_gradient.hpp>
+#include <methods/conjugate_gradient_hybrid/conjugate_gradient_hybrid.hpp>
+#include <methods/aga/aga.hpp>
+#include <methods/simplex/simplex.hpp>
+#include <methods/lbfgsb/lbfgsb.hpp>
+#ifdef OPT_BENCH_HAVE_GSL
+#include <methods/gsl_simplex/gsl_simplex.hpp>
+#endif
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace opt_utilities;
+
+typedef vector<double> Tp;
+
+class budget_exceeded
+{
+};
+
+//shared by a test function and all its clones
+struct budget
+{
+  unsigned long long max_evals;
+  double max_seconds;
+  bool enforce;
+  atomic<unsigned long long> n_eval;
+  chrono::steady_clock::time_point t0;
+  mutex best_mutex;
+  double best_value;
+  Tp best_param;
+
+  budget(unsigned long long me,double ms,bool e)
+    :max_evals(me),max_seconds(ms),enforce(e),n_eval(0),
+     t0(chrono::steady_clock::now()),
+     best_value(numeric_limits<double>::infinity())
+  {
+  }
+
+  bool exhausted()const
+  {
+    return n_eval.load()>=max_evals||
+      chrono::duration<double>(chrono::steady_clock::now()-t0).count()>=max_seconds;
+  }
+};
+
+//base of the test functions, it keeps track of the budget and of
+//the best point seen so far
+class bench_function
+  :public func_obj<double,Tp>
+{
+public:
+  shared_ptr<budget> p_budget;
+
+  virtual double value(const Tp& p)const=0;
+  virtual double minimum()const
+  {
+    return 0;
+  }
+  virtual double minimizer(size_t,size_t)const
+  {
+    return 0;
+  }
+  virtual double start(size_t,size_t)const
+  {
+    return 3;
+  }
+  virtual double bound()const
+  {
+    return 10;
+  }
+
+private:
+  double do_eval(const Tp& p)
+  {
+    if(p_budget)
+      {
+	if(p_budget->enforce&&p_budget->exhausted())
+	  {
+	    throw budget_exceeded();
+	  }
+	p_budget->n_eval.fetch_add(1);
+      }
+    double v=value(p);
+    if(p_budget)
+      {
+	lock_guard<mutex> lk(p_budget->best_mutex);
+	if(v<p_budget->best_value)
+	  {
+	    p_budget->best_value=v;
+	    p_budget->best_param=p;
+	  }
+      }
+    return v;
+  }
+};
+
+//sum x_i^2, the foo1 of many_dims.cpp
+class sphere
+  :public bench_function
+{
+  sphere* do_clone()const
+  {
+    return new sphere(*this);
+  }
+public:
+  double value(const Tp& p)const
+  {
+    double result=0;
+    for(size_t i=0;i<p.size();++i)
+      {
+	result+=p[i]*p[i];
+      }
+    return result;
+  }
+};
+
+//sum 10^(6i/(n-1)) x_i^2
+class ellipsoid
+  :public bench_function
+{
+  ellipsoid* do_clone()const
+  {
+    return new ellipsoid(*this);
+  }
+public:
+  double value(const Tp& p)const
+  {
+    double result=0;
+    for(size_t i=0;i<p.size();++i)
+      {
+	double w=p.size()>1?pow(10.,6.*i/(p.size()-1)):1;
+	result+=w*p[i]*p[i];
+      }
+    return result;
+  }
+};
+
+class rosenbrock
+  :public bench_function
+{
+  rosenbrock* do_clone()const
+  {
+    return new rosenbrock(*this);
+  }
+public:
+  double value(const Tp& p)const
+  {
+    double result=0;
+    for(size_t i=0;i+1<p.size();++i)
+      {
+	double a=p[i+1]-p[i]*p[i];
+	result+=100*a*a+(1-p[i])*(1-p[i]);
+      }
+    return result;
+  }
+  double minimizer(size_t,size_t)const
+  {
+    return 1;
+  }
+  double start(size_t i,size_t)const
+  {
+    return i%2==0?-1.2:1;
+  }
+};
+
+class rastrigin
+  :public bench_function
+{
+  rastrigin* do_clone()const
+  {
+    return new rastrigin(*this);
+  }
+public:
+  double value(const Tp& p)const
+  {
+    const double pi=3.14159265358979323846;
+    double result=10*p.size();
+    for(size_t i=0;i<p.size();++i)
+      {
+	result+=p[i]*p[i]-10*cos(2*pi*p[i]);
+      }
+    return result;
+  }
+  double start(size_t,size_t)const
+  {
+    return 2.5;
+  }
+  double bound()const
+  {
+    return 5.12;
+  }
+};
+
+//sum (i+1) x_i^2, the foo2 of many_dims.cpp
+class foo2
+  :public bench_function
+{
+  foo2* do_clone()const
+  {
+    return new foo2(*this);
+  }
+public:
+  double value(const Tp& p)const
+  {
+    double result=0;
+    for(size_t i=0;i<p.size();++i)
+      {
+	result+=(i+1)*p[i]*p[i];
+      }
+    return result;
+  }
+};
+
+//sum (sum_{j<=i} x_j)^2, the foo3 of many_dims.cpp
+class foo3
+  :public bench_function
+{
+  foo3* do_clone()const
+  {
+    return new foo3(*this);
+  }
+public:
+  double value(const Tp& p)const
+  {
+    double result=0;
+    double temp=0;
+    for(size_t i=0;i<p.size();++i)
+      {
+	temp+=p[i];
+	result+=temp*temp;
+      }
+    return result;
+  }
+};
+
+bench_function* make_function(const string& name)
+{
+  if(name=="sphere") return new sphere;
+  if(name=="ellipsoid") return new ellipsoid;
+  if(name=="rosenbrock") return new rosenbrock;
+  if(name=="rastrigin") return new rastrigin;
+  if(name=="foo2") return new foo2;
+  if(name=="foo3") return new foo3;
+  return NULL_PTR;
+}
+
+opt_method<double,Tp>* make_method(const string& name)
+{
+  if(name=="powell") return new powell_method<double,Tp>;
+  if(name=="bfgs") return new bfgs_method<double,Tp>;
+  if(name=="lbfgs") return new lbfgs_method<double,Tp>;
+  if(name=="cg") return new conjugate_gradient<double,Tp>;
+  if(name=="cg_hybrid") return new conjugate_gradient_hybrid<double,Tp>;
+  if(name=="aga")
+    {
+      aga_method<double,Tp>* p=new aga_method<double,Tp>;
+      p->set_seed(12345);
+      return p;
+    }
+  if(name=="simplex") return new simplex_method<double,Tp>;
+  if(name=="lbfgsb") return new lbfgsb_method<double,Tp>;
+#ifdef OPT_BENCH_HAVE_GSL
+  if(name=="gsl_simplex") return new gsl_simplex<double,Tp>;
+#endif
+  return NULL_PTR;
+}
+
+struct bench_result
+{
+  string method;
+  string function;
+  size_t dim;
+  string status;
+  unsigned long long evals;
+  unsigned long long gradients;
+  unsigned long long line_searches;
+  unsigned long long iterations;
+  double wall_time;
+  double eval_time;
+  double final_value;
+  double final_error;
+  double param_error;
+};
+
+struct bench_config
+{
+  vector<size_t> dims;
+  vector<string> methods;
+  vector<string> functions;
+  unsigned long long max_evals;
+  double max_seconds;
+  double precision;
+  double tolerance;
+  string output;
+};
+
+bench_result run_one(const bench_config& cfg,const string& mname,
+		     const string& fname,size_t n)
+{
+  bench_result r;
+  r.method=mname;
+  r.function=fname;
+  r.dim=n;
+  unique_ptr<bench_function> pf(make_function(fname));
+  opt_method<double,Tp>* pm=make_method(mname);
+  //an exception can not be safely thrown through the gsl library,
+  //so the budget is not enforced for gsl_simplex
+  pf->p_budget.reset(new budget(cfg.max_evals,cfg.max_seconds,
+				mname!="gsl_simplex"));
+
+  optimizer<double,Tp> opt;
+  opt.set_func_obj(*pf);
+  opt.set_opt_method(*pm);
+  pm->destroy();
+  Tp x(n),lower(n),upper(n);
+  for(size_t i=0;i<n;++i)
+    {
+      x[i]=pf->start(i,n);
+      lower[i]=-pf->bound();
+      upper[i]=pf->bound();
+    }
+  opt.set_lower_limit(lower);
+  opt.set_upper_limit(upper);
+  opt.set_start_point(x);
+  opt.set_precision(cfg.precision);
+
+  r.status="converged";
+  try
+    {
+      x=opt.optimize();
+    }
+  catch(const budget_exceeded&)
+    {
+      r.status="budget";
+      x=pf->p_budget->best_param;
+    }
+  catch(const exception& e)
+    {
+      r.status="error";
+      x=pf->p_budget->best_param;
+    }
+  const optimizer_stats<double,Tp>& stats=opt.get_stats();
+  r.evals=stats.num_evals();
+  r.gradients=stats.num_gradients();
+  r.line_searches=stats.num_line_searches();
+  r.iterations=stats.num_iterations();
+  r.wall_time=stats.wall_time();
+  r.eval_time=stats.eval_time();
+  if(x.size()==n)
+    {
+      r.final_value=pf->value(x);
+      r.final_error=fabs(r.final_value-pf->minimum());
+      r.param_error=0;
+      for(size_t i=0;i<n;++i)
+	{
+	  r.param_error=max(r.param_error,fabs(x[i]-pf->minimizer(i,n)));
+	}
+    }
+  else
+    {
+      r.final_value=r.final_error=r.param_error=numeric_limits<double>::quiet_NaN();
+    }
+  //NaN is not within the tolerance either
+  if(r.status=="converged"&&!(r.final_error<=cfg.tolerance))
+    {
+      r.status="not_converged";
+    }
+  return r;
+}
+
+string json_number(double x)
+{
+  if(!(x==x)||x==numeric_limits<double>::infinity()||
+     x==-numeric_limits<double>::infinity())
+    {
+      return "null";
+    }
+  char buf[32];
+  sprintf(buf,"%.17g",x);
+  return buf;
+}
+
+void write_json(ostream& os,const bench_config& cfg,
+		const vector<bench_result>& results)
+{
+  os<<"{\n";
+  os<<"  \"benchmark\": \"opt_bench\",\n";
+  os<<"  \"max_evals\": "<<cfg.max_evals<<",\n";
+  os<<"  \"max_seconds\": "<<json_number(cfg.max_seconds)<<",\n";
+  os<<"  \"precision\": "<<json_number(cfg.precision)<<",\n";
+  os<<"  \"tolerance\": "<<json_number(cfg.tolerance)<<",\n";
+  os<<"  \"results\": [";
+  for(size_t i=0;i<results.size();++i)
+    {
+      const bench_result& r=results[i];
+      os<<(i==0?"\n":",\n");
+      os<<"    {\"method\": \""<<r.method<<"\""
+	<<", \"function\": \""<<r.function<<"\""
+	<<", \"dim\": "<<r.dim
+	<<", \"status\": \""<<r.status<<"\""
+	<<", \"evals\": "<<r.evals
+	<<", \"gradients\": "<<r.gradients
+	<<", \"line_searches\": "<<r.line_searches
+	<<", \"iterations\": "<<r.iterations
+	<<", \"wall_time\": "<<json_number(r.wall_time)
+	<<", \"eval_time\": "<<json_number(r.eval_time)
+	<<", \"final_value\": "<<json_number(r.final_value)
+	<<", \"final_error\": "<<json_number(r.final_error)
+	<<", \"param_error\": "<<json_number(r.param_error)<<"}";
+    }
+  os<<"\n  ]\n}\n";
+}
+
+vector<string> split(const string& s)
+{
+  vector<string> result;
+  istringstream iss(s);
+  string item;
+  while(getline(iss,item,','))
+    {
+      if(!item.empty())
+	{
+	  result.push_back(item);
+	}
+    }
+  return result;
+}
+
+int main(int argc,char* argv[])
+{
+  bench_config cfg;
+  cfg.dims.push_back(2);
+  cfg.dims.push_back(10);
+  cfg.dims.push_back(100);
+  cfg.dims.push_back(1000);
+  cfg.methods=split("powell,bfgs,lbfgs,lbfgsb,cg,cg_hybrid,aga,simplex");
+#ifdef OPT_BENCH_HAVE_GSL
+  cfg.methods.push_back("gsl_simplex");
+#endif
+  cfg.functions=split("sphere,ellipsoid,rosenbrock,rastrigin,foo2,foo3");
+  cfg.max_evals=200000;
+  cfg.max_seconds=10;
+  cfg.precision=1e-8;
+  cfg.tolerance=1e-4;
+
+  for(int i=1;i<argc;++i)
+    {
+      string arg(argv[i]);
+      if(i+1>=argc)
+	{
+	  cerr<<"missing value of "<<arg<<endl;
+	  return 1;
+	}
+      string val(argv[++i]);
+      if(arg=="--dims")
+	{
+	  vector<string> d(split(val));
+	  cfg.dims.clear();
+	  for(size_t j=0;j<d.size();++j)
+	    {
+	      cfg.dims.push_back(atoi(d[j].c_str()));
+	    }
+	}
+      else if(arg=="--methods")
+	{
+	  cfg.methods=split(val);
+	}
+      else if(arg=="--functions")
+	{
+	  cfg.functions=split(val);
+	}
+      else if(arg=="--max-evals")
+	{
+	  cfg.max_evals=strtoull(val.c_str(),NULL_PTR,10);
+	}
+      else if(arg=="--max-seconds")
+	{
+	  cfg.max_seconds=atof(val.c_str());
+	}
+      else if(arg=="--precision")
+	{
+	  cfg.precision=atof(val.c_str());
+	}
+      else if(arg=="--tolerance")
+	{
+	  cfg.tolerance=atof(val.c_str());
+	}
+      else if(arg=="--output")
+	{
+	  cfg.output=val;
+	}
+      else
+	{
+	  cerr<<"unknown option "<<arg<<endl;
+	  return 1;
+	}
+    }
+
+  vector<bench_result> results;
+  for(size_t m=0;m<cfg.methods.size();++m)
+    {
+      opt_method<double,Tp>* pm=make_method(cfg.methods[m]);
+      if(pm==NULL_PTR)
+	{
+	  cerr<<"unknown method "<<cfg.methods[m]<<endl;
+	  return 1;
+	}
+      pm->destroy();
+      for(size_t f=0;f<cfg.functions.size();++f)
+	{
+	  bench_function* pf=make_function(cfg.functions[f]);
+	  if(pf==NULL_PTR)
+	    {
+	      cerr<<"unknown function "<<cfg.functions[f]<<endl;
+	      return 1;
+	    }
+	  delete pf;
+	  for(size_t d=0;d<cfg.dims.size();++d)
+	    {
+	      results.push_back(run_one(cfg,cfg.methods[m],cfg.functions[f],cfg.dims[d]));
+	      const bench_result& r=results.back();
+	      cerr<<r.method<<" "<<r.function<<" "<<r.dim<<": "<<r.status
+		  <<" evals="<<r.evals<<" time="<<r.wall_time
+		  <<" error="<<r.final_error<<endl;
+	    }
+	}
+    }
+
+  if(cfg.output.empty())
+    {
+      write_json(cout,cfg,results);
+    }
+  else
+    {
+      ofstream ofs(cfg.output.c_str());
+      write_json(ofs,cfg,results);
+    }
+}
@@ -0,0 +1,210 @@
+//checks the expressions of strmodel1d: the values against the
+//standard library, the batches against single points, and the
+//symbolic derivatives against central differences
+//exits with the number of failed checks
+#include <math/expression.hpp>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+using namespace std;
+
+using namespace opt_utilities;
+
+int fails=0;
+
+vector<string> par_names()
+{
+  vector<string> names;
+  names.push_back("a");
+  names.push_back("b");
+  names.push_back("c");
+  return names;
+}
+
+//the value and the derivatives with respect to a, b and c
+vector<double> eval_all(const string& expr,double x,const vector<double>& p)
+{
+  expression<double> e;
+  e.parse(expr,par_names(),"x");
+  vector<size_t> roots(1,e.get_root());
+  for(size_t i=0;i<p.size();++i)
+    {
+      roots.push_back(e.derivative(e.get_root(),i));
+    }
+  compiled_expression<double> prog(e,roots);
+  expression_workspace<double> ws;
+  vector<double> result(roots.size());
+  vector<double*> outs(roots.size());
+  for(size_t i=0;i<roots.size();++i)
+    {
+      outs[i]=&result[i];
+    }
+  prog.eval(&p[0],&x,1,&outs[0],ws);
+  return result;
+}
+
+double eval_value(const string& expr,double x,const vector<double>& p)
+{
+  expression<double> e;
+  e.parse(expr,par_names(),"x");
+  compiled_expression<double> prog(e,vector<size_t>(1,e.get_root()));
+  expression_workspace<double> ws;
+  double y;
+  double* outs[1]={&y};
+  prog.eval(&p[0],&x,1,outs,ws);
+  return y;
+}
+
+bool close(double x,double y,double tol)
+{
+  return fabs(x-y)<=tol*max(1.,fabs(y));
+}
+
+void check_value(const string& expr,double x,double expected)
+{
+  vector<double> p(3);
+  p[0]=2;
+  p[1]=3;
+  p[2]=0.5;
+  double y=eval_value(expr,x,p);
+  if(!close(y,expected,1e-12))
+    {
+      printf("FAIL %s at x=%g: %.17g, expected %.17g\n",expr.c_str(),x,y,expected);
+      ++fails;
+    }
+}
+
+void check_derivatives(const string& expr,double x)
+{
+  vector<double> p(3);
+  p[0]=0.7;
+  p[1]=1.3;
+  p[2]=0.4;
+  vector<double> r(eval_all(expr,x,p));
+  if(r[0]!=eval_value(expr,x,p))
+    {
+      printf("FAIL %s at x=%g: the value differs from the value alone\n",expr.c_str(),x);
+      ++fails;
+    }
+  for(size_t i=0;i<p.size();++i)
+    {
+      double h=1e-6*max(1.,fabs(p[i]));
+      vector<double> pp(p);
+      vector<double> pm(p);
+      pp[i]+=h;
+      pm[i]-=h;
+      double nd=(eval_value(expr,x,pp)-eval_value(expr,x,pm))/(2*h);
+      if(!close(r[i+1],nd,1e-6))
+	{
+	  printf("FAIL d(%s)/d%s at x=%g: %.12g, numeric %.12g\n",expr.c_str(),par_names()[i].c_str(),x,r[i+1],nd);
+	  ++fails;
+	}
+    }
+}
+
+void check_error(const string& expr)
+{
+  try
+    {
+      expression<double> e;
+      e.parse(expr,par_names(),"x");
+      printf("FAIL %s: no error\n",expr.c_str());
+      ++fails;
+    }
+  catch(const expression_error&)
+    {
+    }
+}
+
+void check_batch(const string& expr)
+{
+  expression<double> e;
+  e.parse(expr,par_names(),"x");
+  compiled_expression<double> prog(e,vector<size_t>(1,e.get_root()));
+  expression_workspace<double> ws;
+  vector<double> p(3);
+  p[0]=3;
+  p[1]=1;
+  p[2]=0.7;
+  //more than one block of self-vars
+  size_t n=3*compiled_expression<double>::block_size+17;
+  vector<double> xs(n);
+  vector<double> ys(n);
+  for(size_t i=0;i<n;++i)
+    {
+      xs[i]=i*1e-2;
+    }
+  double* outs[1]={&ys[0]};
+  prog.eval(&p[0],&xs[0],n,outs,ws);
+  for(size_t i=0;i<n;++i)
+    {
+      double y=eval_value(expr,xs[i],p);
+      //outside the domain both are NaN
+      if(ys[i]!=y&&!(ys[i]!=ys[i]&&y!=y))
+	{
+	  printf("FAIL %s at x=%g: the batch differs from the point\n",expr.c_str(),xs[i]);
+	  ++fails;
+	  return;
+	}
+    }
+}
+
+int main()
+{
+  check_value("a*x+b",1.5,6);
+  check_value("-x^2",3,-9);
+  check_value("2^3^2",0,512);
+  check_value("a^-1",0,0.5);
+  check_value("x^2.5",2,pow(2,2.5));
+  check_value("x^-3",2,0.125);
+  check_value("exp(-x/b)*a+c",1,exp(-1/3.)*2+0.5);
+  check_value("log(x)+ln(x)+log10(x)+log2(x)",8,2*log(8.)+log10(8.)+3);
+  check_value("asinh(x)+acosh(b)+atanh(c)",0.7,asinh(0.7)+acosh(3.)+atanh(0.5));
+  check_value("min(a,b,x)+max(a,b,x)+sum(1,2,3)+avg(2,4)",2.5,2+3+6+3);
+  check_value("x>1 ? a : b",2,2);
+  check_value("x>1 ? a : b",0,3);
+  check_value("(x<=1)+(x>=1)+(x==1)+(x!=1)+(x<1 || x>1)+(x>0 && x<2)+!x",1,4);
+  check_value("_pi*_e",0,M_PI*M_E);
+  check_value("sin(x)^2+cos(x)^2",0.7,1);
+  check_value("2*-x",3,-6);
+  check_value("1e-3*x+.5",2,0.502);
+  check_value("abs(-x)+sign(-x)+rint(2.6)",2,4);
+
+  const char* exprs[]={"a*x+b","a*exp(-x/b)+c","a^2*x^b","x^a","a^b",
+		       "sqrt(a*b)+log(b)-log10(a)+log2(c)","sin(a*x)*cos(b)+tan(c)",
+		       "asin(c)+acos(c*a)+atan(a*b)","sinh(a)+cosh(b*x)+tanh(c)",
+		       "asinh(a*x)+acosh(b+x)+atanh(c*x)","abs(a-b)*c",
+		       "min(a,b)+max(b*x,c)","x>1?a*b:c^3","a/(b+c*x)","-a/b",
+		       "a*a/(1+a)","(a-b)^3/(c+1)^-2","exp(-(x-a)^2/(2*b^2))*c",
+		       "sum(a,b,c)*avg(a,x)","3*x","a"};
+  for(size_t i=0;i<sizeof(exprs)/sizeof(exprs[0]);++i)
+    {
+      check_derivatives(exprs[i],1.7);
+      check_derivatives(exprs[i],0.3);
+      check_batch(exprs[i]);
+    }
+
+  //the derivative of b*x^a with respect to a is 0 at x=0, not NaN
+  vector<double> p(3);
+  p[0]=2.5;
+  p[1]=3;
+  p[2]=0;
+  vector<double> r(eval_all("b*x^a",0,p));
+  if(r[0]!=0||r[1]!=0||r[2]!=0)
+    {
+      printf("FAIL b*x^a at x=0: %g %g %g\n",r[0],r[1],r[2]);
+      ++fails;
+    }
+
+  check_error("a+");
+  check_error("foo(x)");
+  check_error("a*q");
+  check_error("(a");
+  check_error("a b");
+  check_error("sin(a,b)");
+
+  printf("%d failed\n",fails);
+  return fails;
+}
@@ -0,0 +1,215 @@
+//checks strmodel1d: the values and the batches against the formulas,
+//the gradients against central differences, two models sharing the
+//per-thread buffers on one thread, and batches run from several threads
+//exits with the number of failed checks
+#include <models/strmodel1d.hpp>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+using namespace std;
+
+using namespace opt_utilities;
+
+int fails=0;
+
+bool close(double x,double y,double tol)
+{
+  return fabs(x-y)<=tol*max(1.,fabs(y));
+}
+
+strmodel1d make_model(const string& expr,size_t npar)
+{
+  const char* names[]={"a","b","c"};
+  strmodel1d m;
+  m.set_expr(expr,vector<string>(names,names+npar),"x");
+  return m;
+}
+
+vector<double> make_xs(size_t n)
+{
+  vector<double> xs(n);
+  for(size_t i=0;i<n;++i)
+    {
+      xs[i]=0.1+i*1e-3;
+    }
+  return xs;
+}
+
+double gauss(double x,const vector<double>& p)
+{
+  return p[0]*exp(-(x-p[1])*(x-p[1])/(2*p[2]*p[2]));
+}
+
+double line(double x,const vector<double>& p)
+{
+  return p[0]*x+p[1];
+}
+
+void check_value(strmodel1d& m,double (*f)(double,const vector<double>&),const vector<double>& p)
+{
+  double xs[]={-1.3,0,0.4,2.5};
+  for(size_t i=0;i<sizeof(xs)/sizeof(xs[0]);++i)
+    {
+      double y=m.eval_raw(xs[i],p);
+      if(!close(y,f(xs[i],p),1e-12))
+	{
+	  printf("FAIL value at x=%g: %.17g, expected %.17g\n",xs[i],y,f(xs[i],p));
+	  ++fails;
+	}
+    }
+}
+
+void check_gradient(strmodel1d& m,const vector<double>& p)
+{
+  double xs[]={-1.3,0.4,2.5};
+  for(size_t k=0;k<sizeof(xs)/sizeof(xs[0]);++k)
+    {
+      double x=xs[k];
+      double y;
+      vector<double> dy_dp;
+      m.eval_grad_reformed(x,p,y,dy_dp);
+      if(y!=m.eval_raw(x,p))
+	{
+	  printf("FAIL the value of eval_grad at x=%g differs from eval\n",x);
+	  ++fails;
+	}
+      for(size_t i=0;i<p.size();++i)
+	{
+	  double h=1e-6*max(1.,fabs(p[i]));
+	  vector<double> pp(p);
+	  vector<double> pm(p);
+	  pp[i]+=h;
+	  pm[i]-=h;
+	  double nd=(m.eval_raw(x,pp)-m.eval_raw(x,pm))/(2*h);
+	  if(!close(dy_dp[i],nd,1e-6))
+	    {
+	      printf("FAIL dy/dp%d at x=%g: %.12g, numeric %.12g\n",int(i),x,dy_dp[i],nd);
+	      ++fails;
+	    }
+	}
+    }
+}
+
+void check_batch(strmodel1d& m,const vector<double>& p)
+{
+  //more than one block of self-vars
+  size_t n=3*compiled_expression<double>::block_size+17;
+  vector<double> xs(make_xs(n));
+  vector<double> ys(n);
+  m.eval_batch_reformed(&xs[0],n,p,&ys[0]);
+  for(size_t i=0;i<n;++i)
+    {
+      if(ys[i]!=m.eval_raw(xs[i],p))
+	{
+	  printf("FAIL the batch at x=%g differs from the point\n",xs[i]);
+	  ++fails;
+	  return;
+	}
+    }
+}
+
+//two models with different programs take turns on the buffers of one thread
+void check_switching()
+{
+  strmodel1d g(make_model("a*exp(-(x-b)^2/(2*c^2))",3));
+  strmodel1d l(make_model("a*x+b",2));
+  vector<double> pg(3);
+  pg[0]=2;
+  pg[1]=0.3;
+  pg[2]=0.8;
+  vector<double> pl(2);
+  pl[0]=-1.5;
+  pl[1]=4;
+  for(int k=0;k<4;++k)
+    {
+      double x=0.25*k;
+      double yg=g.eval_raw(x,pg);
+      double yl=l.eval_raw(x,pl);
+      double ygg;
+      double ylg;
+      vector<double> dg;
+      vector<double> dl;
+      g.eval_grad_reformed(x,pg,ygg,dg);
+      l.eval_grad_reformed(x,pl,ylg,dl);
+      if(!close(yg,gauss(x,pg),1e-12)||!close(yl,line(x,pl),1e-12)||
+	 ygg!=yg||ylg!=yl||dl.size()!=2||dl[0]!=x||dl[1]!=1)
+	{
+	  printf("FAIL switching the programs at x=%g\n",x);
+	  ++fails;
+	}
+    }
+}
+
+void check_threads(strmodel1d& m,const vector<double>& p)
+{
+  size_t n=5*compiled_expression<double>::block_size+3;
+  vector<double> xs(make_xs(n));
+  vector<double> expected(n);
+  m.eval_batch_reformed(&xs[0],n,p,&expected[0]);
+  const int nthreads=8;
+  vector<vector<double> > ys(nthreads,vector<double>(n));
+  vector<thread> threads;
+  for(int t=0;t<nthreads;++t)
+    {
+      threads.push_back(thread([&m,&p,&xs,&ys,n,t]()
+			       {
+				 for(int r=0;r<20;++r)
+				   {
+				     m.eval_batch_reformed(&xs[0],n,p,&ys[t][0]);
+				   }
+			       }));
+    }
+  for(size_t t=0;t<threads.size();++t)
+    {
+      threads[t].join();
+    }
+  for(int t=0;t<nthreads;++t)
+    {
+      if(ys[t]!=expected)
+	{
+	  printf("FAIL the batch of thread %d differs from the serial one\n",t);
+	  ++fails;
+	}
+    }
+}
+
+int main()
+{
+  strmodel1d g(make_model("a*exp(-(x-b)^2/(2*c^2))",3));
+  vector<double> p(3);
+  p[0]=2;
+  p[1]=0.3;
+  p[2]=0.8;
+  check_value(g,gauss,p);
+  check_gradient(g,p);
+  check_batch(g,p);
+
+  strmodel1d l(make_model("a*x+b",2));
+  vector<double> pl(2);
+  pl[0]=-1.5;
+  pl[1]=4;
+  check_value(l,line,pl);
+  check_gradient(l,pl);
+  check_batch(l,pl);
+
+  check_switching();
+  check_threads(g,p);
+
+  //an empty model reports the error instead of evaluating
+  try
+    {
+      strmodel1d e;
+      e.eval_raw(0,vector<double>());
+      printf("FAIL an empty model: no error\n");
+      ++fails;
+    }
+  catch(const expression_error&)
+    {
+    }
+
+  printf("%d failed\n",fails);
+  return fails;
+}
@@ -0,0 +1,93 @@
+/**
+   \file aligned_allocator.hpp
+   \brief an allocator that returns memory aligned to a given boundary
+   \author Junhua Gu
+ */
+
+#ifndef ALIGNED_ALLOCATOR_HPP
+#define ALIGNED_ALLOCATOR_HPP
+#define OPT_HEADER
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace opt_utilities
+{
+    /**
+       \brief an allocator for std::vector that aligns the storage,
+       so that the elements can be streamed with aligned vector loads
+       \tparam T the element type
+       \tparam Align the alignment in bytes, should be a power of 2
+     */
+    template <typename T, size_t Align = 64> class aligned_allocator
+    {
+      public:
+        typedef T value_type;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template <typename U> struct rebind
+        {
+            typedef aligned_allocator<U, Align> other;
+        };
+
+      public:
+        aligned_allocator ()
+        {
+        }
+
+        template <typename U> aligned_allocator (const aligned_allocator<U, Align> &)
+        {
+        }
+
+        T *allocate (size_t n)
+        {
+            // over-allocate, and keep the original pointer just before the
+            // aligned block, so that deallocate can recover it
+            size_t extra = Align + sizeof (void *);
+            if (n > (size_t (-1) - extra) / sizeof (T))
+                {
+                    throw std::bad_alloc ();
+                }
+            void *raw = std::malloc (n * sizeof (T) + extra);
+            if (raw == 0)
+                {
+                    throw std::bad_alloc ();
+                }
+            size_t addr = reinterpret_cast<size_t> (raw) + sizeof (void *);
+            addr = (addr + Align - 1) & ~(size_t)(Align - 1);
+            reinterpret_cast<void **> (addr)[-1] = raw;
+            return reinterpret_cast<T *> (addr);
+        }
+
+        void deallocate (T *p, size_t)
+        {
+            if (p != 0)
+                {
+                    std::free (reinterpret_cast<void **> (p)[-1]);
+                }
+        }
+
+        size_t max_size () const
+        {
+            return (size_t (-1) - Align - sizeof (void *)) / sizeof (T);
+        }
+
+        template <typename U> bool operator== (const aligned_allocator<U, Align> &) const
+        {
+            return true;
+        }
+
+        template <typename U> bool operator!= (const aligned_allocator<U, Align> &) const
+        {
+            return false;
+        }
+    };
+}
+
+#endif
+// EOF